@@ -0,0 +1,50 @@
+#include "wiimote.h"
+#include "wm_adpcm.h"
+
+/* Step scale per nibble magnitude, 8.8 fixed point. */
+static const int wm_adpcm_scale[8]={230,230,230,230,307,409,512,614};
+
+void wm_adpcm_init(struct wm_adpcm *adpcm) {
+  adpcm->predictor=0;
+  adpcm->step=WM_ADPCM_STEP_MIN;
+}
+
+/* One sample.
+ */
+
+static inline int wm_adpcm_encode_sample(struct wm_adpcm *adpcm,int sample) {
+  int delta=sample-adpcm->predictor;
+  int neg=delta>>31; // 0 or -1
+  int t=((delta^neg)-neg)<<2;
+  int step=adpcm->step;
+
+  /* mag=min(7,t/step) */
+  int mag=0,d;
+  d=(t>=step<<2); mag|=d<<2; t-=(step<<2)&-d;
+  d=(t>=step<<1); mag|=d<<1; t-=(step<<1)&-d;
+  d=(t>=step);    mag|=d;
+
+  /* Reconstruct what the decoder will: step*(2*mag+1)/8, truncated toward zero. */
+  int diff=(step*((mag<<1)+1))>>3;
+  int p=adpcm->predictor+((diff^neg)-neg);
+  if (p<-32768) p=-32768; else if (p>32767) p=32767;
+  adpcm->predictor=p;
+
+  step=(step*wm_adpcm_scale[mag])>>8;
+  if (step<WM_ADPCM_STEP_MIN) step=WM_ADPCM_STEP_MIN; else if (step>WM_ADPCM_STEP_MAX) step=WM_ADPCM_STEP_MAX;
+  adpcm->step=step;
+
+  return mag|(neg&8);
+}
+
+/* Encode.
+ */
+
+int wm_adpcm_encode(uint8_t *dst,struct wm_adpcm *adpcm,const int16_t *src,int samplec) {
+  int dstc=samplec>>1;
+  int i=dstc; for (;i-->0;src+=2) {
+    int hi=wm_adpcm_encode_sample(adpcm,src[0]);
+    *dst++=(hi<<4)|wm_adpcm_encode_sample(adpcm,src[1]);
+  }
+  return dstc;
+}
@@ -0,0 +1,29 @@
+/* wm_adpcm.h
+ * Yamaha 4-bit ADPCM encoder, the format the Wii Remote's speaker decodes.
+ * Two samples per byte, first sample in the high nibble.
+ *
+ * Each sample depends on the one before it, so there's nothing to vectorize across samples.
+ * Instead the per-sample work is branch-free and division-free:
+ * The quantizer is a three-step restoring division, which also clamps to 7 for free.
+ * Output is bit-identical to the textbook encoder with its divide, see wm_bench.
+ */
+
+#ifndef WM_ADPCM_H
+#define WM_ADPCM_H
+
+#define WM_ADPCM_STEP_MIN 127
+#define WM_ADPCM_STEP_MAX 24576
+
+struct wm_adpcm {
+  int predictor; // Last decoded sample, as the device will see it.
+  int step;
+};
+
+void wm_adpcm_init(struct wm_adpcm *adpcm);
+
+/* Encode (samplec) signed 16-bit samples, which must be even.
+ * Writes (samplec/2) bytes to (dst) and returns that count.
+ */
+int wm_adpcm_encode(uint8_t *dst,struct wm_adpcm *adpcm,const int16_t *src,int samplec);
+
+#endif
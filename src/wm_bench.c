@@ -0,0 +1,459 @@
+#include "wiimote.h"
+#include "wm_bench.h"
+#include "wm_fusion.h"
+#include "wm_report.h"
+#include "wm_enums.h"
+#include "wm_adpcm.h"
+#include "wm_speaker.h"
+#include "wm_stats.h"
+#include "wm_rt.h"
+#include "wm_transport.h"
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+
+/* Clock and pseudo-random input, same sequence every run.
+ */
+
+static int64_t wm_bench_now_ns() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (int64_t)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+
+static uint32_t wm_bench_rand(uint32_t *state) {
+  *state=(*state)*1664525+1013904223;
+  return *state;
+}
+
+/* Report cost per sample, and what that means for one remote at the usual report rates.
+ */
+
+static void wm_bench_report(const char *name,int64_t ns,int samplec) {
+  double per=(double)ns/samplec;
+  printf(
+    "%s: %d samples, %.1f ns/sample, %.5f%% CPU at 100 Hz, %.5f%% CPU at 200 Hz\n",
+    name,samplec,per,per*100.0/1e7,per*200.0/1e7
+  );
+}
+
+/* Orientation fusion.
+ * Inputs wander around a tilted rest position with some noise, like a hand-held remote.
+ */
+
+#define WM_BENCH_FUSION_SAMPLES 1000000
+
+static int wm_bench_fusion() {
+  static int inputs[1024][6];
+  uint32_t seed=1;
+  int i; for (i=0;i<1024;i++) {
+    inputs[i][0]=40+(int)(wm_bench_rand(&seed)%32)-16;
+    inputs[i][1]=-20+(int)(wm_bench_rand(&seed)%32)-16;
+    inputs[i][2]=WM_ACCEL_1G-20+(int)(wm_bench_rand(&seed)%32)-16;
+    inputs[i][3]=(int)(wm_bench_rand(&seed)%2000)-1000;
+    inputs[i][4]=(int)(wm_bench_rand(&seed)%2000)-1000;
+    inputs[i][5]=(int)(wm_bench_rand(&seed)%2000)-1000;
+  }
+
+  struct wm_fusion fusion;
+  int pass; for (pass=0;pass<2;pass++) {
+    wm_fusion_init(&fusion);
+    int64_t start=wm_bench_now_ns();
+    for (i=0;i<WM_BENCH_FUSION_SAMPLES;i++) {
+      const int *in=inputs[i&1023];
+      wm_fusion_set_accel(&fusion,in[0],in[1],in[2]);
+      if (pass) wm_fusion_set_gyro(&fusion,in[3],in[4],in[5]);
+      wm_fusion_step(&fusion,10000);
+    }
+    int64_t elapsed=wm_bench_now_ns()-start;
+    wm_bench_report(pass?"fusion (accel+gyro)":"fusion (accel)",elapsed,WM_BENCH_FUSION_SAMPLES);
+  }
+  // Keep the optimizer honest.
+  if (fusion.roll==INT_MIN) printf("%d\n",fusion.pitch);
+  return 0;
+}
+
+/* Extension decoding, hand-written vs generic (wm_extdesc).
+ * Goes through wm_report_deliver() with 0x34 reports, so each pass also pays for the report framing.
+ * We measure that alone first, with no extension, and subtract it to get the decoder's own cost.
+ * Inputs are noisy sticks and accelerometers, with a button changing now and then.
+ */
+
+#define WM_BENCH_EXT_SAMPLES 1000000
+
+static int wm_bench_ext_eventc=0;
+
+static int wm_bench_ext_cb_button(void *userdata,int btnid,int value) {
+  wm_bench_ext_eventc++;
+  return 0;
+}
+
+static int wm_bench_ext_cb_ack(void *userdata,uint8_t rptid,uint8_t result) {
+  return 0;
+}
+
+static int wm_bench_ext_cb_read(void *userdata,uint16_t addr,int err,const void *src,int srcc) {
+  return 0;
+}
+
+static int64_t wm_bench_ext_pass(int extid,int generic,uint8_t (*inputs)[23]) {
+  struct wm_report_delegate delegate={
+    .cb_button=wm_bench_ext_cb_button,
+    .cb_ack=wm_bench_ext_cb_ack,
+    .cb_read=wm_bench_ext_cb_read,
+  };
+  struct wm_report *report=wm_report_new(&delegate);
+  if (!report) return -1;
+  if (wm_report_set_rptid(report,0x34)<0) return -1;
+  if (generic) {
+    if (wm_report_set_extension_generic(report,extid)<0) return -1;
+  } else {
+    if (wm_report_set_extension(report,extid)<0) return -1;
+  }
+  int64_t start=wm_bench_now_ns();
+  int i; for (i=0;i<WM_BENCH_EXT_SAMPLES;i++) {
+    if (wm_report_deliver(report,inputs[i&1023],23)<0) break;
+  }
+  int64_t elapsed=wm_bench_now_ns()-start;
+  wm_report_del(report);
+  return (i<WM_BENCH_EXT_SAMPLES)?-1:elapsed;
+}
+
+static int wm_bench_extdecode() {
+  static uint8_t inputs[1024][23];
+  static const uint8_t rest[6]={0x80,0x80,0x80,0x80,0xa0,0xff};
+  uint32_t seed=1;
+  uint8_t buttons[2]={0xff,0xff};
+  int i; for (i=0;i<1024;i++) {
+    uint8_t *in=inputs[i];
+    in[0]=0xa1;
+    in[1]=0x34;
+    int j; for (j=0;j<4;j++) in[4+j]=rest[j]^(wm_bench_rand(&seed)&0x03);
+    if (!(wm_bench_rand(&seed)&15)) buttons[wm_bench_rand(&seed)&1]^=1<<(wm_bench_rand(&seed)&7);
+    in[8]=rest[4]^((~buttons[0])&0x0f)^(wm_bench_rand(&seed)&0x50);
+    in[9]=buttons[1];
+  }
+
+  int64_t base=wm_bench_ext_pass(0,0,inputs);
+  if (base<0) return -1;
+  wm_bench_report("extdecode (framing only)",base,WM_BENCH_EXT_SAMPLES);
+
+  static const struct { int extid; const char *hand,*generic; } casev[]={
+    {WM_DEVICE_TYPE_NUNCHUK,"extdecode nunchuk (hand-written)","extdecode nunchuk (generic)"},
+    {WM_DEVICE_TYPE_CLASSIC,"extdecode classic (hand-written)","extdecode classic (generic)"},
+  };
+  for (i=0;i<sizeof(casev)/sizeof(casev[0]);i++) {
+    int64_t hand=wm_bench_ext_pass(casev[i].extid,0,inputs);
+    int64_t generic=wm_bench_ext_pass(casev[i].extid,1,inputs);
+    if ((hand<0)||(generic<0)) return -1;
+    wm_bench_report(casev[i].hand,hand-base,WM_BENCH_EXT_SAMPLES);
+    wm_bench_report(casev[i].generic,generic-base,WM_BENCH_EXT_SAMPLES);
+  }
+  return 0;
+}
+
+/* ADPCM encoder, ours vs the textbook one with a divide per sample.
+ * Input is a few tones plus noise, loud enough to exercise the whole step range.
+ * We also check that the two produce identical output.
+ */
+
+#define WM_BENCH_ADPCM_SAMPLES 4000000
+
+static int wm_bench_adpcm_reference(uint8_t *dst,struct wm_adpcm *adpcm,const int16_t *src,int samplec) {
+  static const int diff[16]={1,3,5,7,9,11,13,15,-1,-3,-5,-7,-9,-11,-13,-15};
+  static const int scale[16]={230,230,230,230,307,409,512,614,230,230,230,230,307,409,512,614};
+  int i; for (i=0;i<samplec;i++) {
+    int delta=src[i]-adpcm->predictor;
+    int nibble=((delta<0)?-delta:delta)*4/adpcm->step;
+    if (nibble>7) nibble=7;
+    if (delta<0) nibble+=8;
+    adpcm->predictor+=(adpcm->step*diff[nibble])/8;
+    if (adpcm->predictor<-32768) adpcm->predictor=-32768; else if (adpcm->predictor>32767) adpcm->predictor=32767;
+    adpcm->step=(adpcm->step*scale[nibble])>>8;
+    if (adpcm->step<WM_ADPCM_STEP_MIN) adpcm->step=WM_ADPCM_STEP_MIN; else if (adpcm->step>WM_ADPCM_STEP_MAX) adpcm->step=WM_ADPCM_STEP_MAX;
+    if (i&1) dst[i>>1]|=nibble; else dst[i>>1]=nibble<<4;
+  }
+  return samplec>>1;
+}
+
+static int wm_bench_adpcm() {
+  static int16_t pcm[4096];
+  static uint8_t outv[2][2048];
+  uint32_t seed=1;
+  int i; for (i=0;i<4096;i++) {
+    int v=((i*37)&0x3ff)*24-12288; // sawtooth
+    v+=(((i*5)&0x7f)<0x40)?6000:-6000; // square
+    v+=(int)(wm_bench_rand(&seed)%4096)-2048;
+    if (i>=3072) v/=16; // quiet tail, so the step shrinks again
+    pcm[i]=v;
+  }
+
+  static const char *namev[2]={"adpcm (reference)","adpcm"};
+  int64_t elapsedv[2];
+  int pass; for (pass=0;pass<2;pass++) {
+    struct wm_adpcm adpcm;
+    wm_adpcm_init(&adpcm);
+    int64_t start=wm_bench_now_ns();
+    for (i=0;i<WM_BENCH_ADPCM_SAMPLES;i+=4096) {
+      if (pass) wm_adpcm_encode(outv[pass],&adpcm,pcm,4096);
+      else wm_bench_adpcm_reference(outv[pass],&adpcm,pcm,4096);
+    }
+    elapsedv[pass]=wm_bench_now_ns()-start;
+  }
+  for (pass=0;pass<2;pass++) {
+    double per=(double)elapsedv[pass]/WM_BENCH_ADPCM_SAMPLES;
+    printf(
+      "%s: %d samples, %.2f ns/sample, %.1f Msample/s, %.5f%% CPU at 3000 Hz\n",
+      namev[pass],WM_BENCH_ADPCM_SAMPLES,per,1000.0/per,per*3000.0/1e7
+    );
+  }
+  if (memcmp(outv[0],outv[1],sizeof(outv[0]))) {
+    printf("adpcm: MISMATCH against reference\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Speaker packet pacing, through a real wm_speaker reading a temporary file.
+ * Lateness is how long after each packet's deadline we woke up to send it.
+ * Drift is where the last packet landed against the ideal schedule; absolute deadlines should make it no worse than one wakeup.
+ */
+
+#define WM_BENCH_SPEAKER_RATE 3000
+#define WM_BENCH_SPEAKER_PACKETS 150 /* 2 seconds at 3000 Hz. */
+
+static int wm_bench_speaker() {
+  char path[]="/tmp/wiimote-bench-XXXXXX";
+  int fd=mkstemp(path);
+  if (fd<0) return -1;
+  static uint8_t pcm[WM_BENCH_SPEAKER_PACKETS*WM_SPEAKER_PACKET_SAMPLES*2];
+  uint32_t seed=1;
+  int i; for (i=0;i<sizeof(pcm);i++) pcm[i]=wm_bench_rand(&seed)>>24;
+  int ok=(write(fd,pcm,sizeof(pcm))==sizeof(pcm));
+  close(fd);
+
+  struct wm_stats stats={0};
+  struct wm_speaker *speaker=ok?wm_speaker_new(path,WM_BENCH_SPEAKER_RATE,&stats):0;
+  unlink(path);
+  if (!speaker) return -1;
+
+  uint8_t adpcm[WM_SPEAKER_PACKET_BYTES];
+  int64_t start=0,last=0;
+  while (stats.speaker_packets<WM_BENCH_SPEAKER_PACKETS) {
+    struct pollfd pollfd={.fd=wm_speaker_get_fd(speaker),.events=POLLIN};
+    if (pollfd.fd<0) break;
+    if (poll(&pollfd,1,1000)<=0) break;
+    int err=wm_speaker_update(adpcm,speaker);
+    if (err<0) break;
+    if (err) {
+      last=wm_bench_now_ns();
+      if (!start) start=last;
+    }
+  }
+  wm_speaker_del(speaker);
+  if (stats.speaker_packets<WM_BENCH_SPEAKER_PACKETS) return -1;
+
+  const struct wm_stats_timer *lateness=&stats.speaker_lateness;
+  int64_t ideal=((int64_t)(WM_BENCH_SPEAKER_PACKETS-1)*WM_SPEAKER_PACKET_SAMPLES*1000000000)/WM_BENCH_SPEAKER_RATE;
+  printf(
+    "speaker pacing: %d packets at %d Hz, lateness min=%lldus avg=%lldus max=%lldus, drift=%lldus\n",
+    stats.speaker_packets,WM_BENCH_SPEAKER_RATE,
+    (long long)lateness->min,(long long)(lateness->total/lateness->count),(long long)lateness->max,
+    (long long)((last-start-ideal)/1000)
+  );
+  return 0;
+}
+
+/* Scheduling latency: How late we wake from poll() on a timer, the way the main loop waits for reports.
+ * One pass as we are, and one with SCHED_FIFO and locked memory, both while every CPU is kept busy at normal priority.
+ * The real-time pass needs privilege, and is skipped without it.
+ */
+
+#define WM_BENCH_LATENCY_PERIOD_NS 1000000
+#define WM_BENCH_LATENCY_SAMPLES 2000 /* 2 seconds per pass. */
+#define WM_BENCH_LATENCY_PRIORITY 50
+
+static volatile int wm_bench_latency_stop=0;
+
+static void *wm_bench_latency_hog(void *arg) {
+  volatile uint32_t n=0;
+  while (!wm_bench_latency_stop) n++;
+  return 0;
+}
+
+static int wm_bench_cmp_int64(const void *a,const void *b) {
+  int64_t A=*(const int64_t*)a,B=*(const int64_t*)b;
+  return (A<B)?-1:(A>B)?1:0;
+}
+
+static int wm_bench_latency_pass(const char *name) {
+  static int64_t samplev[WM_BENCH_LATENCY_SAMPLES];
+  int fd=timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC);
+  if (fd<0) return -1;
+  int64_t start=wm_bench_now_ns()+WM_BENCH_LATENCY_PERIOD_NS;
+  struct itimerspec its={
+    .it_value={start/1000000000,start%1000000000},
+    .it_interval={0,WM_BENCH_LATENCY_PERIOD_NS},
+  };
+  if (timerfd_settime(fd,TFD_TIMER_ABSTIME,&its,0)<0) {
+    close(fd);
+    return -1;
+  }
+  int64_t deadline=start,total=0;
+  int i; for (i=0;i<WM_BENCH_LATENCY_SAMPLES;) {
+    struct pollfd pollfd={.fd=fd,.events=POLLIN};
+    if (poll(&pollfd,1,1000)<=0) break;
+    int64_t now=wm_bench_now_ns();
+    uint64_t expirations=0;
+    if (read(fd,&expirations,sizeof(expirations))!=sizeof(expirations)) break;
+    /* Deadlines we slept through entirely count as a full period late each. */
+    for (;expirations-->0&&(i<WM_BENCH_LATENCY_SAMPLES);i++,deadline+=WM_BENCH_LATENCY_PERIOD_NS) {
+      samplev[i]=(now-deadline)/1000;
+      total+=samplev[i];
+    }
+  }
+  close(fd);
+  if (i<WM_BENCH_LATENCY_SAMPLES) return -1;
+  qsort(samplev,WM_BENCH_LATENCY_SAMPLES,sizeof(int64_t),wm_bench_cmp_int64);
+  printf(
+    "latency %s: %d wakeups, min=%lldus avg=%lldus p99=%lldus max=%lldus\n",
+    name,WM_BENCH_LATENCY_SAMPLES,
+    (long long)samplev[0],(long long)(total/WM_BENCH_LATENCY_SAMPLES),
+    (long long)samplev[WM_BENCH_LATENCY_SAMPLES*99/100],(long long)samplev[WM_BENCH_LATENCY_SAMPLES-1]
+  );
+  return 0;
+}
+
+static int wm_bench_latency() {
+  pthread_t hogv[64];
+  int hogc=sysconf(_SC_NPROCESSORS_ONLN);
+  if (hogc<1) hogc=1; else if (hogc>64) hogc=64;
+  wm_bench_latency_stop=0;
+  int i; for (i=0;i<hogc;i++) {
+    if (pthread_create(hogv+i,0,wm_bench_latency_hog,0)) break;
+  }
+  hogc=i;
+
+  int err=wm_bench_latency_pass("normal");
+  if (err>=0) {
+    if ((wm_rt_set_scheduler(SCHED_FIFO,WM_BENCH_LATENCY_PRIORITY)<0)||(wm_rt_lock_memory()<0)) {
+      printf("latency fifo+mlock: skipped, needs CAP_SYS_NICE and CAP_IPC_LOCK\n");
+    } else {
+      err=wm_bench_latency_pass("fifo+mlock");
+    }
+    wm_rt_set_scheduler(SCHED_OTHER,0);
+    munlockall();
+  }
+
+  wm_bench_latency_stop=1;
+  for (i=0;i<hogc;i++) pthread_join(hogv[i],0);
+  return err;
+}
+
+/* Busy polling versus sleeping in poll(), through wm_transport_spin_poll() on a local SEQPACKET socket.
+ * A sender thread stamps and sends a packet every 2 ms, about like a remote in continuous mode.
+ * Latency is send to receive. CPU is the receiving thread's, as a share of one core.
+ */
+
+#define WM_BENCH_BUSYPOLL_INTERVAL_NS 2000000
+#define WM_BENCH_BUSYPOLL_PACKETS 1000 /* 2 seconds per pass. */
+#define WM_BENCH_BUSYPOLL_SPIN_US 3000 /* Longer than the interval, so we should never sleep. */
+
+static void *wm_bench_busypoll_sender(void *arg) {
+  int fd=*(int*)arg;
+  int64_t next=wm_bench_now_ns();
+  int i; for (i=0;i<WM_BENCH_BUSYPOLL_PACKETS;i++) {
+    next+=WM_BENCH_BUSYPOLL_INTERVAL_NS;
+    struct timespec ts={next/1000000000,next%1000000000};
+    while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,0)==EINTR) ;
+    int64_t now=wm_bench_now_ns();
+    if (send(fd,&now,sizeof(now),0)!=sizeof(now)) break;
+  }
+  return 0;
+}
+
+static int64_t wm_bench_thread_cpu_ns() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+  return (int64_t)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+
+static int wm_bench_busypoll_pass(const char *name,int spin_us) {
+  static int64_t samplev[WM_BENCH_BUSYPOLL_PACKETS];
+  int fdv[2];
+  if (socketpair(AF_UNIX,SOCK_SEQPACKET,0,fdv)<0) return -1;
+  pthread_t sender;
+  if (pthread_create(&sender,0,wm_bench_busypoll_sender,fdv+1)) {
+    close(fdv[0]);
+    close(fdv[1]);
+    return -1;
+  }
+
+  int64_t wall=wm_bench_now_ns(),cpu=wm_bench_thread_cpu_ns(),total=0;
+  int hitc=0,i;
+  for (i=0;i<WM_BENCH_BUSYPOLL_PACKETS;i++) {
+    int err=wm_transport_spin_poll(fdv[0],spin_us,1000);
+    if (err<=0) break;
+    if (err==2) hitc++;
+    int64_t sent;
+    if (recv(fdv[0],&sent,sizeof(sent),0)!=sizeof(sent)) break;
+    samplev[i]=(wm_bench_now_ns()-sent)/1000;
+    total+=samplev[i];
+  }
+  cpu=wm_bench_thread_cpu_ns()-cpu;
+  wall=wm_bench_now_ns()-wall;
+
+  pthread_join(sender,0);
+  close(fdv[0]);
+  close(fdv[1]);
+  if (i<WM_BENCH_BUSYPOLL_PACKETS) return -1;
+
+  qsort(samplev,WM_BENCH_BUSYPOLL_PACKETS,sizeof(int64_t),wm_bench_cmp_int64);
+  printf(
+    "busypoll %s: %d packets, %d caught spinning, latency avg=%lldus p99=%lldus max=%lldus, %.1f%% CPU\n",
+    name,WM_BENCH_BUSYPOLL_PACKETS,hitc,
+    (long long)(total/WM_BENCH_BUSYPOLL_PACKETS),
+    (long long)samplev[WM_BENCH_BUSYPOLL_PACKETS*99/100],(long long)samplev[WM_BENCH_BUSYPOLL_PACKETS-1],
+    (cpu*100.0)/wall
+  );
+  return 0;
+}
+
+static int wm_bench_busypoll() {
+  if (wm_bench_busypoll_pass("poll",0)<0) return -1;
+  if (wm_bench_busypoll_pass("spin",WM_BENCH_BUSYPOLL_SPIN_US)<0) return -1;
+  return 0;
+}
+
+/* Main entry point.
+ */
+
+int wm_bench_run(const char *name,int namec) {
+  if (!name) namec=0; else if (namec<0) { namec=0; while (name[namec]) namec++; }
+  int all=(!namec||((namec==1)&&(name[0]=='1')));
+  int ran=0;
+
+  #define BENCH(tag) if (all||((namec==sizeof(#tag)-1)&&!memcmp(name,#tag,namec))) { \
+    if (wm_bench_##tag()<0) return -1; \
+    ran=1; \
+  }
+  BENCH(fusion)
+  BENCH(extdecode)
+  BENCH(adpcm)
+  BENCH(speaker)
+  BENCH(latency)
+  BENCH(busypoll)
+  #undef BENCH
+
+  if (!ran) {
+    wm_log_error("Unknown benchmark '%.*s'",namec,name);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,14 @@
+/* wm_bench.h
+ * Microbenchmarks for the hot paths, run from the command line with "--benchmark[=NAME]".
+ * No device required. Results go to stdout, one line per measurement.
+ */
+
+#ifndef WM_BENCH_H
+#define WM_BENCH_H
+
+/* (name) selects one benchmark; empty or "1" runs them all.
+ * Returns <0 if (name) is unknown.
+ */
+int wm_bench_run(const char *name,int namec);
+
+#endif
@@ -0,0 +1,221 @@
+#include "wiimote.h"
+#include "wm_cache.h"
+#include "wm_text.h"
+#include "wm_fs.h"
+
+/* Object definition.
+ */
+
+struct wm_cache_entry {
+  char k[WM_CACHE_KEY_LIMIT+1];
+  uint8_t v[WM_CACHE_VALUE_LIMIT];
+  int vc;
+};
+
+struct wm_cache {
+  char *path;
+  struct wm_cache_entry *entryv;
+  int entryc,entrya;
+  int dirty;
+};
+
+/* Object lifecycle.
+ */
+
+struct wm_cache *wm_cache_new(const char *dir,const void *bdaddr) {
+  if (!bdaddr) return 0;
+  struct wm_cache *cache=calloc(1,sizeof(struct wm_cache));
+  if (!cache) return 0;
+
+  if (dir&&dir[0]) {
+    char name[18];
+    if (wm_bdaddr_repr(name,sizeof(name),bdaddr)!=17) {
+      wm_cache_del(cache);
+      return 0;
+    }
+    int pathc=snprintf(0,0,"%s/%s",dir,name);
+    if ((pathc<1)||!(cache->path=malloc(pathc+1))) {
+      wm_cache_del(cache);
+      return 0;
+    }
+    snprintf(cache->path,pathc+1,"%s/%s",dir,name);
+  }
+
+  return cache;
+}
+
+void wm_cache_del(struct wm_cache *cache) {
+  if (!cache) return;
+  if (cache->path) free(cache->path);
+  if (cache->entryv) free(cache->entryv);
+  free(cache);
+}
+
+/* Search entries.
+ */
+
+static struct wm_cache_entry *wm_cache_find(const struct wm_cache *cache,const char *k,int kc) {
+  struct wm_cache_entry *entry=cache->entryv;
+  int i=cache->entryc; for (;i-->0;entry++) {
+    if (memcmp(entry->k,k,kc)) continue;
+    if (entry->k[kc]) continue;
+    return entry;
+  }
+  return 0;
+}
+
+/* Get value.
+ */
+
+int wm_cache_get(void *dst,int dsta,const struct wm_cache *cache,const char *k) {
+  if (!cache||!k) return -1;
+  int kc=0; while (k[kc]) kc++;
+  if (kc>WM_CACHE_KEY_LIMIT) return -1;
+  const struct wm_cache_entry *entry=wm_cache_find(cache,k,kc);
+  if (!entry) return -1;
+  if (dst&&(entry->vc<=dsta)) memcpy(dst,entry->v,entry->vc);
+  return entry->vc;
+}
+
+/* Set value, from a key of known length.
+ */
+
+static int wm_cache_set_internal(struct wm_cache *cache,const char *k,int kc,const void *src,int srcc) {
+  if ((kc<1)||(kc>WM_CACHE_KEY_LIMIT)) return -1;
+  if (srcc>WM_CACHE_VALUE_LIMIT) return -1;
+  struct wm_cache_entry *entry=wm_cache_find(cache,k,kc);
+
+  if (srcc<0) {
+    if (!entry) return 0;
+    int p=entry-cache->entryv;
+    cache->entryc--;
+    memmove(entry,entry+1,sizeof(struct wm_cache_entry)*(cache->entryc-p));
+    cache->dirty=1;
+    return 0;
+  }
+
+  if (entry) {
+    if ((entry->vc==srcc)&&!memcmp(entry->v,src,srcc)) return 0;
+  } else {
+    if (cache->entryc>=cache->entrya) {
+      int na=cache->entrya+8;
+      void *nv=realloc(cache->entryv,sizeof(struct wm_cache_entry)*na);
+      if (!nv) return -1;
+      cache->entryv=nv;
+      cache->entrya=na;
+    }
+    entry=cache->entryv+cache->entryc++;
+    memset(entry,0,sizeof(struct wm_cache_entry));
+    memcpy(entry->k,k,kc);
+  }
+
+  memcpy(entry->v,src,srcc);
+  entry->vc=srcc;
+  cache->dirty=1;
+  return 0;
+}
+
+int wm_cache_set(struct wm_cache *cache,const char *k,const void *src,int srcc) {
+  if (!cache||!k) return -1;
+  if ((srcc>0)&&!src) return -1;
+  int kc=0; while (k[kc]) kc++;
+  return wm_cache_set_internal(cache,k,kc,src,srcc);
+}
+
+/* Load.
+ * Format is like the config file: "KEY=VALUE" per line, '#' begins a comment.
+ * VALUE is a hex dump, as produced by wm_report_repr().
+ */
+
+static int wm_cache_decode(struct wm_cache *cache,const char *src,int srcc) {
+  int srcp=0,lineno=1;
+  while (srcp<srcc) {
+    const char *k=src+srcp,*v=0;
+    int kc=0,vc=0,cmt=0;
+    while (srcp<srcc) {
+      if (src[srcp]==0x0a) {
+        srcp++;
+        break;
+      } else if (cmt) ;
+      else if (src[srcp]=='#') cmt=1;
+      else if (v) vc++;
+      else if (src[srcp]=='=') v=src+srcp+1;
+      else kc++;
+      srcp++;
+    }
+    while (kc&&((unsigned char)k[kc-1]<=0x20)) kc--;
+    while (kc&&((unsigned char)k[0]<=0x20)) { kc--; k++; }
+    if (kc) {
+      uint8_t tmp[WM_CACHE_VALUE_LIMIT];
+      int tmpc=wm_hex_eval(tmp,sizeof(tmp),v,vc);
+      if ((tmpc<0)||(tmpc>sizeof(tmp))||(wm_cache_set_internal(cache,k,kc,tmp,tmpc)<0)) {
+        wm_log_warning("%s:%d: Ignoring malformed cache entry.",cache->path,lineno);
+      }
+    }
+    lineno++;
+  }
+  return 0;
+}
+
+int wm_cache_load(struct wm_cache *cache) {
+  if (!cache) return -1;
+  cache->entryc=0;
+  cache->dirty=0;
+  if (!cache->path) return 0;
+
+  char *src=0;
+  int srcc=wm_file_read(&src,cache->path,0);
+  if (srcc<0) {
+    wm_log_debug("%s: Failed to read cache. Proceeding without it.",cache->path);
+    return 0;
+  }
+  if (!src) {
+    wm_log_debug("%s: No cache for this device yet.",cache->path);
+    return 0;
+  }
+  wm_cache_decode(cache,src,srcc);
+  free(src);
+  cache->dirty=0;
+  wm_log_debug("%s: Loaded %d cached item(s).",cache->path,cache->entryc);
+  return 0;
+}
+
+/* Save.
+ */
+
+int wm_cache_save(struct wm_cache *cache) {
+  if (!cache) return -1;
+  if (!cache->dirty) return 0;
+  if (!cache->path) {
+    cache->dirty=0;
+    return 0;
+  }
+
+  int dsta=64+cache->entryc*(WM_CACHE_KEY_LIMIT+WM_CACHE_VALUE_LIMIT*3+2);
+  char *dst=malloc(dsta);
+  if (!dst) return -1;
+  int dstc=snprintf(dst,dsta,"# wiimote cache, regenerated automatically.\n");
+  const struct wm_cache_entry *entry=cache->entryv;
+  int i=cache->entryc; for (;i-->0;entry++) {
+    dstc+=snprintf(dst+dstc,dsta-dstc,"%s=",entry->k);
+    dstc+=wm_report_repr(dst+dstc,dsta-dstc,entry->v,entry->vc);
+    dst[dstc++]=0x0a;
+  }
+
+  /* The directory is usually ours alone, so create it on demand. Its parent must exist. */
+  char *slash=strrchr(cache->path,'/');
+  if (slash&&(slash>cache->path)) {
+    *slash=0;
+    wm_dir_require(cache->path);
+    *slash='/';
+  }
+
+  int err=wm_file_write(cache->path,dst,dstc);
+  free(dst);
+  if (err<0) {
+    wm_log_debug("%s: Failed to write cache: %m",cache->path);
+    return 0;
+  }
+  cache->dirty=0;
+  return 0;
+}
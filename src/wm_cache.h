@@ -0,0 +1,34 @@
+/* wm_cache.h
+ * Persistent facts about one device, remembered across connections.
+ * We use it to skip slow handshakes after a reconnect: Cached values are only a guess, the caller must verify them.
+ * Stored as a small text file per bdaddr, in the directory named by config "cache-dir".
+ */
+
+#ifndef WM_CACHE_H
+#define WM_CACHE_H
+
+#define WM_CACHE_KEY_LIMIT    31
+#define WM_CACHE_VALUE_LIMIT  64
+
+struct wm_cache;
+
+/* (dir) may be null or empty, in which case we're an in-memory cache only.
+ * (bdaddr) is 6 raw bytes, as for wm_transport_new().
+ */
+struct wm_cache *wm_cache_new(const char *dir,const void *bdaddr);
+void wm_cache_del(struct wm_cache *cache);
+
+/* Missing or malformed files are not an error; the cache is just empty.
+ * Save does nothing if no value changed since the last load or save.
+ */
+int wm_cache_load(struct wm_cache *cache);
+int wm_cache_save(struct wm_cache *cache);
+
+/* Values are opaque binary blobs, up to WM_CACHE_VALUE_LIMIT bytes.
+ * Get returns the stored length, or <0 if absent. We copy out only if it fits.
+ * Set with (srcc<0) to remove a value.
+ */
+int wm_cache_get(void *dst,int dsta,const struct wm_cache *cache,const char *k);
+int wm_cache_set(struct wm_cache *cache,const char *k,const void *src,int srcc);
+
+#endif
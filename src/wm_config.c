@@ -2,6 +2,9 @@
 #include "wm_config.h"
 #include "wm_text.h"
 #include "wm_fs.h"
+#include "wm_enums.h"
+#include "wm_speaker.h"
+#include <sched.h>
 
 /* Object definition.
  */
@@ -21,7 +24,31 @@ struct wm_config {
   int daemonize;
   int nunchuk_separate;
   int classic_separate;
+  int motionplus;
+  int legacy_ext_init;
+  int orientation;
+  int accel;
+  int rumble;
+  int gesture_keys[WM_GESTURE_COUNT];
+  int ir;
+  int ir_sensitivity;
+  int ir_full;
   int verbosity;
+  char *cache_dir;
+  char *player_dir;
+  char *speaker;
+  int status_interval;
+  int continuous_idle;
+  int idle_disconnect;
+  int reader_thread;
+  int busy_poll;
+  int sched_policy;
+  int sched_priority;
+  char *cpu_affinity;
+  int mlock;
+  char *status_dir;
+  int speaker_rate;
+  int speaker_volume;
   char *device_name;
   int device_namec;
 };
@@ -40,7 +67,30 @@ struct wm_config *wm_config_new() {
     (wm_config_set_daemonize(config,1)<0)||
     (wm_config_set_nunchuk_separate(config,0)<0)||
     (wm_config_set_classic_separate(config,1)<0)||
+    (wm_config_set_motionplus(config,0)<0)||
+    (wm_config_set_legacy_ext_init(config,0)<0)||
+    (wm_config_set_orientation(config,0)<0)||
+    (wm_config_set_accel(config,0)<0)||
+    (wm_config_set_rumble(config,1)<0)||
+    (wm_config_set_ir(config,0)<0)||
+    (wm_config_set_ir_sensitivity(config,3)<0)||
+    (wm_config_set_ir_full(config,0)<0)||
     (wm_config_set_verbosity(config,3)<0)||
+    (wm_config_set_cache_dir(config,"/var/cache/wiimote",-1)<0)||
+    (wm_config_set_player_dir(config,"/run/wiimote",-1)<0)||
+    (wm_config_set_speaker(config,"",0)<0)||
+    (wm_config_set_status_interval(config,60)<0)||
+    (wm_config_set_continuous_idle(config,30)<0)||
+    (wm_config_set_idle_disconnect(config,0)<0)||
+    (wm_config_set_reader_thread(config,0)<0)||
+    (wm_config_set_busy_poll(config,0)<0)||
+    (wm_config_set_sched_policy(config,"other",-1)<0)||
+    (wm_config_set_sched_priority(config,50)<0)||
+    (wm_config_set_cpu_affinity(config,"",-1)<0)||
+    (wm_config_set_mlock(config,0)<0)||
+    (wm_config_set_status_dir(config,"/run/wiimote",-1)<0)||
+    (wm_config_set_speaker_rate(config,3000)<0)||
+    (wm_config_set_speaker_volume(config,64)<0)||
   0) {
     wm_config_del(config);
     return 0;
@@ -62,6 +112,11 @@ void wm_config_del(struct wm_config *config) {
   }
 
   if (config->uinput_path) free(config->uinput_path);
+  if (config->cache_dir) free(config->cache_dir);
+  if (config->cpu_affinity) free(config->cpu_affinity);
+  if (config->player_dir) free(config->player_dir);
+  if (config->speaker) free(config->speaker);
+  if (config->status_dir) free(config->status_dir);
   if (config->device_name) free(config->device_name);
 
   free(config);
@@ -94,7 +149,30 @@ int wm_config_set(struct wm_config *config,const char *k,int kc,const char *v,in
   INTFLD(retry_count,"retry-count")
   INTFLD(nunchuk_separate,"nunchuk-separate")
   INTFLD(classic_separate,"classic-separate")
+  INTFLD(motionplus,"motionplus")
+  INTFLD(legacy_ext_init,"legacy-ext-init")
+  INTFLD(orientation,"orientation")
+  INTFLD(accel,"accel")
+  INTFLD(rumble,"rumble")
+  INTFLD(ir,"ir")
+  INTFLD(ir_sensitivity,"ir-sensitivity")
+  INTFLD(ir_full,"ir-full")
   INTFLD(verbosity,"verbosity")
+  STRFLD(cache_dir,"cache-dir")
+  STRFLD(player_dir,"player-dir")
+  STRFLD(speaker,"speaker")
+  INTFLD(speaker_rate,"speaker-rate")
+  INTFLD(speaker_volume,"speaker-volume")
+  INTFLD(status_interval,"status-interval")
+  INTFLD(continuous_idle,"continuous-idle")
+  INTFLD(idle_disconnect,"idle-disconnect")
+  INTFLD(reader_thread,"reader-thread")
+  INTFLD(busy_poll,"busy-poll")
+  STRFLD(sched_policy,"sched-policy")
+  INTFLD(sched_priority,"sched-priority")
+  STRFLD(cpu_affinity,"cpu-affinity")
+  INTFLD(mlock,"mlock")
+  STRFLD(status_dir,"status-dir")
   STRFLD(device_name,"device-name")
 
   #undef STRFLD
@@ -104,6 +182,20 @@ int wm_config_set(struct wm_config *config,const char *k,int kc,const char *v,in
     if (wm_config_add_device_alias(config,k+7,kc-7,v,vc)<0) return -1;
     return 0;
   }
+
+  if ((kc>=8)&&!memcmp(k,"gesture.",8)) {
+    int gesture=wm_gesture_eval(k+8,kc-8);
+    if (gesture<0) {
+      wm_log_error("Unknown gesture '%.*s'.",kc-8,k+8);
+      return -1;
+    }
+    int vn;
+    if (wm_int_eval(&vn,v,vc)<0) {
+      wm_log_error("Failed to evaluate '%.*s' as key code for '%.*s'.",vc,v,kc,k);
+      return -1;
+    }
+    return wm_config_set_gesture_key(config,gesture,vn);
+  }
   
   return -1;
 }
@@ -237,6 +329,123 @@ int wm_config_get_classic_separate(const struct wm_config *config) {
   return config->classic_separate;
 }
 
+int wm_config_set_motionplus(struct wm_config *config,int motionplus) {
+  if (!config) return -1;
+  config->motionplus=motionplus?1:0;
+  return 0;
+}
+
+int wm_config_get_motionplus(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->motionplus;
+}
+
+int wm_config_set_legacy_ext_init(struct wm_config *config,int legacy_ext_init) {
+  if (!config) return -1;
+  config->legacy_ext_init=legacy_ext_init?1:0;
+  return 0;
+}
+
+int wm_config_get_legacy_ext_init(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->legacy_ext_init;
+}
+
+int wm_config_set_orientation(struct wm_config *config,int orientation) {
+  if (!config) return -1;
+  config->orientation=orientation?1:0;
+  return 0;
+}
+
+int wm_config_get_orientation(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->orientation;
+}
+
+int wm_config_set_accel(struct wm_config *config,int accel) {
+  if (!config) return -1;
+  config->accel=accel?1:0;
+  return 0;
+}
+
+int wm_config_get_accel(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->accel;
+}
+
+int wm_config_set_rumble(struct wm_config *config,int rumble) {
+  if (!config) return -1;
+  config->rumble=rumble?1:0;
+  return 0;
+}
+
+int wm_config_get_rumble(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->rumble;
+}
+
+int wm_config_set_gesture_key(struct wm_config *config,int gesture,int keycode) {
+  if (!config) return -1;
+  if ((gesture<0)||(gesture>=WM_GESTURE_COUNT)) return -1;
+  if ((keycode<0)||(keycode>0x2ff)) {
+    wm_log_error("Invalid key code %d for gesture '%s'.",keycode,wm_gesture_repr(gesture));
+    return -1;
+  }
+  config->gesture_keys[gesture]=keycode;
+  return 0;
+}
+
+int wm_config_get_gesture_key(const struct wm_config *config,int gesture) {
+  if (!config) return 0;
+  if ((gesture<0)||(gesture>=WM_GESTURE_COUNT)) return 0;
+  return config->gesture_keys[gesture];
+}
+
+int wm_config_has_gestures(const struct wm_config *config) {
+  if (!config) return 0;
+  int i; for (i=0;i<WM_GESTURE_COUNT;i++) {
+    if (config->gesture_keys[i]) return 1;
+  }
+  return 0;
+}
+
+int wm_config_set_ir(struct wm_config *config,int ir) {
+  if (!config) return -1;
+  config->ir=ir?1:0;
+  return 0;
+}
+
+int wm_config_get_ir(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->ir;
+}
+
+int wm_config_set_ir_sensitivity(struct wm_config *config,int ir_sensitivity) {
+  if (!config) return -1;
+  if ((ir_sensitivity<1)||(ir_sensitivity>5)) {
+    wm_log_error("Invalid IR sensitivity %d. (1..5)",ir_sensitivity);
+    return -1;
+  }
+  config->ir_sensitivity=ir_sensitivity;
+  return 0;
+}
+
+int wm_config_get_ir_sensitivity(const struct wm_config *config) {
+  if (!config) return 3;
+  return config->ir_sensitivity;
+}
+
+int wm_config_set_ir_full(struct wm_config *config,int ir_full) {
+  if (!config) return -1;
+  config->ir_full=ir_full?1:0;
+  return 0;
+}
+
+int wm_config_get_ir_full(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->ir_full;
+}
+
 int wm_config_set_verbosity(struct wm_config *config,int verbosity) {
   if (!config) return -1;
   if (verbosity<0) verbosity=0;
@@ -250,6 +459,256 @@ int wm_config_get_verbosity(const struct wm_config *config) {
   return config->verbosity;
 }
 
+int wm_config_set_cache_dir(struct wm_config *config,const char *src,int srcc) {
+  if (!config) return -1;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if (srcc>=1024) {
+    wm_log_error("Invalid length %d for cache_dir. (0..1023)",srcc);
+    return -1;
+  }
+  char *nv=malloc(srcc+1);
+  if (!nv) return -1;
+  memcpy(nv,src,srcc);
+  nv[srcc]=0;
+  if (config->cache_dir) free(config->cache_dir);
+  config->cache_dir=nv;
+  return 0;
+}
+
+const char *wm_config_get_cache_dir(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->cache_dir;
+}
+
+int wm_config_set_player_dir(struct wm_config *config,const char *src,int srcc) {
+  if (!config) return -1;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if (srcc>=1024) {
+    wm_log_error("Invalid length %d for player_dir. (0..1023)",srcc);
+    return -1;
+  }
+  char *nv=malloc(srcc+1);
+  if (!nv) return -1;
+  memcpy(nv,src,srcc);
+  nv[srcc]=0;
+  if (config->player_dir) free(config->player_dir);
+  config->player_dir=nv;
+  return 0;
+}
+
+const char *wm_config_get_player_dir(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->player_dir;
+}
+
+int wm_config_set_speaker(struct wm_config *config,const char *src,int srcc) {
+  if (!config) return -1;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if (srcc>=1024) {
+    wm_log_error("Invalid length %d for speaker. (0..1023)",srcc);
+    return -1;
+  }
+  char *nv=malloc(srcc+1);
+  if (!nv) return -1;
+  memcpy(nv,src,srcc);
+  nv[srcc]=0;
+  if (config->speaker) free(config->speaker);
+  config->speaker=nv;
+  return 0;
+}
+
+const char *wm_config_get_speaker(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->speaker;
+}
+
+int wm_config_set_speaker_rate(struct wm_config *config,int speaker_rate) {
+  if (!config) return -1;
+  if ((speaker_rate<WM_SPEAKER_RATE_MIN)||(speaker_rate>WM_SPEAKER_RATE_MAX)) {
+    wm_log_error("Invalid speaker rate %d. (%d..%d)",speaker_rate,WM_SPEAKER_RATE_MIN,WM_SPEAKER_RATE_MAX);
+    return -1;
+  }
+  config->speaker_rate=speaker_rate;
+  return 0;
+}
+
+int wm_config_get_speaker_rate(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->speaker_rate;
+}
+
+int wm_config_set_speaker_volume(struct wm_config *config,int speaker_volume) {
+  if (!config) return -1;
+  if ((speaker_volume<0)||(speaker_volume>127)) {
+    wm_log_error("Invalid speaker volume %d. (0..127)",speaker_volume);
+    return -1;
+  }
+  config->speaker_volume=speaker_volume;
+  return 0;
+}
+
+int wm_config_get_speaker_volume(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->speaker_volume;
+}
+
+int wm_config_set_status_interval(struct wm_config *config,int status_interval) {
+  if (!config) return -1;
+  if ((status_interval<0)||(status_interval>86400)) {
+    wm_log_error("Invalid status interval %d. (0..86400)",status_interval);
+    return -1;
+  }
+  config->status_interval=status_interval;
+  return 0;
+}
+
+int wm_config_get_status_interval(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->status_interval;
+}
+
+int wm_config_set_continuous_idle(struct wm_config *config,int continuous_idle) {
+  if (!config) return -1;
+  if ((continuous_idle<0)||(continuous_idle>86400)) {
+    wm_log_error("Invalid continuous idle time %d. (0..86400)",continuous_idle);
+    return -1;
+  }
+  config->continuous_idle=continuous_idle;
+  return 0;
+}
+
+int wm_config_get_continuous_idle(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->continuous_idle;
+}
+
+int wm_config_set_idle_disconnect(struct wm_config *config,int idle_disconnect) {
+  if (!config) return -1;
+  if ((idle_disconnect<0)||(idle_disconnect>86400)) {
+    wm_log_error("Invalid idle disconnect time %d. (0..86400)",idle_disconnect);
+    return -1;
+  }
+  config->idle_disconnect=idle_disconnect;
+  return 0;
+}
+
+int wm_config_get_idle_disconnect(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->idle_disconnect;
+}
+
+int wm_config_set_reader_thread(struct wm_config *config,int reader_thread) {
+  if (!config) return -1;
+  config->reader_thread=reader_thread?1:0;
+  return 0;
+}
+
+int wm_config_get_reader_thread(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->reader_thread;
+}
+
+int wm_config_set_busy_poll(struct wm_config *config,int busy_poll) {
+  if (!config) return -1;
+  if ((busy_poll<0)||(busy_poll>1000000)) {
+    wm_log_error("Invalid busy poll time %d. (0..1000000)",busy_poll);
+    return -1;
+  }
+  config->busy_poll=busy_poll;
+  return 0;
+}
+
+int wm_config_get_busy_poll(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->busy_poll;
+}
+
+int wm_config_set_sched_policy(struct wm_config *config,const char *src,int srcc) {
+  if (!config) return -1;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if ((srcc==5)&&!memcmp(src,"other",5)) config->sched_policy=SCHED_OTHER;
+  else if ((srcc==4)&&!memcmp(src,"fifo",4)) config->sched_policy=SCHED_FIFO;
+  else if ((srcc==2)&&!memcmp(src,"rr",2)) config->sched_policy=SCHED_RR;
+  else {
+    wm_log_error("Invalid scheduling policy '%.*s'. (other,fifo,rr)",srcc,src);
+    return -1;
+  }
+  return 0;
+}
+
+int wm_config_get_sched_policy(const struct wm_config *config) {
+  if (!config) return SCHED_OTHER;
+  return config->sched_policy;
+}
+
+int wm_config_set_sched_priority(struct wm_config *config,int sched_priority) {
+  if (!config) return -1;
+  if ((sched_priority<1)||(sched_priority>99)) {
+    wm_log_error("Invalid scheduling priority %d. (1..99)",sched_priority);
+    return -1;
+  }
+  config->sched_priority=sched_priority;
+  return 0;
+}
+
+int wm_config_get_sched_priority(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->sched_priority;
+}
+
+int wm_config_set_cpu_affinity(struct wm_config *config,const char *src,int srcc) {
+  if (!config) return -1;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if (srcc>=1024) {
+    wm_log_error("Invalid length %d for cpu_affinity. (0..1023)",srcc);
+    return -1;
+  }
+  char *nv=malloc(srcc+1);
+  if (!nv) return -1;
+  memcpy(nv,src,srcc);
+  nv[srcc]=0;
+  if (config->cpu_affinity) free(config->cpu_affinity);
+  config->cpu_affinity=nv;
+  return 0;
+}
+
+const char *wm_config_get_cpu_affinity(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->cpu_affinity;
+}
+
+int wm_config_set_mlock(struct wm_config *config,int mlock) {
+  if (!config) return -1;
+  config->mlock=mlock?1:0;
+  return 0;
+}
+
+int wm_config_get_mlock(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->mlock;
+}
+
+int wm_config_set_status_dir(struct wm_config *config,const char *src,int srcc) {
+  if (!config) return -1;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if (srcc>=1024) {
+    wm_log_error("Invalid length %d for status_dir. (0..1023)",srcc);
+    return -1;
+  }
+  char *nv=malloc(srcc+1);
+  if (!nv) return -1;
+  memcpy(nv,src,srcc);
+  nv[srcc]=0;
+  if (config->status_dir) free(config->status_dir);
+  config->status_dir=nv;
+  return 0;
+}
+
+const char *wm_config_get_status_dir(const struct wm_config *config) {
+  if (!config) return 0;
+  return config->status_dir;
+}
+
 int wm_config_set_device_name(struct wm_config *config,const char *src,int srcc) {
   if (!config) return -1;
   if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
@@ -41,9 +41,103 @@ int wm_config_get_nunchuk_separate(const struct wm_config *config);
 int wm_config_set_classic_separate(struct wm_config *config,int classic_separate);
 int wm_config_get_classic_separate(const struct wm_config *config);
 
+int wm_config_set_motionplus(struct wm_config *config,int motionplus);
+int wm_config_get_motionplus(const struct wm_config *config);
+
+// Initialize extensions the old, encrypted way first. Otherwise we only fall back to it when the new way fails.
+int wm_config_set_legacy_ext_init(struct wm_config *config,int legacy_ext_init);
+int wm_config_get_legacy_ext_init(const struct wm_config *config);
+
+// Roll, pitch, and yaw (with MotionPlus) on the core device.
+int wm_config_set_orientation(struct wm_config *config,int orientation);
+int wm_config_get_orientation(const struct wm_config *config);
+
+// Report the raw accelerometer on the core device, even if nothing else needs it.
+int wm_config_set_accel(struct wm_config *config,int accel);
+int wm_config_get_accel(const struct wm_config *config);
+
+// Offer force feedback (FF_RUMBLE) on the core device.
+int wm_config_set_rumble(struct wm_config *config,int rumble);
+int wm_config_get_rumble(const struct wm_config *config);
+
+/* Key code (from <linux/input-event-codes.h>) for each WM_GESTURE_*, zero to disable.
+ * In the config file: "gesture.swing-left=105"
+ */
+int wm_config_set_gesture_key(struct wm_config *config,int gesture,int keycode);
+int wm_config_get_gesture_key(const struct wm_config *config,int gesture);
+int wm_config_has_gestures(const struct wm_config *config);
+
+int wm_config_set_ir(struct wm_config *config,int ir);
+int wm_config_get_ir(const struct wm_config *config);
+
+// 1..5, higher is more sensitive.
+int wm_config_set_ir_sensitivity(struct wm_config *config,int ir_sensitivity);
+int wm_config_get_ir_sensitivity(const struct wm_config *config);
+
+// Full camera mode, with dot intensity. Only while no extension is connected.
+int wm_config_set_ir_full(struct wm_config *config,int ir_full);
+int wm_config_get_ir_full(const struct wm_config *config);
+
 int wm_config_set_verbosity(struct wm_config *config,int verbosity);
 int wm_config_get_verbosity(const struct wm_config *config);
 
+// Empty to disable the on-disk cache.
+int wm_config_set_cache_dir(struct wm_config *config,const char *src,int srcc);
+const char *wm_config_get_cache_dir(const struct wm_config *config);
+
+// Lock files for player slots, shared by every wiimote process. Empty to light all four LEDs instead.
+int wm_config_set_player_dir(struct wm_config *config,const char *src,int srcc);
+const char *wm_config_get_player_dir(const struct wm_config *config);
+
+/* Speaker: Path to a file or FIFO of signed 16-bit little-endian mono PCM at (speaker_rate) Hz.
+ * Empty to leave the speaker off.
+ */
+int wm_config_set_speaker(struct wm_config *config,const char *src,int srcc);
+const char *wm_config_get_speaker(const struct wm_config *config);
+int wm_config_set_speaker_rate(struct wm_config *config,int speaker_rate);
+int wm_config_get_speaker_rate(const struct wm_config *config);
+int wm_config_set_speaker_volume(struct wm_config *config,int speaker_volume); // 0..127
+int wm_config_get_speaker_volume(const struct wm_config *config);
+
+// Seconds between status requests (for battery level), zero to only take what the remote volunteers.
+int wm_config_set_status_interval(struct wm_config *config,int status_interval);
+int wm_config_get_status_interval(const struct wm_config *config);
+
+// Seconds of no input before motion reports drop from continuous to change-only. Zero to never stream.
+int wm_config_set_continuous_idle(struct wm_config *config,int continuous_idle);
+int wm_config_get_continuous_idle(const struct wm_config *config);
+
+// Seconds of no input before we drop the connection, which turns the remote off. Zero to stay connected.
+int wm_config_set_idle_disconnect(struct wm_config *config,int idle_disconnect);
+int wm_config_get_idle_disconnect(const struct wm_config *config);
+
+// Read from the remote on a separate thread, so decoding and uinput never hold up the socket.
+int wm_config_set_reader_thread(struct wm_config *config,int reader_thread);
+int wm_config_get_reader_thread(const struct wm_config *config);
+
+// Microseconds the reader thread spins on the socket before sleeping, zero to not spin. Implies reader-thread.
+int wm_config_set_busy_poll(struct wm_config *config,int busy_poll);
+int wm_config_get_busy_poll(const struct wm_config *config);
+
+// Scheduling for the whole process, including the reader thread: "other" (normal), "fifo", or "rr".
+// Priority 1..99 only matters for fifo and rr.
+int wm_config_set_sched_policy(struct wm_config *config,const char *src,int srcc);
+int wm_config_get_sched_policy(const struct wm_config *config); // SCHED_*
+int wm_config_set_sched_priority(struct wm_config *config,int sched_priority);
+int wm_config_get_sched_priority(const struct wm_config *config);
+
+// CPUs to run on, eg "2" or "0,2-3". Empty for any.
+int wm_config_set_cpu_affinity(struct wm_config *config,const char *src,int srcc);
+const char *wm_config_get_cpu_affinity(const struct wm_config *config);
+
+// Lock and prefault all memory after startup, so the input path never waits on a page fault.
+int wm_config_set_mlock(struct wm_config *config,int mlock);
+int wm_config_get_mlock(const struct wm_config *config);
+
+// Battery status files, one per remote named by address. Empty to disable.
+int wm_config_set_status_dir(struct wm_config *config,const char *src,int srcc);
+const char *wm_config_get_status_dir(const struct wm_config *config);
+
 int wm_config_set_device_name(struct wm_config *config,const char *src,int srcc);
 const char *wm_config_get_device_name(const struct wm_config *config);
 
@@ -6,25 +6,96 @@
 #include "wm_report.h"
 #include "wm_enums.h"
 #include "wm_text.h"
+#include "wm_cache.h"
+#include "wm_stats.h"
+#include "wm_output.h"
+#include "wm_pointer.h"
+#include "wm_gesture.h"
+#include "wm_extdesc.h"
+#include "wm_rumble.h"
+#include "wm_player.h"
+#include "wm_speaker.h"
+#include "wm_fs.h"
+#include "wm_reader.h"
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 
 #define WM_EXT_STATE_UNSET      0
-#define WM_EXT_STATE_WAIT_ACK1  1
-#define WM_EXT_STATE_WAIT_ACK2  2
-#define WM_EXT_STATE_WAIT_EXTID 3
+#define WM_EXT_STATE_PENDING    1 /* Init writes and ID read are in flight. */
+#define WM_EXT_STATE_FAILED     2 /* Something failed, waiting for the rest of the replies to drain. */
+#define WM_EXT_STATE_RETRY      3 /* Failed, and will try the other init method once the replies drain. */
+
+/* Tags for wm_output operations. */
+#define WM_COORD_TAG_EXT_INIT   1
+#define WM_COORD_TAG_EXT_ID     2
+#define WM_COORD_TAG_ACCEL_CAL  3
+#define WM_COORD_TAG_EXT_CAL    4
+#define WM_COORD_TAG_IR_INIT    5
+#define WM_COORD_TAG_MP_PROBE   6
+#define WM_COORD_TAG_MP_INIT    7
+#define WM_COORD_TAG_MP_CAL     8
+#define WM_COORD_TAG_SPEAKER    9
+
+#define WM_MP_STATE_NONE        0 /* Not present, not enabled, or not probed yet. */
+#define WM_MP_STATE_PROBING     1 /* Read of 0x04a600fa in flight. */
+#define WM_MP_STATE_INACTIVE    2 /* Present at 0x04a6, its passthrough extension (if any) at 0x04a4. */
+#define WM_MP_STATE_ACTIVATING  3 /* Mode written to 0x04a600fe, waiting for the extension handshake to see it. */
+#define WM_MP_STATE_ACTIVE      4 /* Reporting gyro through the extension bytes. */
+
+#define WM_COORD_STATUS_BACKOFF_LIMIT 8 /* Idle remotes get status requests up to this many times less often. */
+#define WM_COORD_BATTERY_FULL 0xc8 /* Battery level for 100%. */
+#define WM_COORD_RECONNECT_INTERVAL_US 5000000 /* Between pages of an idle-disconnected remote. A page itself takes about 5 s. */
 
 /* Object definition.
  */
 
 struct wm_coord {
   struct wm_transport *transport;
+  struct wm_reader *reader; // Reads (transport) on its own thread, if configured and connected.
+  struct wm_output *output;
   struct wm_report *report;
   struct wm_delivery *delivery_core;
   struct wm_delivery *delivery_ext; // Always exists but not always connected.
+  struct wm_delivery *delivery_pointer; // Connected when IR is enabled.
+  struct wm_delivery *delivery_gyro; // Connected while a MotionPlus is active.
+  struct wm_pointer *pointer;
+  struct wm_rumble *rumble; // Present if force feedback is enabled. Fed by delivery_core.
   struct wm_config *config; // WEAK
+  struct wm_cache *cache;
+  struct wm_player *player;
+  struct wm_speaker *speaker; // Present if configured.
+  int speaker_ackc; // Setup writes outstanding. We stream only after they all succeed.
+  int speaker_ready;
+  int64_t last_activity; // Last change a person made. See wm_coord_note_activity().
+  int64_t status_interval; // us, base interval from config. Zero to not poll.
+  int64_t status_backoff; // us, current interval, between (status_interval) and WM_COORD_STATUS_BACKOFF_LIMIT times that.
+  int64_t status_next; // When to send the next 0x15.
+  int battery_low;
+  int64_t continuous_idle; // us from config. Zero to never stream.
+  int continuous; // Last continuous bit sent with 0x12.
+  int64_t idle_disconnect; // us from config. Zero to stay connected.
+  int64_t connect_time; // When the current connection's handshake began.
+  int64_t reconnect_next; // Nonzero while disconnected for idleness: When to page the remote again.
+  int leds; // Last LED state sent to the device, bits 0..3.
+  uint8_t bdaddr[6];
   int startup;
   int ext_state;
   int extid;
+  int ext_optimistic; // Nonzero if (extid) came from the cache and the handshake hasn't confirmed it yet.
+  int ext_legacy; // Current or last handshake used the old, encrypted init.
+  int ext_fallback; // Current handshake is already the second attempt.
+  int64_t ext_present_time; // Nonzero until we see the first extension input.
+  int ir_mode; // Last mode written to the IR camera, zero if it's off.
+  int accel[3]; // Most recent core accelerometer, for the pointer and gestures.
+  int accel_dirty; // (accel) changed in the report being delivered.
+  int nunchuk_accel[3];
+  int gestures; // Nonzero if any gesture is mapped.
+  struct wm_gesture gesture_core;
+  struct wm_gesture gesture_nunchuk;
+  int mp_state;
+  int mp_expect_ext; // Deactivated because something was plugged into the MotionPlus, don't reactivate until we know what.
+  struct wm_stats stats;
 };
 
 /* Object lifecycle.
@@ -34,16 +105,28 @@ struct wm_coord *wm_coord_new() {
   struct wm_coord *coord=calloc(1,sizeof(struct wm_coord));
   if (!coord) return 0;
 
+  coord->stats.battery=-1;
+  coord->stats.start_time=wm_now_us();
+
   return coord;
 }
 
 void wm_coord_del(struct wm_coord *coord) {
   if (!coord) return;
   
+  wm_output_del(coord->output);
+  wm_reader_del(coord->reader);
   wm_transport_del(coord->transport);
   wm_report_del(coord->report);
   wm_delivery_del(coord->delivery_core);
   wm_delivery_del(coord->delivery_ext);
+  wm_delivery_del(coord->delivery_pointer);
+  wm_delivery_del(coord->delivery_gyro);
+  wm_pointer_del(coord->pointer);
+  wm_rumble_del(coord->rumble);
+  wm_cache_del(coord->cache);
+  wm_player_del(coord->player);
+  wm_speaker_del(coord->speaker);
 
   free(coord);
 }
@@ -56,24 +139,250 @@ static int wm_coord_requires_delivery_ext(const struct wm_coord *coord) {
     case WM_DEVICE_TYPE_NUNCHUK: return wm_config_get_nunchuk_separate(coord->config);
     case WM_DEVICE_TYPE_CLASSIC: return wm_config_get_classic_separate(coord->config);
   }
+  /* Everything else is described by wm_extdesc and always gets its own device. */
+  return coord->extid?1:0;
+}
+
+/* Queue a report-mode change, using the report's current rptid.
+ */
+
+static int wm_coord_send_rptid(struct wm_coord *coord) {
+  uint8_t req[32];
+  int reqc=wm_report_compose_rptid(req,sizeof(req),coord->report);
+  if (reqc<0) return -1;
+  return wm_output_set_state(coord->output,req,reqc);
+}
+
+/* IR camera.
+ * The camera's data format must agree with the report mode: Extended (3) for 0x33, Basic (1) for 0x36 and 0x37, Full (5) for 0x3e/0x3f.
+ * Sensitivity blocks are the well-known settings from WiiBrew, levels 1..5.
+ */
+
+static const uint8_t wm_ir_sensitivity_block1[5][9]={
+  {0x02,0x00,0x00,0x71,0x01,0x00,0x64,0x00,0xfe},
+  {0x02,0x00,0x00,0x71,0x01,0x00,0x96,0x00,0xb4},
+  {0x02,0x00,0x00,0x71,0x01,0x00,0xaa,0x00,0x64},
+  {0x02,0x00,0x00,0x71,0x01,0x00,0xc8,0x00,0x36},
+  {0x07,0x00,0x00,0x71,0x01,0x00,0x72,0x00,0x20},
+};
+static const uint8_t wm_ir_sensitivity_block2[5][2]={
+  {0xfd,0x05},
+  {0xb3,0x04},
+  {0x63,0x03},
+  {0x35,0x03},
+  {0x1f,0x03},
+};
+
+static int wm_coord_ir_mode_for_rptid(uint8_t rptid) {
+  switch (rptid) {
+    case 0x33: return 3;
+    case 0x36: case 0x37: return 1;
+    case 0x3e: case 0x3f: return 5;
+  }
+  return 0;
+}
+
+static int wm_coord_ir_enable(struct wm_coord *coord,int mode) {
+  if (mode==coord->ir_mode) return 0;
+  uint8_t req[32];
+  int reqc;
+
+  if (!mode) {
+    wm_log_debug("Disabling IR camera.");
+    if ((reqc=wm_report_compose_ir_enable(req,sizeof(req),coord->report,0x13,0))<0) return -1;
+    if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+    if ((reqc=wm_report_compose_ir_enable(req,sizeof(req),coord->report,0x1a,0))<0) return -1;
+    if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+    coord->ir_mode=0;
+    return 0;
+  }
+
+  int level=wm_config_get_ir_sensitivity(coord->config)-1;
+  if ((level<0)||(level>=5)) level=2;
+  uint8_t mode8=mode;
+  wm_log_debug("Enabling IR camera, mode %d, sensitivity %d.",mode,level+1);
+
+  if (!coord->ir_mode) {
+    if ((reqc=wm_report_compose_ir_enable(req,sizeof(req),coord->report,0x13,1))<0) return -1;
+    if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+    if ((reqc=wm_report_compose_ir_enable(req,sizeof(req),coord->report,0x1a,1))<0) return -1;
+    if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+    if (wm_output_write(coord->output,0x04b00030,"\x08",1,WM_COORD_TAG_IR_INIT)<0) return -1;
+    if (wm_output_write(coord->output,0x04b00000,wm_ir_sensitivity_block1[level],9,WM_COORD_TAG_IR_INIT)<0) return -1;
+    if (wm_output_write(coord->output,0x04b0001a,wm_ir_sensitivity_block2[level],2,WM_COORD_TAG_IR_INIT)<0) return -1;
+  }
+  if (wm_output_write(coord->output,0x04b00033,&mode8,1,WM_COORD_TAG_IR_INIT)<0) return -1;
+  if (wm_output_write(coord->output,0x04b00030,"\x08",1,WM_COORD_TAG_IR_INIT)<0) return -1;
+  coord->ir_mode=mode;
+  return 0;
+}
+
+/* Report modes, smallest first, with what each one carries.
+ * (size) is bytes after the report ID, (ir) and (ext) are byte counts.
+ * We take the first that has everything we need, so nothing rides along unused.
+ * 0x3e and 0x3f are the two halves of the interleaved mode, each listed with what the pair carries.
+ * Asking for either gets both, so we only ever choose 0x3e.
+ */
+
+static const struct wm_coord_mode {
+  uint8_t rptid,size,accel,ir,ext;
+} wm_coord_modev[]={
+  {0x30, 2,0, 0, 0},
+  {0x31, 5,1, 0, 0},
+  {0x32,10,0, 0, 8},
+  {0x33,17,1,12, 0},
+  {0x34,21,0, 0,19},
+  {0x35,21,1, 0,16},
+  {0x36,21,0,10, 9},
+  {0x37,21,1,10, 6},
+  {0x3e,21,1,36, 0},
+  {0x3f,21,1,36, 0},
+};
+
+static const struct wm_coord_mode *wm_coord_mode_for_rptid(uint8_t rptid) {
+  const struct wm_coord_mode *mode=wm_coord_modev;
+  int i=sizeof(wm_coord_modev)/sizeof(struct wm_coord_mode); for (;i-->0;mode++) {
+    if (mode->rptid==rptid) return mode;
+  }
   return 0;
 }
 
-/* Finish extension handshake with ID translated to a known extension.
+/* Choose the report mode for what's enabled and connected, and send it if changed.
+ * The pointer needs the accelerometer too, to undo the remote's roll.
+ * Full IR needs 36 camera bytes, and there's no mode with that and an extension, so it yields to the extension.
+ * The Balance Board needs 8 extension bytes, and it has no camera or accelerometer worth reading.
+ */
+
+static uint8_t wm_coord_choose_rptid(const struct wm_coord *coord) {
+  int ir=wm_config_get_ir(coord->config)?(wm_config_get_ir_full(coord->config)?36:10):0;
+  int accel=ir||wm_config_get_accel(coord->config)||wm_config_get_orientation(coord->config)||coord->gestures;
+  int ext=(coord->extid||(coord->mp_state==WM_MP_STATE_ACTIVE))?6:0;
+  if (coord->extid==WM_DEVICE_TYPE_BALANCE) {
+    ir=accel=0;
+    ext=8;
+  }
+  const struct wm_coord_mode *mode=wm_coord_modev;
+  int i=sizeof(wm_coord_modev)/sizeof(struct wm_coord_mode); for (;i-->0;mode++) {
+    if (accel&&!mode->accel) continue;
+    if (ir>mode->ir) continue;
+    if (ext>mode->ext) continue;
+    return mode->rptid;
+  }
+  return 0x37;
+}
+
+/* Microseconds since the last activity. Idle disconnect, continuous reporting, and status backoff all go by this.
+ */
+
+static int64_t wm_coord_idle_us(const struct wm_coord *coord,int64_t now) {
+  return now-coord->last_activity;
+}
+
+/* Continuous reporting.
+ * Streaming at a fixed rate only helps consumers of motion data, and only while someone is holding the remote.
+ * So we stream while the report carries accelerometer, IR, or gyro, and drop to change-only after (continuous_idle).
+ * The first activity after that turns it back on.
+ */
+
+static int wm_coord_want_continuous(const struct wm_coord *coord,uint8_t rptid) {
+  if (!coord->continuous_idle) return 0;
+  if (wm_coord_idle_us(coord,wm_now_us())>=coord->continuous_idle) return 0;
+  if (coord->mp_state==WM_MP_STATE_ACTIVE) return 1;
+  const struct wm_coord_mode *mode=wm_coord_mode_for_rptid(rptid);
+  if (!mode) return 0;
+  return mode->accel||mode->ir;
+}
+
+static int wm_coord_set_continuous(struct wm_coord *coord,int continuous) {
+  if (continuous==coord->continuous) return 0;
+  wm_log_debug("%s reporting.",continuous?"Continuous":"Change-only");
+  if (continuous) coord->stats.continuous_on++;
+  else coord->stats.continuous_off++;
+  coord->continuous=continuous;
+  return wm_report_set_continuous(coord->report,continuous);
+}
+
+static int wm_coord_update_continuous(struct wm_coord *coord) {
+  int continuous=wm_coord_want_continuous(coord,wm_report_get_rptid(coord->report));
+  if (continuous==coord->continuous) return 0;
+  if (wm_coord_set_continuous(coord,continuous)<0) return -1;
+  return wm_coord_send_rptid(coord);
+}
+
+/* Milliseconds until we go idle and stop streaming, or <0 if not streaming.
+ */
+
+static int wm_coord_continuous_timeout(const struct wm_coord *coord) {
+  if (!coord->continuous) return -1;
+  int64_t us=coord->continuous_idle-wm_coord_idle_us(coord,wm_now_us());
+  if (us<=0) return 0;
+  if (us>INT_MAX/2) return INT_MAX/2;
+  return (us+999)/1000;
+}
+
+static int wm_coord_update_report_mode(struct wm_coord *coord,int force) {
+  uint8_t rptid=wm_coord_choose_rptid(coord);
+  int continuous=wm_coord_want_continuous(coord,rptid);
+  if (!force&&(rptid==wm_report_get_rptid(coord->report))&&(continuous==coord->continuous)) return 0;
+  if (wm_coord_set_continuous(coord,continuous)<0) return -1;
+  wm_log_debug("Report mode 0x%02x, %d bytes",rptid,wm_coord_mode_for_rptid(rptid)->size);
+  if (wm_report_set_rptid(coord->report,rptid)<0) return -1;
+  if (wm_coord_ir_enable(coord,wm_coord_ir_mode_for_rptid(rptid))<0) return -1;
+  if (wm_coord_send_rptid(coord)<0) return -1;
+  return 0;
+}
+
+/* Extension calibration is cached per extension type, since you can swap extensions between remotes.
+ */
+
+static int wm_coord_compose_ext_cal_key(char *dst,int dsta,int extid) {
+  const char *name=wm_device_type_repr(extid);
+  if (!name) return -1;
+  int dstc=snprintf(dst,dsta,"ext-cal.%s",name);
+  if ((dstc<1)||(dstc>=dsta)) return -1;
+  return dstc;
+}
+
+static int wm_coord_apply_cached_extension_calibration(struct wm_coord *coord) {
+  char k[32];
+  uint8_t cal[24];
+  if (wm_coord_compose_ext_cal_key(k,sizeof(k),coord->extid)<0) return 0;
+  int calc=wm_cache_get(cal,sizeof(cal),coord->cache,k);
+  if ((calc<16)||(calc>sizeof(cal))) return 0;
+  wm_report_set_extension_calibration(coord->report,cal,calc);
+  return 0;
+}
+
+static int wm_coord_receive_extension_calibration(struct wm_coord *coord,const void *src,int srcc) {
+  char k[32];
+  uint8_t plain[32];
+  if (!coord->extid) return 0;
+  if (coord->ext_legacy) {
+    if (srcc>sizeof(plain)) srcc=sizeof(plain);
+    wm_report_decrypt(plain,src,srcc);
+    src=plain;
+  }
+  if (wm_report_set_extension_calibration(coord->report,src,srcc)<0) return 0;
+  if (wm_coord_compose_ext_cal_key(k,sizeof(k),coord->extid)<0) return 0;
+  wm_cache_set(coord->cache,k,src,srcc);
+  wm_cache_save(coord->cache);
+  return 0;
+}
+
+/* Begin reporting for a known extension.
+ * This may happen before the handshake completes, if we're trusting the cache.
  */
 
 static int wm_coord_accept_extension(struct wm_coord *coord,int extid) {
+  if (coord->extid==extid) return 0;
   coord->extid=extid;
 
-  uint8_t req[32];
-  int reqc;
-  if (wm_report_set_rptid(coord->report,0x34)<0) return -1;
-  if ((reqc=wm_report_compose_rptid(req,sizeof(req),coord->report))<0) return -1;
-  if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
+  if (wm_coord_update_report_mode(coord,0)<0) return -1;
 
   wm_log_info("Connected extension '%s'",wm_device_type_repr(extid));
 
   if (wm_report_set_extension(coord->report,extid)<0) return -1;
+  if (wm_coord_apply_cached_extension_calibration(coord)<0) return -1;
 
   if (wm_coord_requires_delivery_ext(coord)) {
     wm_log_debug("Must create separate delivery for extension.");
@@ -86,54 +395,313 @@ static int wm_coord_accept_extension(struct wm_coord *coord,int extid) {
   return 0;
 }
 
+/* Stop reporting for the current extension.
+ */
+
+static int wm_coord_drop_extension(struct wm_coord *coord) {
+  coord->ext_optimistic=0;
+  if (!coord->extid) return 0;
+  coord->extid=0;
+  if (wm_report_set_extension(coord->report,0)<0) return -1;
+  if (wm_report_set_extension_encrypted(coord->report,0)<0) return -1;
+  if (wm_delivery_disconnect(coord->delivery_ext)<0) return -1;
+  if (wm_coord_update_report_mode(coord,0)<0) return -1;
+  return 0;
+}
+
+/* Translate a raw extension ID (6 bytes) to WM_DEVICE_TYPE_*, or zero if unknown.
+ * Known IDs are listed in wm_extdesc.c.
+ */
+
+static int wm_coord_extid_eval(const uint8_t *rawid) {
+  const struct wm_extdesc *desc=wm_extdesc_for_id(rawid);
+  if (!desc) return 0;
+  return desc->device_type;
+}
+
+/* Read calibration for the current extension, if it's one that has any.
+ */
+
+static int wm_coord_read_extension_calibration(struct wm_coord *coord) {
+  switch (coord->extid) {
+    case WM_DEVICE_TYPE_NUNCHUK:
+    case WM_DEVICE_TYPE_CLASSIC:
+      return wm_output_read(coord->output,0x04a40020,16,WM_COORD_TAG_EXT_CAL);
+    case WM_DEVICE_TYPE_BALANCE:
+      return wm_output_read(coord->output,0x04a40024,24,WM_COORD_TAG_EXT_CAL);
+  }
+  return 0;
+}
+
+/* MotionPlus.
+ * It sits between the remote and any other extension, and has two personalities:
+ *   Inactive: Lives at 0x04a6, and its passthrough extension (if any) is visible at 0x04a4 as usual.
+ *   Active: Replaces the extension at 0x04a4, ID xx xx a4 20 MM 05 where MM is the mode:
+ *     04: MotionPlus only. 05: Nunchuk passthrough. 07: Classic passthrough.
+ * Writing 0x55 to 0x04a400f0 deactivates it, and writing the mode to 0x04a600fe activates it.
+ * Either way, the remote reports an extension change and our regular handshake sorts it out.
+ * To learn what's plugged into it, we deactivate, let the handshake identify the extension, then activate in the matching mode.
+ */
+
+static int wm_coord_probe_motionplus(struct wm_coord *coord) {
+  if (!wm_config_get_motionplus(coord->config)) return 0;
+  if (coord->mp_state!=WM_MP_STATE_NONE) return 0;
+  wm_log_debug("Probing for MotionPlus.");
+  if (wm_output_write(coord->output,0x04a600f0,"\x55",1,WM_COORD_TAG_MP_PROBE)<0) return -1;
+  if (wm_output_read(coord->output,0x04a600fa,6,WM_COORD_TAG_MP_PROBE)<0) return -1;
+  coord->mp_state=WM_MP_STATE_PROBING;
+  return 0;
+}
+
+static int wm_coord_activate_motionplus(struct wm_coord *coord) {
+  if (coord->mp_state!=WM_MP_STATE_INACTIVE) return 0;
+  uint8_t mode;
+  switch (coord->extid) {
+    case WM_DEVICE_TYPE_NUNCHUK: mode=0x05; break;
+    case WM_DEVICE_TYPE_CLASSIC: mode=0x07; break;
+    default: mode=0x04;
+  }
+  wm_log_debug("Activating MotionPlus, mode 0x%02x.",mode);
+  if (wm_output_write(coord->output,0x04a600fe,&mode,1,WM_COORD_TAG_MP_INIT)<0) return -1;
+  coord->mp_state=WM_MP_STATE_ACTIVATING;
+  coord->mp_expect_ext=0;
+  return 0;
+}
+
+/* Stop reporting gyro, and forget the MotionPlus if (gone).
+ */
+
+static int wm_coord_drop_motionplus(struct wm_coord *coord,int gone) {
+  coord->mp_state=gone?WM_MP_STATE_NONE:WM_MP_STATE_INACTIVE;
+  if (wm_report_set_motionplus(coord->report,0)<0) return -1;
+  if (wm_delivery_disconnect(coord->delivery_gyro)<0) return -1;
+  if (wm_coord_update_report_mode(coord,0)<0) return -1;
+  return 0;
+}
+
+static int wm_coord_deactivate_motionplus(struct wm_coord *coord,int expect_ext) {
+  if (coord->mp_state!=WM_MP_STATE_ACTIVE) return 0;
+  wm_log_debug("Deactivating MotionPlus to identify its passthrough extension.");
+  if (wm_output_write(coord->output,0x04a400f0,"\x55",1,WM_COORD_TAG_MP_INIT)<0) return -1;
+  if (wm_coord_drop_motionplus(coord,0)<0) return -1;
+  coord->mp_expect_ext=expect_ext;
+  return 0;
+}
+
+static int wm_coord_receive_motionplus_probe(struct wm_coord *coord,const uint8_t *rawid,int rawidc) {
+  if (coord->mp_state!=WM_MP_STATE_PROBING) return 0;
+  if ((rawidc<6)||(rawid[2]!=0xa6)||(rawid[3]!=0x20)||(rawid[5]!=0x05)) {
+    wm_log_debug("No MotionPlus.");
+    coord->mp_state=WM_MP_STATE_NONE;
+    return 0;
+  }
+  wm_log_info("Found MotionPlus.");
+  coord->mp_state=WM_MP_STATE_INACTIVE;
+  /* If an extension handshake is running, it will activate us when it finishes. */
+  if (coord->ext_state!=WM_EXT_STATE_UNSET) return 0;
+  return wm_coord_activate_motionplus(coord);
+}
+
+static int wm_coord_receive_motionplus_calibration(struct wm_coord *coord,const void *src,int srcc) {
+  if (coord->mp_state!=WM_MP_STATE_ACTIVE) return 0;
+  if (wm_report_set_motionplus_calibration(coord->report,src,srcc)<0) return 0;
+  wm_cache_set(coord->cache,"mp-cal",src,srcc);
+  wm_cache_save(coord->cache);
+  return 0;
+}
+
+/* The extension handshake found an active MotionPlus.
+ * (mode) tells us the passthrough extension, which we report as usual.
+ */
+
+static int wm_coord_accept_motionplus(struct wm_coord *coord,uint8_t mode) {
+  int extid=0;
+  switch (mode) {
+    case 0x05: extid=WM_DEVICE_TYPE_NUNCHUK; break;
+    case 0x07: extid=WM_DEVICE_TYPE_CLASSIC; break;
+  }
+  coord->ext_optimistic=0;
+  if (extid!=coord->extid) {
+    if (wm_coord_drop_extension(coord)<0) return -1;
+    if (extid&&(wm_coord_accept_extension(coord,extid)<0)) return -1;
+  }
+
+  wm_log_info("MotionPlus active, mode 0x%02x.",mode);
+  coord->mp_state=WM_MP_STATE_ACTIVE;
+  coord->mp_expect_ext=0;
+  if (wm_report_set_motionplus(coord->report,1)<0) return -1;
+  if (wm_delivery_connect(coord->delivery_gyro)<0) return -1;
+  if (wm_coord_update_report_mode(coord,0)<0) return -1;
+
+  uint8_t cal[32];
+  if (wm_cache_get(cal,sizeof(cal),coord->cache,"mp-cal")==sizeof(cal)) {
+    wm_report_set_motionplus_calibration(coord->report,cal,sizeof(cal));
+  }
+  return wm_output_read(coord->output,0x04a40020,32,WM_COORD_TAG_MP_CAL);
+}
+
 /* Finish extension handshake, ID in hand.
- * (rawid) is 6 bytes:
- *   00 00 a4 20 00 00 Nunchuk
- *   00 00 a4 20 01 01 Classic
- *   01 00 a4 20 01 01 Classic Pro
- *   ff 00 a4 20 00 13 Drawsome Graphics Tablet (not fully documented at WiiBrew, and I don't have one)
- *   00 00 a4 20 01 03 Guitar
- *   01 00 a4 20 01 03 Drums
- *   03 00 a4 20 01 03 Turntable
+ * If we guessed from the cache, this is where we find out whether the guess was right.
  */
 
-static int wm_coord_receive_extension_id(struct wm_coord *coord,const uint8_t *rawid) {
+static int wm_coord_fallback_extension(struct wm_coord *coord);
+
+static int wm_coord_receive_extension_id(struct wm_coord *coord,const uint8_t *src) {
+
+  uint8_t rawid[6];
+  if (coord->ext_legacy) wm_report_decrypt(rawid,src,6);
+  else memcpy(rawid,src,6);
 
-  if (!memcmp(rawid,"\x00\x00\xa4\x20\x00\x00",6)) return wm_coord_accept_extension(coord,WM_DEVICE_TYPE_NUNCHUK);
-  if (!memcmp(rawid,"\x00\x00\xa4\x20\x01\x01",6)) return wm_coord_accept_extension(coord,WM_DEVICE_TYPE_CLASSIC);
+  /* Every extension ID has a4 20 in the middle. Anything else means the init didn't take. */
+  if ((rawid[2]!=0xa4)||(rawid[3]!=0x20)) {
+    char buf[32];
+    int bufc=wm_report_repr(buf,sizeof(buf),rawid,6);
+    if ((bufc<0)||(bufc>sizeof(buf))) bufc=0;
+    wm_log_warning("Garbage extension ID: %.*s",bufc,buf);
+    if (!coord->ext_fallback) return wm_coord_fallback_extension(coord);
+  }
+
+  if ((rawid[2]==0xa4)&&(rawid[3]==0x20)&&(rawid[5]==0x05)) {
+    return wm_coord_accept_motionplus(coord,rawid[4]);
+  }
+
+  int extid=wm_coord_extid_eval(rawid);
+  if (extid) {
+    uint8_t legacy=coord->ext_legacy;
+    wm_cache_set(coord->cache,"ext-legacy",&legacy,1);
+    if (legacy) coord->stats.ext_encrypted++;
+  }
   
-  char buf[32];
-  int bufc=wm_report_repr(buf,sizeof(buf),rawid,6);
-  if ((bufc<0)||(bufc>sizeof(buf))) bufc=0;
-  wm_log_warning("Unknown extension ID: %.*s",bufc,buf);
+  if (coord->ext_optimistic) {
+    coord->ext_optimistic=0;
+    if (extid==coord->extid) {
+      wm_log_debug("Handshake confirms cached extension '%s'.",wm_device_type_repr(extid));
+      if (wm_report_set_extension_encrypted(coord->report,coord->ext_legacy)<0) return -1;
+      wm_cache_save(coord->cache);
+      return wm_coord_read_extension_calibration(coord);
+    }
+    wm_log_info("Cached extension ID was wrong, switching.");
+    if (wm_coord_drop_extension(coord)<0) return -1;
+  }
+
+  if (!extid) {
+    char buf[32];
+    int bufc=wm_report_repr(buf,sizeof(buf),rawid,6);
+    if ((bufc<0)||(bufc>sizeof(buf))) bufc=0;
+    wm_log_warning("Unknown extension ID: %.*s",bufc,buf);
+    wm_cache_set(coord->cache,"extid",0,-1);
+    wm_cache_save(coord->cache);
+    return wm_coord_activate_motionplus(coord);
+  }
+
+  wm_cache_set(coord->cache,"extid",rawid,6);
+  wm_cache_save(coord->cache);
+  if (wm_coord_accept_extension(coord,extid)<0) return -1;
+  if (wm_report_set_extension_encrypted(coord->report,coord->ext_legacy)<0) return -1;
+
+  /* With an inactive MotionPlus in front of it, this is our cue to activate passthrough.
+   * Its calibration can't be read after that, but the device answers in order, so queueing the read first is enough.
+   */
+  if (coord->mp_state==WM_MP_STATE_INACTIVE) {
+    if (wm_coord_read_extension_calibration(coord)<0) return -1;
+    return wm_coord_activate_motionplus(coord);
+  }
+
+  /* Calibration is only readable once the extension is initialized, ie now. */
+  return wm_coord_read_extension_calibration(coord);
+}
+
+/* Start reporting the cached extension immediately, if we have one.
+ * The handshake proceeds as usual, and will correct us if wrong.
+ */
+
+static int wm_coord_connect_extension_optimistic(struct wm_coord *coord) {
+  uint8_t rawid[6];
+  if (wm_cache_get(rawid,sizeof(rawid),coord->cache,"extid")!=sizeof(rawid)) return 0;
+  int extid=wm_coord_extid_eval(rawid);
+  if (!extid) return 0;
+  wm_log_debug("Assuming cached extension '%s' until the handshake finishes.",wm_device_type_repr(extid));
+  if (wm_coord_accept_extension(coord,extid)<0) return -1;
+  coord->ext_optimistic=1;
   return 0;
 }
 
 /* Connect extension. (Begin process)
- * 1. Write {0x55} to 0x04a400f0.
- * 2. Write {0x00} to 0x04a400fb.
- * 3. Read 6 from 0x04a400fa.
- * 4. Set report mode to 0x32.
- * TODO This works with Nintendo devices but not Rock Candy.
+ * "The New Way":
+ *   1. Write {0x55} to 0x04a400f0.
+ *   2. Write {0x00} to 0x04a400fb.
+ *   3. Read 6 from 0x04a400fa.
+ * "The Old Way", which some third-party remotes need. Everything the extension sends after this is encrypted:
+ *   1. Write {0x00} to 0x04a40040.
+ *   2. Read 6 from 0x04a400fa.
+ * Then set report mode to 0x34.
+ * The device processes output reports in order, so we queue the steps back to back rather than waiting for each ACK.
+ * wm_output retries failed steps without reordering them, so by the time the ID arrives, both writes are done.
+ * If any step fails for good, or the ID is garbage, we try the other way once.
+ * If that fails too, we roll back, but keep swallowing replies until the read finishes.
+ * We start with whichever way worked last time for this remote.
  */
 
+static int wm_coord_begin_extension_handshake(struct wm_coord *coord,int legacy) {
+  if (legacy) {
+    wm_log_debug("wm_coord_connect_extension: 0x00 to 0x04a40040, read 6 from 0x04a400fa");
+    if (wm_output_write(coord->output,0x04a40040,"\0",1,WM_COORD_TAG_EXT_INIT)<0) return -1;
+  } else {
+    wm_log_debug("wm_coord_connect_extension: 0x55 to 0x04a400f0, 0x00 to 0x04a400fb, read 6 from 0x04a400fa");
+    if (wm_output_write(coord->output,0x04a400f0,"\x55",1,WM_COORD_TAG_EXT_INIT)<0) return -1;
+    if (wm_output_write(coord->output,0x04a400fb,"\0",1,WM_COORD_TAG_EXT_INIT)<0) return -1;
+  }
+  if (wm_output_read(coord->output,0x04a400fa,6,WM_COORD_TAG_EXT_ID)<0) return -1;
+  coord->ext_legacy=legacy;
+  coord->ext_state=WM_EXT_STATE_PENDING;
+  return 0;
+}
+
 static int wm_coord_connect_extension(struct wm_coord *coord) {
-  if (coord->ext_state==WM_EXT_STATE_UNSET) {
-    /* "The New Way" */
-    wm_log_debug("wm_coord_connect_extension: writing 0x55 to 0x04a400f0");
-    uint8_t req[32];
-    int reqc=wm_report_compose_write(req,sizeof(req),coord->report,0x04a400f0,"\x55",1);
-    if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
-    coord->ext_state=WM_EXT_STATE_WAIT_ACK1;
-    /**/
-    /* "The Old Way"
-    wm_log_debug("wm_coord_connect_extension: writing 0x00 to 0x04a40040");
-    uint8_t req[32];
-    int reqc=wm_report_compose_write(req,sizeof(req),coord->report,0x04a40040,"\0",1);
-    if (reqc<0) return -1;
-    if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
-    coord->ext_state=WM_EXT_STATE_WAIT_ACK2;
-    /**/
+  if (coord->ext_state!=WM_EXT_STATE_UNSET) return 0;
+  int legacy=wm_config_get_legacy_ext_init(coord->config);
+  uint8_t cached;
+  if (!legacy&&(wm_cache_get(&cached,1,coord->cache,"ext-legacy")==1)) legacy=cached;
+  coord->ext_fallback=0;
+  return wm_coord_begin_extension_handshake(coord,legacy);
+}
+
+/* First handshake failed and its replies have drained. Try the other way.
+ */
+
+static int wm_coord_fallback_extension(struct wm_coord *coord) {
+  coord->ext_state=WM_EXT_STATE_UNSET;
+  coord->ext_fallback=1;
+  coord->stats.ext_init_fallbacks++;
+  wm_log_info("Extension handshake failed, trying the %s way.",coord->ext_legacy?"new":"old");
+  return wm_coord_begin_extension_handshake(coord,!coord->ext_legacy);
+}
+
+/* Extension handshake failed: Forget any guess we made, and swallow the remaining replies.
+ */
+
+static int wm_coord_fail_extension(struct wm_coord *coord) {
+  if (coord->ext_state!=WM_EXT_STATE_PENDING) return 0;
+  if (!coord->ext_fallback) {
+    coord->ext_state=WM_EXT_STATE_RETRY;
+    return 0;
+  }
+  coord->ext_state=WM_EXT_STATE_FAILED;
+  coord->ext_present_time=0;
+  coord->stats.ext_handshake_failures++;
+  if (coord->ext_optimistic&&(wm_coord_drop_extension(coord)<0)) return -1;
+  switch (coord->mp_state) {
+    case WM_MP_STATE_ACTIVATING: {
+        wm_log_warning("MotionPlus did not come up after activation.");
+        coord->mp_state=WM_MP_STATE_NONE;
+      } break;
+    case WM_MP_STATE_INACTIVE: {
+        if (wm_coord_activate_motionplus(coord)<0) return -1;
+      } break;
+    case WM_MP_STATE_NONE: {
+        /* Could be a MotionPlus that was just plugged in, it doesn't answer at 0x04a4 until activated. */
+        if (wm_coord_probe_motionplus(coord)<0) return -1;
+      } break;
   }
   return 0;
 }
@@ -143,18 +711,114 @@ static int wm_coord_connect_extension(struct wm_coord *coord) {
 
 static int wm_coord_disconnect_extension(struct wm_coord *coord) {
 
+  coord->ext_present_time=0;
+  if ((coord->ext_state==WM_EXT_STATE_PENDING)||(coord->ext_state==WM_EXT_STATE_RETRY)) {
+    coord->ext_state=WM_EXT_STATE_FAILED;
+  }
+
+  if (wm_coord_drop_extension(coord)<0) return -1;
+
+  /* Activation and deactivation of a MotionPlus look like disconnection too. */
+  switch (coord->mp_state) {
+    case WM_MP_STATE_ACTIVE: {
+        wm_log_info("Disconnected MotionPlus.");
+        if (wm_coord_drop_motionplus(coord,1)<0) return -1;
+      } break;
+    case WM_MP_STATE_INACTIVE: {
+        if (!coord->mp_expect_ext&&(wm_coord_activate_motionplus(coord)<0)) return -1;
+      } break;
+  }
+
+  wm_log_info("Disconnected extension.");
+
+  return 0;
+}
+
+/* Status polling.
+ * We ask for a 0x20 status report every (status_interval), mostly for the battery level.
+ * Each time we find nobody has touched the remote since the last poll, we wait twice as long next time.
+ * Any activity brings it back to the base interval.
+ */
+
+static void wm_coord_status_wake(struct wm_coord *coord) {
+  coord->status_backoff=coord->status_interval;
+  int64_t next=wm_now_us()+coord->status_interval;
+  if (next<coord->status_next) coord->status_next=next;
+}
+
+static int wm_coord_update_status(struct wm_coord *coord) {
+  if (!coord->status_interval) return 0;
+  int64_t now=wm_now_us();
+  if (now<coord->status_next) return 0;
   uint8_t req[32];
-  if (wm_report_set_extension(coord->report,0)<0) return -1;
-  if (wm_report_set_rptid(coord->report,0x30)<0) return -1;
-  int reqc=wm_report_compose_rptid(req,sizeof(req),coord->report);
+  int reqc=wm_report_compose_status_request(req,sizeof(req),coord->report);
   if (reqc<0) return -1;
-  if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
-  coord->ext_state=WM_EXT_STATE_UNSET;
+  if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+  coord->stats.status_polls++;
+  if (wm_coord_idle_us(coord,now)>=coord->status_backoff) {
+    coord->status_backoff<<=1;
+    if (coord->status_backoff>coord->status_interval*WM_COORD_STATUS_BACKOFF_LIMIT) {
+      coord->status_backoff=coord->status_interval*WM_COORD_STATUS_BACKOFF_LIMIT;
+    }
+  } else {
+    coord->status_backoff=coord->status_interval;
+  }
+  coord->status_next=now+coord->status_backoff;
+  return 0;
+}
 
-  if (wm_delivery_disconnect(coord->delivery_ext)<0) return -1;
+/* Milliseconds until the next status poll, or <0 if none.
+ */
 
-  wm_log_info("Disconnected extension.");
+static int wm_coord_status_timeout(const struct wm_coord *coord) {
+  if (!coord->status_interval) return -1;
+  int64_t us=coord->status_next-wm_now_us();
+  if (us<=0) return 0;
+  if (us>INT_MAX/2) return INT_MAX/2;
+  return (us+999)/1000;
+}
 
+/* Battery status file, in the style of a power_supply uevent, so desktop tools can pick it up the same way.
+ * Replaced atomically whenever the level or low flag changes.
+ */
+
+static int wm_coord_write_battery(struct wm_coord *coord) {
+  const char *dir=wm_config_get_status_dir(coord->config);
+  if (!dir||!dir[0]) return 0;
+  if (coord->stats.battery<0) return 0;
+  char name[18],path[1024],text[512];
+  if (wm_bdaddr_repr(name,sizeof(name),coord->bdaddr)!=17) return 0;
+  int pathc=snprintf(path,sizeof(path),"%s/%s",dir,name);
+  if ((pathc<1)||(pathc>=sizeof(path))) return 0;
+  int capacity=(coord->stats.battery*100)/WM_COORD_BATTERY_FULL;
+  if (capacity>100) capacity=100;
+  const char *level=coord->battery_low?"Low":(capacity>=95)?"Full":"Normal";
+  int textc=snprintf(text,sizeof(text),
+    "POWER_SUPPLY_NAME=wiimote_%s\n"
+    "POWER_SUPPLY_SCOPE=Device\n"
+    "POWER_SUPPLY_STATUS=Discharging\n"
+    "POWER_SUPPLY_PRESENT=1\n"
+    "POWER_SUPPLY_CAPACITY=%d\n"
+    "POWER_SUPPLY_CAPACITY_LEVEL=%s\n",
+    name,capacity,level
+  );
+  if ((textc<1)||(textc>=sizeof(text))) return 0;
+  /* Not worth failing over, the remote works fine without it. */
+  if ((wm_dir_require(dir)<0)||(wm_file_write(path,text,textc)<0)) {
+    wm_log_debug("%s: Failed to write battery status.",path);
+  }
+  return 0;
+}
+
+/* Someone is using the device.
+ * Every path that delivers a change a person made comes through here, not only wm_coord_cb_button:
+ * Gestures and the pointer go straight to their delivery.
+ */
+
+static int wm_coord_note_activity(struct wm_coord *coord) {
+  coord->last_activity=wm_now_us();
+  if (coord->status_backoff>coord->status_interval) wm_coord_status_wake(coord);
+  if (!coord->continuous&&(wm_coord_update_continuous(coord)<0)) return -1;
   return 0;
 }
 
@@ -166,17 +830,63 @@ static int wm_coord_cb_button(void *userdata,int btnid,int value) {
   
   wm_log_trace("%s %d[%s]=%d",__func__,btnid,wm_btnid_repr(btnid),value);
 
+  if (wm_btnid_is_activity(btnid)&&(wm_coord_note_activity(coord)<0)) return -1;
+
   /* Look for events we handle internally. */
   switch (btnid) {
+
+    case WM_BTNID_CORE_BATTERY: {
+        coord->stats.battery=value;
+        if (wm_coord_write_battery(coord)<0) return -1;
+      } break;
+
+    case WM_BTNID_CORE_BATTLOW: {
+        coord->battery_low=value;
+        if (value) {
+          wm_log_warning("Battery low.");
+          coord->stats.battery_low_events++;
+        }
+        if (wm_coord_write_battery(coord)<0) return -1;
+      } break;
   
     case WM_BTNID_CORE_EXTPRESENT: {
         if (value) {
           wm_log_debug("WM_BTNID_CORE_EXTPRESENT, begin extension handshake");
+          coord->ext_present_time=wm_now_us();
+          if (wm_coord_connect_extension_optimistic(coord)<0) return -1;
           if (wm_coord_connect_extension(coord)<0) return -1;
         } else {
           if (wm_coord_disconnect_extension(coord)<0) return -1;
         }
       } break;
+
+    case WM_BTNID_CORE_ACCELX: coord->accel[0]=value; coord->accel_dirty=1; break;
+    case WM_BTNID_CORE_ACCELY: coord->accel[1]=value; coord->accel_dirty=1; break;
+    case WM_BTNID_CORE_ACCELZ: coord->accel[2]=value; coord->accel_dirty=1; break;
+    case WM_BTNID_NUNCHUK_ACCELX: coord->nunchuk_accel[0]=value; break;
+    case WM_BTNID_NUNCHUK_ACCELY: coord->nunchuk_accel[1]=value; break;
+    case WM_BTNID_NUNCHUK_ACCELZ: coord->nunchuk_accel[2]=value; break;
+
+    case WM_BTNID_MOTIONPLUS_YAW:
+    case WM_BTNID_MOTIONPLUS_ROLL:
+    case WM_BTNID_MOTIONPLUS_PITCH: {
+        if (!wm_delivery_is_connected(coord->delivery_gyro)) return 0;
+        return wm_delivery_set_button(coord->delivery_gyro,btnid,value);
+      }
+
+    /* Something plugged into or pulled out of an active MotionPlus. Go find out what. */
+    case WM_BTNID_MOTIONPLUS_EXTPRESENT: {
+        if ((coord->mp_state==WM_MP_STATE_ACTIVE)&&(value!=(coord->extid?1:0))) {
+          if (wm_coord_deactivate_motionplus(coord,value)<0) return -1;
+        }
+      } return 0;
+
+    case WM_BTNID_CORE_A:
+    case WM_BTNID_CORE_B: {
+        if (wm_delivery_is_connected(coord->delivery_pointer)) {
+          if (wm_delivery_set_button(coord->delivery_pointer,btnid,value)<0) return -1;
+        }
+      } break;
       
   }
 
@@ -190,78 +900,178 @@ static int wm_coord_cb_button(void *userdata,int btnid,int value) {
   return 0;
 }
 
+/* Run gesture recognizers over the latest accelerometers, once per report.
+ * The nunchuk's gestures go out on the same keys, on whichever device its buttons go to.
+ */
+
+static int wm_coord_update_gesture(struct wm_coord *coord,struct wm_gesture *gesture,const int *accel,struct wm_delivery *delivery,int64_t now) {
+  struct wm_gesture_event eventv[WM_GESTURE_EVENT_LIMIT];
+  int eventc=wm_gesture_update(eventv,gesture,accel[0],accel[1],accel[2],now);
+  int i; for (i=0;i<eventc;i++) {
+    wm_log_debug("Gesture %s=%d",wm_gesture_repr(eventv[i].gesture),eventv[i].value);
+    if (wm_coord_note_activity(coord)<0) return -1;
+    if (wm_delivery_set_button(delivery,WM_BTNID_GESTURE+eventv[i].gesture,eventv[i].value)<0) return -1;
+  }
+  return 0;
+}
+
+static int wm_coord_update_gestures(struct wm_coord *coord,uint8_t rptid) {
+  int64_t now=wm_now_us();
+  switch (rptid) {
+    case 0x31: case 0x33: case 0x35: case 0x37: case 0x3f: {
+        if (wm_coord_update_gesture(coord,&coord->gesture_core,coord->accel,coord->delivery_core,now)<0) return -1;
+      } break;
+  }
+  if (coord->extid==WM_DEVICE_TYPE_NUNCHUK) switch (rptid) {
+    case 0x32: case 0x34: case 0x35: case 0x36: case 0x37: case 0x3d: {
+        struct wm_delivery *delivery=wm_delivery_is_connected(coord->delivery_ext)?coord->delivery_ext:coord->delivery_core;
+        if (wm_coord_update_gesture(coord,&coord->gesture_nunchuk,coord->nunchuk_accel,delivery,now)<0) return -1;
+      } break;
+  }
+  return 0;
+}
+
+/* Report callback: IR dots changed.
+ */
+
+static int wm_coord_cb_ir(void *userdata,const struct wm_ir_dot *dotv) {
+  struct wm_coord *coord=userdata;
+  if (wm_log_trace_enabled()) {
+    wm_log_trace(
+      "IR %d,%d/%d/%d %d,%d/%d/%d %d,%d/%d/%d %d,%d/%d/%d",
+      dotv[0].x,dotv[0].y,dotv[0].size,dotv[0].intensity,dotv[1].x,dotv[1].y,dotv[1].size,dotv[1].intensity,
+      dotv[2].x,dotv[2].y,dotv[2].size,dotv[2].intensity,dotv[3].x,dotv[3].y,dotv[3].size,dotv[3].intensity
+    );
+  }
+  if (!wm_delivery_is_connected(coord->delivery_pointer)) return 0;
+  int err=wm_pointer_update(coord->pointer,dotv);
+  if (err<=0) return err;
+  if (wm_coord_note_activity(coord)<0) return -1;
+  int x,y;
+  wm_pointer_get(&x,&y,coord->pointer);
+  if (wm_delivery_set_button(coord->delivery_pointer,WM_BTNID_POINTER_X,x)<0) return -1;
+  if (wm_delivery_set_button(coord->delivery_pointer,WM_BTNID_POINTER_Y,y)<0) return -1;
+  return 0;
+}
+
 /* Report callback: ACK
  */
 
 static int wm_coord_cb_ack(void *userdata,uint8_t rptid,uint8_t result) {
   struct wm_coord *coord=userdata;
   wm_log_trace("ACK 0x%02x = 0x%02x",rptid,result);
+  return wm_output_receive_ack(coord->output,rptid,result);
+}
 
-  if (coord->ext_state==WM_EXT_STATE_WAIT_ACK1) {
-    if (rptid==0x16) {
-      if (result) {
-        wm_log_error("Error %d enabling extension. After 0x55 to 0x04a400f0.",result);
-        coord->ext_state=WM_EXT_STATE_UNSET;
-      } else {
-        wm_log_debug("Extension handshake, ACK1: writing 0x00 to 0x04a400fb");
-        uint8_t req[32];
-        int reqc=wm_report_compose_write(req,sizeof(req),coord->report,0x04a400fb,"\0",1);
-        if (reqc<0) return -1;
-        if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
-        coord->ext_state=WM_EXT_STATE_WAIT_ACK2;
-      }
-    }
+/* Report callback: read
+ */
+
+static int wm_coord_cb_read(void *userdata,uint16_t addr,int err,const void *src,int srcc) {
+  struct wm_coord *coord=userdata;
+  if (err) {
+    wm_log_debug("READ[%04x]: error %d",addr,err);
+  } else if (wm_log_trace_enabled()) {
+    char buf[64];
+    int bufc=wm_report_repr(buf,sizeof(buf),src,srcc);
+    if ((bufc<0)||(bufc>sizeof(buf))) bufc=0;
+    wm_log_trace("READ[%04x]: %.*s",addr,bufc,buf);
   }
+  return wm_output_receive_read(coord->output,addr,err,src,srcc);
+}
+
+/* Output callback: write finished.
+ */
+
+static int wm_coord_unmute_speaker(struct wm_coord *coord);
+
+static int wm_coord_cb_write_complete(void *userdata,int tag,int err) {
+  struct wm_coord *coord=userdata;
+  switch (tag) {
+
+    case WM_COORD_TAG_IR_INIT: {
+        if (err) wm_log_error("Error %d initializing IR camera.",err);
+      } break;
+
+    case WM_COORD_TAG_MP_INIT: {
+        if (err) {
+          wm_log_error("Error %d switching MotionPlus.",err);
+          if (coord->mp_state==WM_MP_STATE_ACTIVATING) coord->mp_state=WM_MP_STATE_NONE;
+        }
+      } break;
+
+    case WM_COORD_TAG_SPEAKER: {
+        if (!coord->speaker_ackc) return 0;
+        if (err) {
+          wm_log_error("Error %d setting up speaker.",err);
+          coord->speaker_ackc=0;
+          return 0;
+        }
+        if (--(coord->speaker_ackc)) return 0;
+        if (wm_coord_unmute_speaker(coord)<0) return -1;
+      } break;
+
+    case WM_COORD_TAG_EXT_INIT: {
+        if (coord->ext_state==WM_EXT_STATE_UNSET) return 0;
+        if (err) {
+          wm_log_error("Error %d enabling extension.",err);
+          if (wm_coord_fail_extension(coord)<0) return -1;
+        }
+      } break;
 
-  if (coord->ext_state==WM_EXT_STATE_WAIT_ACK2) {
-    if (rptid==0x16) {
-      if (result) {
-        wm_log_error("Error %d enabling extension. After 0x00 to 0x04a400fb.",result);
-        coord->ext_state=WM_EXT_STATE_UNSET;
-      } else {
-        wm_log_debug("Extension handshake, ACK2: reading 6 from 0x04a400fa");
-        uint8_t req[32];
-        int reqc=wm_report_compose_read(req,sizeof(req),coord->report,0x04a400fa,6);
-        if (reqc<0) return -1;
-        if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
-        coord->ext_state=WM_EXT_STATE_WAIT_EXTID;
-      }
-    }
   }
-  
   return 0;
 }
 
-/* Report callback: read
+/* Output callback: read finished.
  */
 
-static int wm_coord_cb_read(void *userdata,uint16_t addr,int err,const void *src,int srcc) {
+static int wm_coord_cb_read_complete(void *userdata,int tag,int addr,int err,const void *src,int srcc) {
   struct wm_coord *coord=userdata;
-  if (err) {
-    wm_log_error("READ[%04x]: error %d",addr,err);
-    if (coord->ext_state==WM_EXT_STATE_WAIT_EXTID) {
-      coord->ext_state=WM_EXT_STATE_UNSET;
-    }
-    
-  } else {
-  
-    if (wm_log_trace_enabled()) {
-      char buf[64];
-      int bufc=wm_report_repr(buf,sizeof(buf),src,srcc);
-      if ((bufc<0)||(bufc>sizeof(buf))) bufc=0;
-      wm_log_trace("READ[%04x]: %.*s",addr,bufc,buf);
-    }
+  switch (tag) {
+
+    case WM_COORD_TAG_EXT_ID: {
+        if (coord->ext_state==WM_EXT_STATE_UNSET) return 0;
+        if (err) {
+          wm_log_error("Error %d reading extension ID.",err);
+          if (wm_coord_fail_extension(coord)<0) return -1;
+        } else if ((coord->ext_state==WM_EXT_STATE_PENDING)&&(srcc>=6)) {
+          coord->ext_state=WM_EXT_STATE_UNSET;
+          return wm_coord_receive_extension_id(coord,src);
+        }
+        if (coord->ext_state==WM_EXT_STATE_RETRY) return wm_coord_fallback_extension(coord);
+        coord->ext_state=WM_EXT_STATE_UNSET;
+      } break;
+
+    case WM_COORD_TAG_EXT_CAL: {
+        if (err) {
+          wm_log_warning("Failed to read extension calibration, error %d.",err);
+        } else {
+          return wm_coord_receive_extension_calibration(coord,src,srcc);
+        }
+      } break;
 
-    /* Are we expecting the extension ID, and is this it? */
-    if (coord->ext_state==WM_EXT_STATE_WAIT_EXTID) {
-      if ((addr==0x00fa)&&(srcc>=6)) {
-        if (wm_coord_receive_extension_id(coord,src)<0) return -1;
+    case WM_COORD_TAG_MP_PROBE: {
+        if (err) src=0;
+        return wm_coord_receive_motionplus_probe(coord,src,src?srcc:0);
       }
-      coord->ext_state=WM_EXT_STATE_UNSET;
-      return 0;
-    }
 
-    //TODO Other reactions to successful read.
+    case WM_COORD_TAG_MP_CAL: {
+        if (err) {
+          wm_log_warning("Failed to read MotionPlus calibration, error %d.",err);
+        } else {
+          return wm_coord_receive_motionplus_calibration(coord,src,srcc);
+        }
+      } break;
+
+    case WM_COORD_TAG_ACCEL_CAL: {
+        if (err) {
+          wm_log_warning("Failed to read accelerometer calibration, error %d.",err);
+        } else if (wm_report_set_accel_calibration(coord->report,src,srcc)>=0) {
+          wm_cache_set(coord->cache,"accel-cal",src,srcc);
+          wm_cache_save(coord->cache);
+        }
+      } break;
+
   }
   return 0;
 }
@@ -278,15 +1088,35 @@ static int wm_coord_startup_transport(struct wm_coord *coord,struct wm_config *c
     return -1;
   }
 
+  memcpy(coord->bdaddr,bdaddr,6);
   if (!(coord->transport=wm_transport_new(bdaddr,wm_config_get_retry_count(config)))) return -1;
 
   if (wm_transport_connect(coord->transport)<0) {
     return -1;
   }
+
+  struct wm_output_delegate delegate={
+    .cb_write=wm_coord_cb_write_complete,
+    .cb_read=wm_coord_cb_read_complete,
+    .userdata=coord,
+  };
+  if (!(coord->output=wm_output_new(coord->transport,&delegate,&coord->stats))) return -1;
   
   return 0;
 }
 
+/* The reader thread starts at the first update, not at startup: Threads don't survive wm_daemonize()'s fork.
+ * Busy polling happens on the reader thread, so it implies one.
+ */
+
+static int wm_coord_startup_reader(struct wm_coord *coord,struct wm_config *config) {
+  if (coord->reader) return -1;
+  if (!wm_config_get_reader_thread(config)&&!wm_config_get_busy_poll(config)) return 0;
+  if (wm_transport_set_busy_poll(coord->transport,wm_config_get_busy_poll(config))<0) return -1;
+  if (!(coord->reader=wm_reader_new(coord->transport,&coord->stats))) return -1;
+  return 0;
+}
+
 static int wm_coord_startup_report(struct wm_coord *coord,struct wm_config *config) {
   if (coord->report) return -1;
 
@@ -294,10 +1124,12 @@ static int wm_coord_startup_report(struct wm_coord *coord,struct wm_config *conf
     .cb_button=wm_coord_cb_button,
     .cb_ack=wm_coord_cb_ack,
     .cb_read=wm_coord_cb_read,
+    .cb_ir=wm_coord_cb_ir,
     .userdata=coord,
   };
 
   if (!(coord->report=wm_report_new(&delegate))) return -1;
+  if (wm_report_set_stats(coord->report,&coord->stats)<0) return -1;
   if (wm_report_configure(coord->report,config)<0) {
     return -1;
   }
@@ -306,43 +1138,175 @@ static int wm_coord_startup_report(struct wm_coord *coord,struct wm_config *conf
 }
 
 static int wm_coord_startup_delivery(struct wm_coord *coord,struct wm_config *config) {
-  if (coord->delivery_core||coord->delivery_ext) return -1;
+  if (coord->delivery_core||coord->delivery_ext||coord->delivery_pointer||coord->delivery_gyro) return -1;
   if (!(coord->delivery_core=wm_delivery_new())) return -1;
   if (!(coord->delivery_ext=wm_delivery_new())) return -1;
+  if (!(coord->delivery_pointer=wm_delivery_new())) return -1;
+  if (!(coord->delivery_gyro=wm_delivery_new())) return -1;
+  if (!(coord->pointer=wm_pointer_new())) return -1;
 
   if (wm_delivery_set_device_type(coord->delivery_core,WM_DEVICE_TYPE_WIIMOTE)<0) return -1;
   if (wm_delivery_set_nunchuk_separate(coord->delivery_core,wm_config_get_nunchuk_separate(config))<0) return -1;
   if (wm_delivery_set_classic_separate(coord->delivery_core,wm_config_get_classic_separate(config))<0) return -1;
+  if (wm_delivery_set_orientation(coord->delivery_core,wm_config_get_orientation(config))<0) return -1;
+  if (wm_config_get_rumble(config)) {
+    if (!(coord->rumble=wm_rumble_new())) return -1;
+    if (wm_delivery_set_rumble(coord->delivery_core,coord->rumble)<0) return -1;
+  }
+
+  int i; for (i=0;i<WM_GESTURE_COUNT;i++) {
+    int keycode=wm_config_get_gesture_key(config,i);
+    if (wm_delivery_set_gesture_key(coord->delivery_core,i,keycode)<0) return -1;
+    if (wm_delivery_set_gesture_key(coord->delivery_ext,i,keycode)<0) return -1;
+  }
+  coord->gestures=wm_config_has_gestures(config);
+  wm_gesture_init(&coord->gesture_core);
+  wm_gesture_init(&coord->gesture_nunchuk);
 
   const char *path=0;
   int pathc=wm_config_get_uinput_path(&path,config);
   if (pathc<0) return -1;
   if (wm_delivery_set_uinput_path(coord->delivery_core,path,pathc)<0) return -1;
   if (wm_delivery_set_uinput_path(coord->delivery_ext,path,pathc)<0) return -1;
+  if (wm_delivery_set_uinput_path(coord->delivery_pointer,path,pathc)<0) return -1;
+  if (wm_delivery_set_uinput_path(coord->delivery_gyro,path,pathc)<0) return -1;
 
   if (wm_delivery_set_name(coord->delivery_core,wm_config_get_device_name(config),-1)<0) return -1;
   if (wm_delivery_set_name(coord->delivery_ext,wm_config_get_device_name(config),-1)<0) return -1;
+  if (wm_delivery_set_name(coord->delivery_pointer,wm_config_get_device_name(config),-1)<0) return -1;
+  if (wm_delivery_set_device_type(coord->delivery_pointer,WM_DEVICE_TYPE_POINTER)<0) return -1;
+  if (wm_delivery_set_name(coord->delivery_gyro,wm_config_get_device_name(config),-1)<0) return -1;
+  if (wm_delivery_set_device_type(coord->delivery_gyro,WM_DEVICE_TYPE_MOTIONPLUS)<0) return -1;
 
   if (wm_delivery_connect(coord->delivery_core)<0) return -1;
+  if (wm_config_get_ir(config)) {
+    if (wm_delivery_connect(coord->delivery_pointer)<0) return -1;
+  }
 
   return 0;
 }
 
-/* Begin device handshake.
+static int wm_coord_startup_cache(struct wm_coord *coord,struct wm_config *config) {
+  if (coord->cache) return -1;
+  if (!(coord->cache=wm_cache_new(wm_config_get_cache_dir(config),coord->bdaddr))) return -1;
+  if (wm_cache_load(coord->cache)<0) return -1;
+  return 0;
+}
+
+static int wm_coord_startup_player(struct wm_coord *coord,struct wm_config *config) {
+  if (coord->player) return -1;
+  if (!(coord->player=wm_player_new(wm_config_get_player_dir(config)))) return -1;
+  int slot=wm_player_claim(coord->player);
+  if (slot) wm_log_info("Player %d.",slot);
+  return 0;
+}
+
+/* LEDs, bits 0..3.
+ * These go through the coalesced state path, so a client flashing them only ever has one report pending.
  */
 
-static int wm_coord_handshake(struct wm_coord *coord) {
+static int wm_coord_send_leds(struct wm_coord *coord,int leds) {
   uint8_t req[32];
+  int reqc=wm_report_compose_led(req,sizeof(req),coord->report,leds&1,leds&2,leds&4,leds&8);
+  if (reqc<0) return -1;
+  if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+  coord->leds=leds;
+  return 0;
+}
+
+static int wm_coord_update_leds(struct wm_coord *coord) {
+  int leds=wm_delivery_get_leds(coord->delivery_core);
+  if (leds==coord->leds) return 0;
+  return wm_coord_send_leds(coord,leds);
+}
+
+/* Speaker.
+ * Power on and mute, configure, then unmute once the writes are confirmed.
+ * The mute and power reports are state reports, which go out before any write.
+ */
+
+static int wm_coord_startup_speaker(struct wm_coord *coord,struct wm_config *config) {
+  const char *path=wm_config_get_speaker(config);
+  if (!path||!path[0]) return 0;
+  if (coord->speaker) return -1;
+  if (!(coord->speaker=wm_speaker_new(path,wm_config_get_speaker_rate(config),&coord->stats))) return -1;
+  return 0;
+}
+
+static int wm_coord_init_speaker(struct wm_coord *coord) {
+  if (!coord->speaker) return 0;
+  uint8_t req[32],cfg[7];
   int reqc;
+  if ((reqc=wm_report_compose_speaker(req,sizeof(req),coord->report,0x14,1))<0) return -1;
+  if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+  if ((reqc=wm_report_compose_speaker(req,sizeof(req),coord->report,0x19,1))<0) return -1;
+  if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+  if (wm_speaker_compose_config(cfg,sizeof(cfg),coord->speaker,wm_config_get_speaker_volume(coord->config))<0) return -1;
+  if (wm_output_write(coord->output,0x04a20009,"\x01",1,WM_COORD_TAG_SPEAKER)<0) return -1;
+  if (wm_output_write(coord->output,0x04a20001,"\x08",1,WM_COORD_TAG_SPEAKER)<0) return -1;
+  if (wm_output_write(coord->output,0x04a20001,cfg,sizeof(cfg),WM_COORD_TAG_SPEAKER)<0) return -1;
+  if (wm_output_write(coord->output,0x04a20008,"\x01",1,WM_COORD_TAG_SPEAKER)<0) return -1;
+  coord->speaker_ackc=4;
+  coord->speaker_ready=0;
+  return 0;
+}
+
+static int wm_coord_unmute_speaker(struct wm_coord *coord) {
+  uint8_t req[32];
+  int reqc=wm_report_compose_speaker(req,sizeof(req),coord->report,0x19,0);
+  if (reqc<0) return -1;
+  if (wm_output_set_state(coord->output,req,reqc)<0) return -1;
+  wm_log_debug("Speaker ready.");
+  coord->speaker_ready=1;
+  return 0;
+}
+
+static int wm_coord_update_speaker(struct wm_coord *coord) {
+  uint8_t adpcm[WM_SPEAKER_PACKET_BYTES],rpt[32];
+  int adpcmc=wm_speaker_update(adpcm,coord->speaker);
+  if (adpcmc<=0) return adpcmc;
+  int rptc=wm_report_compose_speaker_data(rpt,sizeof(rpt),coord->report,adpcm,adpcmc);
+  if (rptc<0) return -1;
+  if (wm_output_stream(coord->output,rpt,rptc)<0) return -1;
+  return wm_output_update(coord->output);
+}
+
+/* Begin device handshake.
+ */
+
+static int wm_coord_handshake(struct wm_coord *coord) {
+
+  /* Connecting counts as activity, so we start out streaming if there's motion to stream. */
+  coord->last_activity=wm_now_us();
+  coord->continuous_idle=(int64_t)wm_config_get_continuous_idle(coord->config)*1000000;
+  coord->idle_disconnect=(int64_t)wm_config_get_idle_disconnect(coord->config)*1000000;
+  coord->connect_time=coord->last_activity;
+
+  /* Our player slot's LED, or all four if we don't have one. */
+  int slot=wm_player_get(coord->player);
+  int leds=slot?(1<<(slot-1)):0x0f;
+  if (wm_delivery_set_leds(coord->delivery_core,leds)<0) return -1;
+  if (wm_coord_send_leds(coord,leds)<0) return -1;
   
-  if ((reqc=wm_report_compose_led(req,sizeof(req),coord->report,1,1,1,1))<0) return -1;
-  if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
-  
-  if (wm_report_set_rptid(coord->report,0x30)<0) return -1;
-  if ((reqc=wm_report_compose_rptid(req,sizeof(req),coord->report))<0) return -1;
-  if (wm_transport_write(coord->transport,req,reqc)!=reqc) return -1;
+  if (wm_coord_update_report_mode(coord,1)<0) return -1;
+
+  /* Use the cached accelerometer calibration until the real one arrives. */
+  uint8_t cal[10];
+  if (wm_cache_get(cal,sizeof(cal),coord->cache,"accel-cal")==sizeof(cal)) {
+    wm_report_set_accel_calibration(coord->report,cal,sizeof(cal));
+  }
+  if (wm_output_read(coord->output,0x00000016,10,WM_COORD_TAG_ACCEL_CAL)<0) return -1;
+
+  if (wm_coord_probe_motionplus(coord)<0) return -1;
+  if (wm_coord_init_speaker(coord)<0) return -1;
+
+  /* First status poll right away, we want the battery level before anyone asks. */
+  coord->status_interval=(int64_t)wm_config_get_status_interval(coord->config)*1000000;
+  coord->status_backoff=coord->status_interval;
+  coord->status_next=wm_now_us();
+  if (wm_coord_update_status(coord)<0) return -1;
   
-  return 0;
+  return wm_output_update(coord->output);
 }
 
 /* Start up, main entry point.
@@ -355,8 +1319,11 @@ int wm_coord_startup(struct wm_coord *coord,struct wm_config *config) {
   coord->config=config;
   
   if (wm_coord_startup_transport(coord,config)<0) return -1;
+  if (wm_coord_startup_cache(coord,config)<0) return -1;
   if (wm_coord_startup_report(coord,config)<0) return -1;
   if (wm_coord_startup_delivery(coord,config)<0) return -1;
+  if (wm_coord_startup_player(coord,config)<0) return -1;
+  if (wm_coord_startup_speaker(coord,config)<0) return -1;
 
   if (wm_coord_handshake(coord)<0) return -1;
   
@@ -369,11 +1336,61 @@ int wm_coord_is_running(const struct wm_coord *coord) {
   return coord->startup;
 }
 
+int wm_coord_log_stats(const struct wm_coord *coord) {
+  if (!coord) return -1;
+  wm_stats_log(&coord->stats);
+  return 0;
+}
+
+/* Reconfigure at runtime.
+ */
+
+int wm_coord_reconfigure(struct wm_coord *coord,const struct wm_config *config) {
+  if (!coord||!config) return -1;
+  if (!coord->startup) return -1;
+  struct wm_config *dst=coord->config;
+
+  int resensitize=(wm_config_get_ir_sensitivity(config)!=wm_config_get_ir_sensitivity(dst));
+  if (wm_config_set_accel(dst,wm_config_get_accel(config))<0) return -1;
+  if (wm_config_set_ir(dst,wm_config_get_ir(config))<0) return -1;
+  if (wm_config_set_ir_sensitivity(dst,wm_config_get_ir_sensitivity(config))<0) return -1;
+  if (wm_config_set_ir_full(dst,wm_config_get_ir_full(config))<0) return -1;
+  if (wm_config_set_status_interval(dst,wm_config_get_status_interval(config))<0) return -1;
+  if (wm_config_set_continuous_idle(dst,wm_config_get_continuous_idle(config))<0) return -1;
+  if (wm_config_set_idle_disconnect(dst,wm_config_get_idle_disconnect(config))<0) return -1;
+  if (wm_config_set_verbosity(dst,wm_config_get_verbosity(config))<0) return -1;
+  coord->continuous_idle=(int64_t)wm_config_get_continuous_idle(dst)*1000000;
+  coord->idle_disconnect=(int64_t)wm_config_get_idle_disconnect(dst)*1000000;
+
+  /* The pointer device comes and goes with IR. */
+  if (wm_config_get_ir(dst)) {
+    if (wm_delivery_connect(coord->delivery_pointer)<0) return -1;
+  } else if (wm_delivery_is_connected(coord->delivery_pointer)) {
+    if (wm_delivery_disconnect(coord->delivery_pointer)<0) return -1;
+    if (wm_pointer_reset(coord->pointer)<0) return -1;
+  }
+
+  /* Sensitivity is only written when the camera starts, so pretend it's off and it will start again. */
+  if (resensitize) coord->ir_mode=0;
+
+  int64_t interval=(int64_t)wm_config_get_status_interval(dst)*1000000;
+  if (interval!=coord->status_interval) {
+    coord->status_interval=coord->status_backoff=interval;
+    coord->status_next=wm_now_us()+interval;
+  }
+
+  return wm_coord_update_report_mode(coord,resensitize);
+}
+
 /* Shut down.
  */
 
 int wm_coord_shutdown(struct wm_coord *coord) {
   if (!coord) return -1;
+  wm_output_del(coord->output);
+  coord->output=0;
+  wm_reader_del(coord->reader);
+  coord->reader=0;
   wm_transport_del(coord->transport);
   coord->transport=0;
   wm_report_del(coord->report);
@@ -382,36 +1399,251 @@ int wm_coord_shutdown(struct wm_coord *coord) {
   coord->delivery_core=0;
   wm_delivery_del(coord->delivery_ext);
   coord->delivery_ext=0;
+  wm_delivery_del(coord->delivery_pointer);
+  coord->delivery_pointer=0;
+  wm_delivery_del(coord->delivery_gyro);
+  coord->delivery_gyro=0;
+  coord->mp_state=WM_MP_STATE_NONE;
+  wm_pointer_del(coord->pointer);
+  coord->pointer=0;
+  wm_rumble_del(coord->rumble);
+  coord->rumble=0;
+  wm_cache_del(coord->cache);
+  coord->cache=0;
+  wm_player_del(coord->player);
+  coord->player=0;
+  wm_speaker_del(coord->speaker);
+  coord->speaker=0;
+  coord->speaker_ackc=0;
+  coord->speaker_ready=0;
   coord->startup=0;
   return 0;
 }
 
-/* Update.
+/* Process one report, digested events will come back through our callbacks.
  */
 
-int wm_coord_update(struct wm_coord *coord) {
-  if (!coord) return -1;
-  if (!coord->startup) return -1;
+static int wm_coord_receive_report(struct wm_coord *coord,const uint8_t *rpt,int rptc) {
+  if (wm_report_deliver(coord->report,rpt,rptc)<0) {
+    return -1;
+  }
 
-  /* Is a report ready? */
-  int err=wm_transport_poll(coord->transport,1000);
-  if (err<0) return -1;
-  if (!err) return 0;
+  /* Each axis arrives only if it changed, so give the pointer all three once the report is done. */
+  if (coord->accel_dirty) {
+    coord->accel_dirty=0;
+    if (wm_pointer_set_accel(coord->pointer,coord->accel[0],coord->accel[1],coord->accel[2])<0) return -1;
+  }
 
-  /* Read next report. */
-  uint8_t rpt[32]={0};
-  int rptc=wm_transport_read(rpt,sizeof(rpt),coord->transport);
-  if (rptc<0) return -1;
-  if (!rptc) return wm_coord_shutdown(coord);
+  if (coord->gestures) {
+    if (wm_coord_update_gestures(coord,rpt[1])<0) return -1;
+  }
 
-  /* Process report, digested events will come back through our callbacks. */
-  if (wm_report_deliver(coord->report,rpt,rptc)<0) {
-    return -1;
+  /* Replies may have unblocked more output, and events may have queued some. Don't wait for the next poll. */
+  if (wm_output_update(coord->output)<0) return -1;
+
+  /* Time to first extension input is the main cost of the handshake, keep track of it. */
+  if (coord->ext_present_time&&coord->extid&&!coord->ext_optimistic) {
+    switch (rpt[1]) {
+      case 0x32: case 0x34: case 0x35: case 0x36: case 0x37: case 0x3d: {
+          wm_stats_timer_add(&coord->stats.ext_handshake,wm_now_us()-coord->ext_present_time);
+          wm_log_debug("Extension input after %lld us.",(long long)coord->stats.ext_handshake.last);
+          coord->ext_present_time=0;
+        } break;
+    }
   }
 
   /* Alert uinput that the report is complete. */
   if (wm_delivery_synchronize(coord->delivery_core)<0) return -1;
   if (wm_delivery_synchronize(coord->delivery_ext)<0) return -1;
+  if (wm_delivery_synchronize(coord->delivery_pointer)<0) return -1;
+  if (wm_delivery_synchronize(coord->delivery_gyro)<0) return -1;
   
   return 0;
 }
+
+/* Idle disconnect.
+ * Closing the link turns the remote off. We keep our uinput devices, so clients don't notice beyond a lull,
+ * and page the remote every WM_COORD_RECONNECT_INTERVAL_US until it answers.
+ * A remote that isn't paired to us won't come looking, but it answers pages while 1+2 are held.
+ * Everything the device forgets at power-off, we forget too, and the next handshake sets it up again.
+ * Extension and MotionPlus devices go away with the link, same as if you'd unplugged them.
+ */
+
+static int wm_coord_idle_disconnect(struct wm_coord *coord) {
+  int64_t now=wm_now_us();
+  wm_log_info("No input for %d s, disconnecting.",(int)(coord->idle_disconnect/1000000));
+  coord->stats.idle_disconnects++;
+  wm_stats_timer_add(&coord->stats.time_to_idle,now-coord->connect_time);
+
+  /* Let go of anything held, and run the usual extension removal. */
+  if (coord->mp_state==WM_MP_STATE_ACTIVE) {
+    if (wm_coord_drop_motionplus(coord,1)<0) return -1;
+  }
+  coord->mp_state=WM_MP_STATE_NONE;
+  coord->mp_expect_ext=0;
+  if (wm_report_reset(coord->report)<0) return -1;
+  coord->ext_state=WM_EXT_STATE_UNSET;
+  coord->ext_present_time=0;
+  if (wm_pointer_reset(coord->pointer)<0) return -1;
+  if (wm_delivery_synchronize(coord->delivery_core)<0) return -1;
+  if (wm_delivery_synchronize(coord->delivery_pointer)<0) return -1;
+
+  if (wm_coord_set_continuous(coord,0)<0) return -1;
+  coord->ir_mode=0;
+  coord->speaker_ackc=0;
+  coord->speaker_ready=0;
+  if (coord->speaker&&(wm_speaker_stop(coord->speaker)<0)) return -1;
+
+  if (wm_output_reset(coord->output)<0) return -1;
+  wm_reader_del(coord->reader);
+  coord->reader=0;
+  if (wm_transport_disconnect(coord->transport)<0) return -1;
+  coord->reconnect_next=now+WM_COORD_RECONNECT_INTERVAL_US;
+  return 0;
+}
+
+/* Milliseconds until we disconnect for idleness, or <0 if never.
+ */
+
+static int wm_coord_idle_timeout(const struct wm_coord *coord) {
+  if (!coord->idle_disconnect) return -1;
+  int64_t us=coord->idle_disconnect-wm_coord_idle_us(coord,wm_now_us());
+  if (us<=0) return 0;
+  if (us>INT_MAX/2) return INT_MAX/2;
+  return (us+999)/1000;
+}
+
+/* Update while disconnected for idleness.
+ * Clients may still talk to the core device, so keep serving it. Output piles up harmlessly, and is dropped at reconnect.
+ */
+
+static int wm_coord_update_dormant(struct wm_coord *coord) {
+  int connecting=wm_transport_is_connecting(coord->transport);
+  int to_ms=1000;
+  if (!connecting) {
+    int64_t us=coord->reconnect_next-wm_now_us();
+    if (us<=0) {
+      if (wm_transport_connect_begin(coord->transport)<0) return -1;
+      connecting=1;
+    } else if (us<1000000) {
+      to_ms=(us+999)/1000;
+    }
+  }
+
+  struct pollfd pollfdv[3]={
+    {.fd=connecting?wm_transport_get_fd(coord->transport):-1,.events=POLLOUT},
+    {.fd=wm_delivery_get_fd(coord->delivery_core),.events=POLLIN},
+    {.fd=wm_rumble_get_fd(coord->rumble),.events=POLLIN},
+  };
+  int err=poll(pollfdv,3,to_ms);
+  if (err<0) {
+    if (errno==EINTR) return 0;
+    return -1;
+  }
+  if (!err) return 0;
+
+  if (pollfdv[1].revents&POLLIN) {
+    if (wm_delivery_update(coord->delivery_core)<0) return -1;
+    if (wm_coord_update_leds(coord)<0) return -1;
+  }
+  if (coord->rumble&&((pollfdv[1].revents&POLLIN)||(pollfdv[2].revents&POLLIN))) {
+    int on=wm_rumble_update(coord->rumble);
+    if (on<0) return -1;
+    if (wm_output_set_rumble(coord->output,on)<0) return -1;
+  }
+
+  if (pollfdv[0].revents) {
+    int err=wm_transport_connect_finish(coord->transport);
+    if (err<0) return -1;
+    if (!err) {
+      coord->reconnect_next=wm_now_us()+WM_COORD_RECONNECT_INTERVAL_US;
+      return 0;
+    }
+    wm_log_info("Reconnected after idle.");
+    coord->stats.idle_reconnects++;
+    coord->reconnect_next=0;
+    if (wm_output_reset(coord->output)<0) return -1;
+    if (wm_coord_handshake(coord)<0) return -1;
+  }
+  return 0;
+}
+
+/* Update.
+ */
+
+int wm_coord_update(struct wm_coord *coord) {
+  if (!coord) return -1;
+  if (!coord->startup) return -1;
+  if (coord->reconnect_next) return wm_coord_update_dormant(coord);
+  if (!coord->reader&&(wm_coord_startup_reader(coord,coord->config)<0)) return -1;
+
+  if (coord->idle_disconnect&&(wm_coord_idle_us(coord,wm_now_us())>=coord->idle_disconnect)) {
+    return wm_coord_idle_disconnect(coord);
+  }
+
+  /* Send any output that's due, and sleep no longer than the next one. */
+  if (wm_coord_update_status(coord)<0) return -1;
+  if (wm_coord_update_continuous(coord)<0) return -1;
+  if (wm_output_update(coord->output)<0) return -1;
+  int to_ms=wm_output_get_timeout(coord->output);
+  if ((to_ms<0)||(to_ms>1000)) to_ms=1000;
+  int status_ms=wm_coord_status_timeout(coord);
+  if ((status_ms>=0)&&(status_ms<to_ms)) to_ms=status_ms;
+  int continuous_ms=wm_coord_continuous_timeout(coord);
+  if ((continuous_ms>=0)&&(continuous_ms<to_ms)) to_ms=continuous_ms;
+  int idle_ms=wm_coord_idle_timeout(coord);
+  if ((idle_ms>=0)&&(idle_ms<to_ms)) to_ms=idle_ms;
+
+  /* Wait for a report, traffic from the core uinput device, the rumble timer, or the speaker. */
+  struct pollfd pollfdv[4]={
+    {.fd=coord->reader?wm_reader_get_fd(coord->reader):wm_transport_get_fd(coord->transport),.events=POLLIN|POLLHUP|POLLERR},
+    {.fd=wm_delivery_get_fd(coord->delivery_core),.events=POLLIN},
+    {.fd=wm_rumble_get_fd(coord->rumble),.events=POLLIN},
+    {.fd=coord->speaker_ready?wm_speaker_get_fd(coord->speaker):-1,.events=POLLIN},
+  };
+  if (pollfdv[0].fd<0) return -1;
+  int err=poll(pollfdv,4,to_ms); // Negative fds are ignored.
+  if (err<0) {
+    if (errno==EINTR) return 0; // Signals are handled by the main loop.
+    return -1;
+  }
+  if (!err) return 0;
+
+  /* Clients may have set LEDs or force feedback. */
+  if (pollfdv[1].revents&POLLIN) {
+    if (wm_delivery_update(coord->delivery_core)<0) return -1;
+    if (wm_coord_update_leds(coord)<0) return -1;
+    if (wm_output_update(coord->output)<0) return -1;
+  }
+
+  /* Effect changes and timer expiries both mean the motor might change.
+   * The rumble bit rides on the next output report, which goes out right away if nothing else is pending.
+   */
+  if (coord->rumble&&((pollfdv[1].revents&POLLIN)||(pollfdv[2].revents&POLLIN))) {
+    int on=wm_rumble_update(coord->rumble);
+    if (on<0) return -1;
+    if (wm_output_set_rumble(coord->output,on)<0) return -1;
+    if (wm_output_update(coord->output)<0) return -1;
+  }
+  /* Speaker packets are due at exact times, so send before looking at input. */
+  if (pollfdv[3].revents) {
+    if (wm_coord_update_speaker(coord)<0) return -1;
+  }
+
+  if (!pollfdv[0].revents) return 0;
+
+  /* With a reader thread, take everything it has queued. Otherwise read one report straight off the socket. */
+  uint8_t rpt[32]={0};
+  int rptc;
+  if (coord->reader) {
+    while ((rptc=wm_reader_read(rpt,sizeof(rpt),0,coord->reader))>0) {
+      if (wm_coord_receive_report(coord,rpt,rptc)<0) return -1;
+    }
+    if (rptc<0) return wm_coord_shutdown(coord);
+    return 0;
+  }
+  rptc=wm_transport_read(rpt,sizeof(rpt),coord->transport);
+  if (rptc<0) return -1;
+  if (!rptc) return wm_coord_shutdown(coord);
+  return wm_coord_receive_report(coord,rpt,rptc);
+}
@@ -18,4 +18,14 @@ int wm_coord_update(struct wm_coord *coord);
 int wm_coord_shutdown(struct wm_coord *coord);
 int wm_coord_is_running(const struct wm_coord *coord);
 
+/* Apply the options that can change while running, from a freshly read (config).
+ * We copy them into the config we started with, and adjust the device to match, eg changing report mode.
+ * (config) is only borrowed for the duration of the call.
+ */
+int wm_coord_reconfigure(struct wm_coord *coord,const struct wm_config *config);
+
+/* Dump performance counters to the log.
+ */
+int wm_coord_log_stats(const struct wm_coord *coord);
+
 #endif
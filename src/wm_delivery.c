@@ -1,8 +1,13 @@
 #include "wiimote.h"
 #include "wm_delivery.h"
 #include "wm_enums.h"
+#include "wm_report.h"
+#include "wm_pointer.h"
+#include "wm_extdesc.h"
+#include "wm_rumble.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <linux/input.h>
 #include <linux/uinput.h>
 
@@ -22,6 +27,10 @@ struct wm_delivery {
   // Only relevant to WM_DEVICE_TYPE_WIIMOTE, will these extensions be reported combined?
   int may_have_nunchuk;
   int may_have_classic;
+  int orientation;
+  int gesture_keys[WM_GESTURE_COUNT];
+  struct wm_rumble *rumble; // WEAK, optional. If present, we advertise FF_RUMBLE.
+  int leds; // Core only: LED 1..4 in bits 0..3. Clients change it via EV_LED.
 };
 
 /* Object lifecycle.
@@ -122,6 +131,55 @@ int wm_delivery_set_classic_separate(struct wm_delivery *delivery,int separate)
   return 0;
 }
 
+int wm_delivery_set_orientation(struct wm_delivery *delivery,int orientation) {
+  if (!delivery) return -1;
+  delivery->orientation=orientation;
+  return 0;
+}
+
+int wm_delivery_set_gesture_key(struct wm_delivery *delivery,int gesture,int keycode) {
+  if (!delivery) return -1;
+  if (delivery->fd>=0) return -1;
+  if ((gesture<0)||(gesture>=WM_GESTURE_COUNT)) return -1;
+  if ((keycode<0)||(keycode>KEY_MAX)) return -1;
+  delivery->gesture_keys[gesture]=keycode;
+  return 0;
+}
+
+int wm_delivery_set_rumble(struct wm_delivery *delivery,struct wm_rumble *rumble) {
+  if (!delivery) return -1;
+  if (delivery->fd>=0) return -1;
+  delivery->rumble=rumble;
+  return 0;
+}
+
+int wm_delivery_set_leds(struct wm_delivery *delivery,int leds) {
+  if (!delivery) return -1;
+  delivery->leds=leds&0x0f;
+  if ((delivery->fd>=0)&&(delivery->device_type==WM_DEVICE_TYPE_WIIMOTE)) {
+    struct input_event evtv[5]={0};
+    int i; for (i=0;i<4;i++) {
+      evtv[i].type=EV_LED;
+      evtv[i].code=LED_NUML+i;
+      evtv[i].value=(leds>>i)&1;
+    }
+    evtv[4].type=EV_SYN;
+    evtv[4].code=SYN_REPORT;
+    if (write(delivery->fd,evtv,sizeof(evtv))!=sizeof(evtv)) return -1;
+  }
+  return 0;
+}
+
+int wm_delivery_get_leds(const struct wm_delivery *delivery) {
+  if (!delivery) return 0;
+  return delivery->leds;
+}
+
+int wm_delivery_get_fd(const struct wm_delivery *delivery) {
+  if (!delivery) return -1;
+  return delivery->fd;
+}
+
 /* Populate limits for absolute axes.
  */
 
@@ -131,27 +189,30 @@ static void wm_delivery_populate_uud_abs_limits(struct uinput_user_dev *uud,stru
     case WM_DEVICE_TYPE_WIIMOTE: {
         LIMITS(X,-1,1) // core d-pad
         LIMITS(Y,-1,1)
-        LIMITS(RX,-512,511) // core accelerometer
-        LIMITS(RY,-512,511)
-        LIMITS(RZ,-512,511)
+        LIMITS(RX,WM_ACCEL_MIN,WM_ACCEL_MAX) // core accelerometer
+        LIMITS(RY,WM_ACCEL_MIN,WM_ACCEL_MAX)
+        LIMITS(RZ,WM_ACCEL_MIN,WM_ACCEL_MAX)
         LIMITS(MISC+0,-128,127) // nunchuk stick
         LIMITS(MISC+1,-128,127)
-        LIMITS(MISC+2,-512,511) // nunchuk accelerometer
-        LIMITS(MISC+3,-512,511)
-        LIMITS(MISC+4,-512,511)
+        LIMITS(MISC+2,WM_ACCEL_MIN,WM_ACCEL_MAX) // nunchuk accelerometer
+        LIMITS(MISC+3,WM_ACCEL_MIN,WM_ACCEL_MAX)
+        LIMITS(MISC+4,WM_ACCEL_MIN,WM_ACCEL_MAX)
         LIMITS(MISC+5,-32,31) // classic sticks
         LIMITS(MISC+6,-32,31)
         LIMITS(MISC+7,-16,15)
         LIMITS(MISC+8,-16,15)
         LIMITS(MISC+9,0,31) // classic triggers
         LIMITS(MISC+10,0,31)
+        LIMITS(TILT_X,-18000,17999) // orientation, centidegrees
+        LIMITS(TILT_Y,-18000,17999)
+        LIMITS(RUDDER,-18000,17999)
       } break;
     case WM_DEVICE_TYPE_NUNCHUK: {
         LIMITS(X,-128,127)
         LIMITS(Y,-128,127)
-        LIMITS(RX,-512,511)
-        LIMITS(RY,-512,511)
-        LIMITS(RZ,-512,511)
+        LIMITS(RX,WM_ACCEL_MIN,WM_ACCEL_MAX)
+        LIMITS(RY,WM_ACCEL_MIN,WM_ACCEL_MAX)
+        LIMITS(RZ,WM_ACCEL_MIN,WM_ACCEL_MAX)
       } break;
     case WM_DEVICE_TYPE_CLASSIC: {
         LIMITS(X,-32,31)
@@ -161,6 +222,33 @@ static void wm_delivery_populate_uud_abs_limits(struct uinput_user_dev *uud,stru
         LIMITS(Z,0,31)
         LIMITS(RZ,0,31)
       } break;
+    case WM_DEVICE_TYPE_POINTER: {
+        LIMITS(X,0,WM_POINTER_X_MAX)
+        LIMITS(Y,0,WM_POINTER_Y_MAX)
+      } break;
+    case WM_DEVICE_TYPE_MOTIONPLUS: {
+        LIMITS(RX,WM_GYRO_MIN,WM_GYRO_MAX)
+        LIMITS(RY,WM_GYRO_MIN,WM_GYRO_MAX)
+        LIMITS(RZ,WM_GYRO_MIN,WM_GYRO_MAX)
+      } break;
+    case WM_DEVICE_TYPE_BALANCE: {
+        LIMITS(HAT0X,0,WM_BALANCE_SENSOR_MAX) // corner loads
+        LIMITS(HAT0Y,0,WM_BALANCE_SENSOR_MAX)
+        LIMITS(HAT1X,0,WM_BALANCE_SENSOR_MAX)
+        LIMITS(HAT1Y,0,WM_BALANCE_SENSOR_MAX)
+        LIMITS(Z,0,WM_BALANCE_TOTAL_MAX)
+        LIMITS(X,-WM_BALANCE_WIDTH_MM/2,WM_BALANCE_WIDTH_MM/2) // center of pressure
+        LIMITS(Y,-WM_BALANCE_DEPTH_MM/2,WM_BALANCE_DEPTH_MM/2)
+      } break;
+    default: {
+        const struct wm_extdesc *desc=wm_extdesc_for_device_type(delivery->device_type);
+        if (!desc) break;
+        const struct wm_extdesc_field *field=desc->fieldv;
+        int i=desc->fieldc; for (;i-->0;field++) {
+          if (!(field->flags&WM_EXTDESC_AXIS)) continue;
+          wm_extdesc_field_range(uud->absmin+field->code,uud->absmax+field->code,field);
+        }
+      } break;
   }
   #undef LIMITS
 }
@@ -177,10 +265,26 @@ static int wm_delivery_set_event_bits(struct wm_delivery *delivery) {
   #define SETBTN(tag) if (ioctl(delivery->fd,UI_SET_KEYBIT,BTN_##tag)<0) return -1;
   #define SETKEY(tag) if (ioctl(delivery->fd,UI_SET_KEYBIT,KEY_##tag)<0) return -1;
 
+  int i; for (i=0;i<WM_GESTURE_COUNT;i++) {
+    if (!delivery->gesture_keys[i]) continue;
+    if (ioctl(delivery->fd,UI_SET_KEYBIT,delivery->gesture_keys[i])<0) return -1;
+  }
+
+  if (delivery->rumble) {
+    if (ioctl(delivery->fd,UI_SET_EVBIT,EV_FF)<0) return -1;
+    if (ioctl(delivery->fd,UI_SET_FFBIT,FF_RUMBLE)<0) return -1;
+    if (ioctl(delivery->fd,UI_SET_FFBIT,FF_GAIN)<0) return -1;
+  }
+
   switch (delivery->device_type) {
 
     case WM_DEVICE_TYPE_WIIMOTE: {
 
+        if (ioctl(delivery->fd,UI_SET_EVBIT,EV_LED)<0) return -1;
+        for (i=0;i<4;i++) {
+          if (ioctl(delivery->fd,UI_SET_LEDBIT,LED_NUML+i)<0) return -1;
+        }
+
         SETABS(X)
         SETABS(Y)
         SETBTN(0) //TODO button names
@@ -229,6 +333,12 @@ static int wm_delivery_set_event_bits(struct wm_delivery *delivery) {
           SETKEY(ESC)
         }
 
+        if (delivery->orientation) {
+          SETABS(TILT_X)
+          SETABS(TILT_Y)
+          SETABS(RUDDER)
+        }
+
       } break;
 
     case WM_DEVICE_TYPE_NUNCHUK: {
@@ -265,6 +375,44 @@ static int wm_delivery_set_event_bits(struct wm_delivery *delivery) {
         SETBTN(MODE)
       } break;
 
+    case WM_DEVICE_TYPE_POINTER: {
+        if (ioctl(delivery->fd,UI_SET_PROPBIT,INPUT_PROP_POINTER)<0) return -1;
+        SETABS(X)
+        SETABS(Y)
+        SETBTN(LEFT)
+        SETBTN(RIGHT)
+      } break;
+
+    case WM_DEVICE_TYPE_MOTIONPLUS: {
+        if (ioctl(delivery->fd,UI_SET_PROPBIT,INPUT_PROP_ACCELEROMETER)<0) return -1;
+        SETABS(RX)
+        SETABS(RY)
+        SETABS(RZ)
+      } break;
+
+    case WM_DEVICE_TYPE_BALANCE: {
+        SETABS(HAT0X)
+        SETABS(HAT0Y)
+        SETABS(HAT1X)
+        SETABS(HAT1Y)
+        SETABS(Z)
+        SETABS(X)
+        SETABS(Y)
+      } break;
+
+    default: {
+        const struct wm_extdesc *desc=wm_extdesc_for_device_type(delivery->device_type);
+        if (!desc) break;
+        const struct wm_extdesc_field *field=desc->fieldv;
+        for (i=desc->fieldc;i-->0;field++) {
+          if (field->flags&WM_EXTDESC_AXIS) {
+            if (ioctl(delivery->fd,UI_SET_ABSBIT,field->code)<0) return -1;
+          } else {
+            if (ioctl(delivery->fd,UI_SET_KEYBIT,field->code)<0) return -1;
+          }
+        }
+      } break;
+
   }
   #undef SETABS
   #undef SETBTN
@@ -331,6 +479,7 @@ int wm_delivery_connect(struct wm_delivery *delivery) {
   if (wm_delivery_compose_name(uud.name,sizeof(uud.name),delivery)<0) return -1;
 
   wm_delivery_populate_uud_abs_limits(&uud,delivery);
+  if (delivery->rumble) uud.ff_effects_max=WM_RUMBLE_EFFECT_LIMIT;
 
   if (write(delivery->fd,&uud,sizeof(uud))!=sizeof(uud)) {
     wm_log_error("%s: Failed to write uinput_user_dev: %m",delivery->uinput_path);
@@ -361,9 +510,73 @@ int wm_delivery_disconnect(struct wm_delivery *delivery) {
   if (delivery->fd<0) return 0;
   close(delivery->fd);
   delivery->fd=-1;
+  /* Effects belong to the uinput device, they're gone now. */
+  if (delivery->rumble) wm_rumble_reset(delivery->rumble);
   return 0;
 }
 
+/* Force feedback requests from uinput.
+ * Upload and erase are a handshake with the kernel: BEGIN fetches the request, END returns our verdict.
+ * The kernel assigns effect IDs, below the ff_effects_max we gave it.
+ */
+
+static int wm_delivery_ff_upload(struct wm_delivery *delivery,int request_id) {
+  struct uinput_ff_upload upload={0};
+  upload.request_id=request_id;
+  if (ioctl(delivery->fd,UI_BEGIN_FF_UPLOAD,&upload)<0) return -1;
+  if (upload.effect.type!=FF_RUMBLE) {
+    upload.retval=-EINVAL;
+  } else if (wm_rumble_upload(
+    delivery->rumble,upload.effect.id,
+    upload.effect.u.rumble.strong_magnitude,upload.effect.u.rumble.weak_magnitude,
+    upload.effect.replay.delay,upload.effect.replay.length
+  )<0) {
+    upload.retval=-EINVAL;
+  }
+  if (ioctl(delivery->fd,UI_END_FF_UPLOAD,&upload)<0) return -1;
+  return 0;
+}
+
+static int wm_delivery_ff_erase(struct wm_delivery *delivery,int request_id) {
+  struct uinput_ff_erase erase={0};
+  erase.request_id=request_id;
+  if (ioctl(delivery->fd,UI_BEGIN_FF_ERASE,&erase)<0) return -1;
+  if (wm_rumble_erase(delivery->rumble,erase.effect_id)<0) erase.retval=-EINVAL;
+  if (ioctl(delivery->fd,UI_END_FF_ERASE,&erase)<0) return -1;
+  return 0;
+}
+
+int wm_delivery_update(struct wm_delivery *delivery) {
+  if (!delivery) return -1;
+  if (delivery->fd<0) return 0;
+  struct input_event evtv[16];
+  int evtc=read(delivery->fd,evtv,sizeof(evtv));
+  if (evtc<0) {
+    if ((errno==EINTR)||(errno==EAGAIN)) return 0;
+    wm_log_error("%s: read: %m",delivery->uinput_path);
+    return -1;
+  }
+  evtc/=sizeof(struct input_event);
+  if (!evtc) return 0;
+  const struct input_event *evt=evtv;
+  for (;evtc-->0;evt++) switch (evt->type) {
+    case EV_LED: {
+        if ((evt->code<LED_NUML)||(evt->code>=LED_NUML+4)) break;
+        if (evt->value) delivery->leds|=1<<(evt->code-LED_NUML);
+        else delivery->leds&=~(1<<(evt->code-LED_NUML));
+      } break;
+    case EV_UINPUT: if (delivery->rumble) switch (evt->code) {
+        case UI_FF_UPLOAD: if (wm_delivery_ff_upload(delivery,evt->value)<0) return -1; break;
+        case UI_FF_ERASE: if (wm_delivery_ff_erase(delivery,evt->value)<0) return -1; break;
+      } break;
+    case EV_FF: if (delivery->rumble) switch (evt->code) {
+        case FF_GAIN: wm_rumble_set_gain(delivery->rumble,evt->value); break;
+        default: wm_rumble_play(delivery->rumble,evt->code,evt->value); break;
+      } break;
+  }
+  return 1;
+}
+
 /* Translate input event.
  * Return 0 to discard event, >0 to proceed, or <0 for real errors.
  */
@@ -372,6 +585,12 @@ static int wm_delivery_translate_event(struct input_event *evt,const struct wm_d
   evt->value=value;
   evt->type=EV_KEY;
 
+  /* Gestures map to whatever keys the user configured, on any device. */
+  if ((btnid>=WM_BTNID_GESTURE)&&(btnid<WM_BTNID_GESTURE+WM_GESTURE_COUNT)) {
+    if (!(evt->code=delivery->gesture_keys[btnid-WM_BTNID_GESTURE])) return 0;
+    return 1;
+  }
+
   /* Mangle extension buttons to fit all in one device. */
   if (delivery->device_type==WM_DEVICE_TYPE_WIIMOTE) switch (btnid) {
 
@@ -393,6 +612,10 @@ static int wm_delivery_translate_event(struct input_event *evt,const struct wm_d
 
     //TODO Do we want to report status fields? eg extension connected
 
+    case WM_BTNID_ORIENT_ROLL:  if (!delivery->orientation) return 0; evt->type=EV_ABS; evt->code=ABS_TILT_X; return 1;
+    case WM_BTNID_ORIENT_PITCH: if (!delivery->orientation) return 0; evt->type=EV_ABS; evt->code=ABS_TILT_Y; return 1;
+    case WM_BTNID_ORIENT_YAW:   if (!delivery->orientation) return 0; evt->type=EV_ABS; evt->code=ABS_RUDDER; return 1;
+
     case WM_BTNID_NUNCHUK_X:       evt->type=EV_ABS; evt->code=ABS_MISC+0; evt->value=value; return 1;
     case WM_BTNID_NUNCHUK_Y:       evt->type=EV_ABS; evt->code=ABS_MISC+1; evt->value=value; return 1;
     case WM_BTNID_NUNCHUK_ACCELX:  evt->type=EV_ABS; evt->code=ABS_MISC+2; evt->value=value; return 1;
@@ -423,6 +646,40 @@ static int wm_delivery_translate_event(struct input_event *evt,const struct wm_d
     case WM_BTNID_CLASSIC_MINUS: evt->code=KEY_MINUS; return 1;
     case WM_BTNID_CLASSIC_HOME:  evt->code=KEY_ESC; return 1;
 
+  /* Pointer gets the cursor, and A and B as mouse buttons. */
+  } else if (delivery->device_type==WM_DEVICE_TYPE_POINTER) switch (btnid) {
+
+    case WM_BTNID_POINTER_X: evt->type=EV_ABS; evt->code=ABS_X; evt->value=value; return 1;
+    case WM_BTNID_POINTER_Y: evt->type=EV_ABS; evt->code=ABS_Y; evt->value=value; return 1;
+    case WM_BTNID_CORE_A:    evt->code=BTN_LEFT; return 1;
+    case WM_BTNID_CORE_B:    evt->code=BTN_RIGHT; return 1;
+
+  /* Gyro, rates about each axis. */
+  } else if (delivery->device_type==WM_DEVICE_TYPE_MOTIONPLUS) switch (btnid) {
+
+    case WM_BTNID_MOTIONPLUS_PITCH: evt->type=EV_ABS; evt->code=ABS_RX; evt->value=value; return 1;
+    case WM_BTNID_MOTIONPLUS_ROLL:  evt->type=EV_ABS; evt->code=ABS_RY; evt->value=value; return 1;
+    case WM_BTNID_MOTIONPLUS_YAW:   evt->type=EV_ABS; evt->code=ABS_RZ; evt->value=value; return 1;
+
+  /* Balance Board: Corners as hid-wiimote reports them, plus total and center of pressure. */
+  } else if (delivery->device_type==WM_DEVICE_TYPE_BALANCE) switch (btnid) {
+
+    case WM_BTNID_BALANCE_TR:    evt->type=EV_ABS; evt->code=ABS_HAT0X; return 1;
+    case WM_BTNID_BALANCE_BR:    evt->type=EV_ABS; evt->code=ABS_HAT0Y; return 1;
+    case WM_BTNID_BALANCE_TL:    evt->type=EV_ABS; evt->code=ABS_HAT1X; return 1;
+    case WM_BTNID_BALANCE_BL:    evt->type=EV_ABS; evt->code=ABS_HAT1Y; return 1;
+    case WM_BTNID_BALANCE_TOTAL: evt->type=EV_ABS; evt->code=ABS_Z; return 1;
+    case WM_BTNID_BALANCE_COPX:  evt->type=EV_ABS; evt->code=ABS_X; return 1;
+    case WM_BTNID_BALANCE_COPY:  evt->type=EV_ABS; evt->code=ABS_Y; return 1;
+
+  /* Described extensions carry their own codes. */
+  } else if ((btnid>=WM_BTNID_EXT_FIELD)&&(btnid<=WM_BTNID_EXT_FIELD_LAST)) {
+    const struct wm_extdesc_field *field=wm_extdesc_find_field(wm_extdesc_for_device_type(delivery->device_type),btnid);
+    if (!field) return 0;
+    if (field->flags&WM_EXTDESC_AXIS) evt->type=EV_ABS;
+    evt->code=field->code;
+    return 1;
+
   /* Treat extension buttons as primaries. */
   } else switch (btnid) {
 
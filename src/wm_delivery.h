@@ -7,6 +7,7 @@
 #define WM_DELIVERY_H
 
 struct wm_delivery;
+struct wm_rumble;
 
 struct wm_delivery *wm_delivery_new();
 void wm_delivery_del(struct wm_delivery *delivery);
@@ -22,6 +23,9 @@ int wm_delivery_get_device_type(const struct wm_delivery *delivery);
 
 int wm_delivery_set_nunchuk_separate(struct wm_delivery *delivery,int separate);
 int wm_delivery_set_classic_separate(struct wm_delivery *delivery,int separate);
+int wm_delivery_set_orientation(struct wm_delivery *delivery,int orientation);
+int wm_delivery_set_gesture_key(struct wm_delivery *delivery,int gesture,int keycode); // WM_GESTURE_*, zero to disable
+int wm_delivery_set_rumble(struct wm_delivery *delivery,struct wm_rumble *rumble); // WEAK. Advertise FF_RUMBLE and feed it.
 
 /* A connected delivery has an open connection to uinput and can be accessed via evdev.
  */
@@ -29,6 +33,19 @@ int wm_delivery_connect(struct wm_delivery *delivery);
 int wm_delivery_disconnect(struct wm_delivery *delivery);
 int wm_delivery_is_connected(const struct wm_delivery *delivery);
 
+/* uinput talks back, with LED changes and force feedback.
+ * Poll this fd for reading while connected, and call wm_delivery_update() when it's ready.
+ * Update returns >0 if anything happened: The caller should check wm_delivery_get_leds() and wm_rumble_update().
+ */
+int wm_delivery_get_fd(const struct wm_delivery *delivery);
+int wm_delivery_update(struct wm_delivery *delivery);
+
+/* Core device's LEDs 1..4, in bits 0..3. Evdev sees them as LED_NUML..LED_COMPOSE.
+ * Setting them here also tells evdev, so clients can read the current state.
+ */
+int wm_delivery_set_leds(struct wm_delivery *delivery,int leds);
+int wm_delivery_get_leds(const struct wm_delivery *delivery);
+
 /* Call this for any changed report item.
  */
 int wm_delivery_set_button(struct wm_delivery *delivery,int btnid,int value);
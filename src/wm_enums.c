@@ -59,6 +59,26 @@ const char *wm_btnid_repr(int btnid) {
     _(CLASSIC_MINUS)
     _(CLASSIC_HOME)
 
+    _(POINTER_X)
+    _(POINTER_Y)
+
+    _(MOTIONPLUS_YAW)
+    _(MOTIONPLUS_ROLL)
+    _(MOTIONPLUS_PITCH)
+    _(MOTIONPLUS_EXTPRESENT)
+
+    _(ORIENT_ROLL)
+    _(ORIENT_PITCH)
+    _(ORIENT_YAW)
+
+    _(BALANCE_TR)
+    _(BALANCE_BR)
+    _(BALANCE_TL)
+    _(BALANCE_BL)
+    _(BALANCE_TOTAL)
+    _(BALANCE_COPX)
+    _(BALANCE_COPY)
+
     #undef _
   }
   return 0;
@@ -73,7 +93,47 @@ const char *wm_device_type_repr(int type) {
     _(WIIMOTE)
     _(NUNCHUK)
     _(CLASSIC)
+    _(POINTER)
+    _(MOTIONPLUS)
+    _(GUITAR)
+    _(DRUMS)
+    _(TURNTABLE)
+    _(TABLET)
+    _(BALANCE)
     #undef _
   }
   return 0;
 }
+
+/* Gesture.
+ */
+
+static const char *wm_gesture_names[WM_GESTURE_COUNT]={
+  [WM_GESTURE_SHAKE]="shake",
+  [WM_GESTURE_SWING_LEFT]="swing-left",
+  [WM_GESTURE_SWING_RIGHT]="swing-right",
+  [WM_GESTURE_SWING_UP]="swing-up",
+  [WM_GESTURE_SWING_DOWN]="swing-down",
+  [WM_GESTURE_TILT_LEFT]="tilt-left",
+  [WM_GESTURE_TILT_RIGHT]="tilt-right",
+  [WM_GESTURE_TILT_FORWARD]="tilt-forward",
+  [WM_GESTURE_TILT_BACK]="tilt-back",
+  [WM_GESTURE_TAP]="tap",
+};
+
+const char *wm_gesture_repr(int gesture) {
+  if ((gesture<0)||(gesture>=WM_GESTURE_COUNT)) return 0;
+  return wm_gesture_names[gesture];
+}
+
+int wm_gesture_eval(const char *src,int srcc) {
+  if (!src) return -1;
+  if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  int i; for (i=0;i<WM_GESTURE_COUNT;i++) {
+    const char *name=wm_gesture_names[i];
+    if (memcmp(src,name,srcc)) continue;
+    if (name[srcc]) continue;
+    return i;
+  }
+  return -1;
+}
@@ -8,6 +8,13 @@
 #define WM_DEVICE_TYPE_WIIMOTE     1
 #define WM_DEVICE_TYPE_NUNCHUK     2
 #define WM_DEVICE_TYPE_CLASSIC     3
+#define WM_DEVICE_TYPE_POINTER     4 /* IR cursor, not an extension. */
+#define WM_DEVICE_TYPE_MOTIONPLUS  5 /* Gyro, alongside any extension. */
+#define WM_DEVICE_TYPE_GUITAR      6 /* This and the rest are decoded from wm_extdesc. */
+#define WM_DEVICE_TYPE_DRUMS       7
+#define WM_DEVICE_TYPE_TURNTABLE   8
+#define WM_DEVICE_TYPE_TABLET      9
+#define WM_DEVICE_TYPE_BALANCE    10 /* Balance Board. Identified by wm_extdesc, decoded by hand. */
 
 #define WM_BTNID_CORE_UP           1
 #define WM_BTNID_CORE_DOWN         2
@@ -60,11 +67,75 @@
 #define WM_BTNID_CLASSIC_MINUS    45
 #define WM_BTNID_CLASSIC_HOME     46
 
+#define WM_BTNID_POINTER_X        47
+#define WM_BTNID_POINTER_Y        48
+
+#define WM_BTNID_MOTIONPLUS_YAW        49
+#define WM_BTNID_MOTIONPLUS_ROLL       50
+#define WM_BTNID_MOTIONPLUS_PITCH      51
+#define WM_BTNID_MOTIONPLUS_EXTPRESENT 52
+
+#define WM_BTNID_ORIENT_ROLL      53
+#define WM_BTNID_ORIENT_PITCH     54
+#define WM_BTNID_ORIENT_YAW       55
+
+/* One button per gesture, WM_BTNID_GESTURE+WM_GESTURE_*. */
+#define WM_BTNID_GESTURE          56
+
+/* Extensions described in wm_extdesc report their fields as WM_BTNID_EXT_FIELD+n. */
+#define WM_BTNID_EXT_FIELD        66
+#define WM_BTNID_EXT_FIELD_LAST   89
+
+/* Balance Board. Weights in units of WM_BALANCE_UNIT_G, center of pressure in millimeters. */
+#define WM_BTNID_BALANCE_TR       90
+#define WM_BTNID_BALANCE_BR       91
+#define WM_BTNID_BALANCE_TL       92
+#define WM_BTNID_BALANCE_BL       93
+#define WM_BTNID_BALANCE_TOTAL    94
+#define WM_BTNID_BALANCE_COPX     95
+#define WM_BTNID_BALANCE_COPY     96
+
+#define WM_GESTURE_SHAKE           0
+#define WM_GESTURE_SWING_LEFT      1
+#define WM_GESTURE_SWING_RIGHT     2
+#define WM_GESTURE_SWING_UP        3
+#define WM_GESTURE_SWING_DOWN      4
+#define WM_GESTURE_TILT_LEFT       5
+#define WM_GESTURE_TILT_RIGHT      6
+#define WM_GESTURE_TILT_FORWARD    7
+#define WM_GESTURE_TILT_BACK       8
+#define WM_GESTURE_TAP             9
+#define WM_GESTURE_COUNT          10
+
 const char *wm_btnid_repr(int btnid);
 const char *wm_device_type_repr(int type);
 
+/* Gesture names are lowercase with dashes, as in the config file: "swing-left"
+ */
+const char *wm_gesture_repr(int gesture);
+int wm_gesture_eval(const char *src,int srcc);
+
 static inline int wm_btnid_is_extension(int btnid) {
-  return (btnid>=WM_BTNID_NUNCHUK_X)?1:0;
+  if ((btnid>=WM_BTNID_NUNCHUK_X)&&(btnid<=WM_BTNID_CLASSIC_HOME)) return 1;
+  if ((btnid>=WM_BTNID_EXT_FIELD)&&(btnid<=WM_BTNID_EXT_FIELD_LAST)) return 1;
+  if ((btnid>=WM_BTNID_BALANCE_TR)&&(btnid<=WM_BTNID_BALANCE_COPY)) return 1;
+  return 0;
+}
+
+/* Changes that mean a person is using the device: Buttons, sticks, gestures, the pointer, the gyro, and the Balance Board.
+ * Some people only ever stand on the board or point, and that counts.
+ * Not the accelerometers, which wander even when the remote is on a table.
+ */
+static inline int wm_btnid_is_activity(int btnid) {
+  if ((btnid>=WM_BTNID_CORE_UP)&&(btnid<=WM_BTNID_CORE_HOME)) return 1;
+  if ((btnid>=WM_BTNID_NUNCHUK_X)&&(btnid<=WM_BTNID_NUNCHUK_Y)) return 1;
+  if ((btnid>=WM_BTNID_NUNCHUK_Z)&&(btnid<=WM_BTNID_CLASSIC_HOME)) return 1;
+  if ((btnid>=WM_BTNID_POINTER_X)&&(btnid<=WM_BTNID_POINTER_Y)) return 1;
+  if ((btnid>=WM_BTNID_MOTIONPLUS_YAW)&&(btnid<=WM_BTNID_MOTIONPLUS_PITCH)) return 1;
+  if ((btnid>=WM_BTNID_GESTURE)&&(btnid<WM_BTNID_GESTURE+WM_GESTURE_COUNT)) return 1;
+  if ((btnid>=WM_BTNID_EXT_FIELD)&&(btnid<=WM_BTNID_EXT_FIELD_LAST)) return 1;
+  if ((btnid>=WM_BTNID_BALANCE_TR)&&(btnid<=WM_BTNID_BALANCE_COPY)) return 1;
+  return 0;
 }
 
 #endif
@@ -0,0 +1,236 @@
+#include "wiimote.h"
+#include "wm_extdesc.h"
+#include "wm_enums.h"
+#include <linux/input.h>
+
+/* Field shorthand.
+ * BUTTON: One bit, active-low unless noted, as nearly every extension button is.
+ * AXIS: Unsigned axis, up to four segments, most significant first.
+ */
+
+#define F WM_BTNID_EXT_FIELD
+#define BUTTON(btnid,code,byte,bit) {btnid,WM_EXTDESC_INVERT,code,0,1,{{byte,bit,1}}}
+#define AXIS(btnid,code,flags,center,segc,...) {btnid,WM_EXTDESC_AXIS|(flags),code,center,segc,{__VA_ARGS__}}
+
+/* Nunchuk.
+ *   0000  1 stick X
+ *   0001  1 stick Y
+ *   0002  3 accelerometer X,Y,Z bits 9..2
+ *   0005  1 (c0)=AZ<1:0>, (30)=AY<1:0>, (0c)=AX<1:0>, (02)=C, (01)=Z
+ */
+
+static const struct wm_extdesc_field wm_extdesc_nunchuk[]={
+  AXIS(WM_BTNID_NUNCHUK_X,ABS_X,0,128,1,{0,0,8}),
+  AXIS(WM_BTNID_NUNCHUK_Y,ABS_Y,WM_EXTDESC_INVERT,128,1,{1,0,8}),
+  AXIS(WM_BTNID_NUNCHUK_ACCELX,ABS_RX,0,512,2,{2,0,8},{5,2,2}),
+  AXIS(WM_BTNID_NUNCHUK_ACCELY,ABS_RY,0,512,2,{3,0,8},{5,4,2}),
+  AXIS(WM_BTNID_NUNCHUK_ACCELZ,ABS_RZ,0,512,2,{4,0,8},{5,6,2}),
+  BUTTON(WM_BTNID_NUNCHUK_Z,BTN_0,5,0),
+  BUTTON(WM_BTNID_NUNCHUK_C,BTN_1,5,1),
+};
+
+/* Classic and Classic Pro.
+ *   0000  1 (c0)=RX<4:3>, (3f)=LX
+ *   0001  1 (c0)=RX<2:1>, (3f)=LY
+ *   0002  1 (80)=RX<0>, (60)=LT<4:3>, (1f)=RY
+ *   0003  1 (e0)=LT<2:0>, (1f)=RT
+ *   0004  1 right, down, L, minus, home, plus, R, (1)
+ *   0005  1 ZL, B, Y, A, X, ZR, left, up
+ */
+
+static const struct wm_extdesc_field wm_extdesc_classic[]={
+  AXIS(WM_BTNID_CLASSIC_LX,ABS_X,0,32,1,{0,0,6}),
+  AXIS(WM_BTNID_CLASSIC_LY,ABS_Y,WM_EXTDESC_INVERT,32,1,{1,0,6}),
+  AXIS(WM_BTNID_CLASSIC_RX,ABS_RX,0,16,3,{0,6,2},{1,6,2},{2,7,1}),
+  AXIS(WM_BTNID_CLASSIC_RY,ABS_RY,WM_EXTDESC_INVERT,16,1,{2,0,5}),
+  AXIS(WM_BTNID_CLASSIC_LA,ABS_Z,0,0,2,{2,5,2},{3,5,3}),
+  AXIS(WM_BTNID_CLASSIC_RA,ABS_RZ,0,0,1,{3,0,5}),
+  BUTTON(WM_BTNID_CLASSIC_UP,BTN_0,5,0),
+  BUTTON(WM_BTNID_CLASSIC_LEFT,BTN_2,5,1),
+  BUTTON(WM_BTNID_CLASSIC_ZR,BTN_TR2,5,2),
+  BUTTON(WM_BTNID_CLASSIC_X,BTN_NORTH,5,3),
+  BUTTON(WM_BTNID_CLASSIC_A,BTN_EAST,5,4),
+  BUTTON(WM_BTNID_CLASSIC_Y,BTN_WEST,5,5),
+  BUTTON(WM_BTNID_CLASSIC_B,BTN_SOUTH,5,6),
+  BUTTON(WM_BTNID_CLASSIC_ZL,BTN_TL2,5,7),
+  BUTTON(WM_BTNID_CLASSIC_R,BTN_TR,4,1),
+  BUTTON(WM_BTNID_CLASSIC_PLUS,BTN_START,4,2),
+  BUTTON(WM_BTNID_CLASSIC_HOME,BTN_MODE,4,3),
+  BUTTON(WM_BTNID_CLASSIC_MINUS,BTN_SELECT,4,4),
+  BUTTON(WM_BTNID_CLASSIC_L,BTN_TL,4,5),
+  BUTTON(WM_BTNID_CLASSIC_DOWN,BTN_1,4,6),
+  BUTTON(WM_BTNID_CLASSIC_RIGHT,BTN_3,4,7),
+};
+
+/* Guitar Hero guitars.
+ *   0000  1 (3f)=stick X
+ *   0001  1 (3f)=stick Y
+ *   0002  1 (1f)=touch bar (World Tour only)
+ *   0003  1 (1f)=whammy bar, resting around 16
+ *   0004  1 (40)=strum down, (10)=minus, (04)=plus
+ *   0005  1 (80)=orange, (40)=red, (20)=blue, (10)=green, (08)=yellow, (01)=strum up
+ * Codes follow the kernel's hid-wiimote, so games that know that driver know us too.
+ */
+
+static const struct wm_extdesc_field wm_extdesc_guitar[]={
+  AXIS(F+0,ABS_X,0,32,1,{0,0,6}),
+  AXIS(F+1,ABS_Y,WM_EXTDESC_INVERT,32,1,{1,0,6}),
+  AXIS(F+2,ABS_HAT0X,0,0,1,{2,0,5}),
+  AXIS(F+3,ABS_HAT1X,0,16,1,{3,0,5}),
+  BUTTON(F+4,BTN_1,5,4), // green
+  BUTTON(F+5,BTN_2,5,6), // red
+  BUTTON(F+6,BTN_3,5,3), // yellow
+  BUTTON(F+7,BTN_4,5,5), // blue
+  BUTTON(F+8,BTN_5,5,7), // orange
+  BUTTON(F+9,BTN_DPAD_UP,5,0), // strum
+  BUTTON(F+10,BTN_DPAD_DOWN,4,6),
+  BUTTON(F+11,BTN_START,4,2),
+  BUTTON(F+12,BTN_SELECT,4,4),
+};
+
+/* Guitar Hero drums.
+ *   0000  1 (3f)=stick X
+ *   0001  1 (3f)=stick Y
+ *   0002  1 (80)=hi-hat pedal, (40)=velocity absent, (3e)=which pad the velocity is for
+ *   0003  1 (e0)=softness, 7 for the lightest hit
+ *   0004  1 (10)=minus, (04)=plus
+ *   0005  1 (80)=orange, (40)=red, (20)=yellow, (10)=green, (08)=blue, (04)=bass pedal
+ * We report velocity as a single axis, hardest 7, and 0 in reports that carry none.
+ * Which pad it belongs to is left to the pad buttons.
+ */
+
+static const struct wm_extdesc_field wm_extdesc_drums[]={
+  AXIS(F+0,ABS_X,0,32,1,{0,0,6}),
+  AXIS(F+1,ABS_Y,WM_EXTDESC_INVERT,32,1,{1,0,6}),
+  AXIS(F+2,ABS_PRESSURE,WM_EXTDESC_INVERT|WM_EXTDESC_GATED,7,2,{2,6,1},{3,5,3}),
+  BUTTON(F+3,BTN_1,5,4), // green
+  BUTTON(F+4,BTN_2,5,6), // red
+  BUTTON(F+5,BTN_3,5,5), // yellow
+  BUTTON(F+6,BTN_4,5,3), // blue
+  BUTTON(F+7,BTN_5,5,7), // orange
+  BUTTON(F+8,BTN_6,5,2), // bass
+  BUTTON(F+9,BTN_7,2,7), // hi-hat
+  BUTTON(F+10,BTN_START,4,2),
+  BUTTON(F+11,BTN_SELECT,4,4),
+};
+
+/* DJ Hero turntable. From WiiBrew; I don't have one, so this is unverified.
+ *   0000  1 (c0)=RTT<4:3>, (3f)=stick X
+ *   0001  1 (c0)=RTT<2:1>, (3f)=stick Y
+ *   0002  1 (80)=RTT<0>, (60)=effect dial<4:3>, (1e)=crossfader, (01)=RTT<5> sign
+ *   0003  1 (e0)=effect dial<2:0>, (1f)=LTT<4:0>
+ *   0004  1 (40)=right red, (10)=minus, (04)=plus, (01)=LTT<5> sign
+ *   0005  1 (80)=left blue, (20)=right green, (10)=euphoria, (08)=left green, (04)=right blue, (01)=left red
+ * Turntables are signed 6-bit rates.
+ */
+
+static const struct wm_extdesc_field wm_extdesc_turntable[]={
+  AXIS(F+0,ABS_X,0,32,1,{0,0,6}),
+  AXIS(F+1,ABS_Y,WM_EXTDESC_INVERT,32,1,{1,0,6}),
+  AXIS(F+2,ABS_HAT0X,WM_EXTDESC_SIGNED,0,2,{4,0,1},{3,0,5}),
+  AXIS(F+3,ABS_HAT1X,WM_EXTDESC_SIGNED,0,4,{2,0,1},{0,6,2},{1,6,2},{2,7,1}),
+  AXIS(F+4,ABS_HAT2X,0,0,2,{2,5,2},{3,5,3}),
+  AXIS(F+5,ABS_HAT3X,0,8,1,{2,1,4}),
+  BUTTON(F+6,BTN_1,5,3), // left green
+  BUTTON(F+7,BTN_2,5,0), // left red
+  BUTTON(F+8,BTN_3,5,7), // left blue
+  BUTTON(F+9,BTN_4,5,5), // right green
+  BUTTON(F+10,BTN_5,4,6), // right red
+  BUTTON(F+11,BTN_6,5,2), // right blue
+  BUTTON(F+12,BTN_MODE,5,4), // euphoria
+  BUTTON(F+13,BTN_START,4,2),
+  BUTTON(F+14,BTN_SELECT,4,4),
+};
+
+/* Drawsome tablet. Only partly documented, and again unverified.
+ *   0000  2 X, little-endian
+ *   0002  2 Y, little-endian
+ *   0004  1 pressure<7:0>
+ *   0005  1 (0f)=pressure<11:8>
+ */
+
+static const struct wm_extdesc_field wm_extdesc_tablet[]={
+  AXIS(F+0,ABS_X,0,0,2,{1,0,8},{0,0,8}),
+  AXIS(F+1,ABS_Y,0,0,2,{3,0,8},{2,0,8}),
+  AXIS(F+2,ABS_PRESSURE,0,0,2,{5,0,4},{4,0,8}),
+};
+
+#undef F
+#undef BUTTON
+#undef AXIS
+
+/* The table.
+ */
+
+#define FIELDS(v) sizeof(v)/sizeof(v[0]),v
+
+static const struct wm_extdesc wm_extdescv[]={
+  {WM_DEVICE_TYPE_NUNCHUK,  {0x00,0x00,0xa4,0x20,0x00,0x00},FIELDS(wm_extdesc_nunchuk)},
+  {WM_DEVICE_TYPE_CLASSIC,  {0x00,0x00,0xa4,0x20,0x01,0x01},FIELDS(wm_extdesc_classic)},
+  {WM_DEVICE_TYPE_CLASSIC,  {0x01,0x00,0xa4,0x20,0x01,0x01},FIELDS(wm_extdesc_classic)},
+  {WM_DEVICE_TYPE_GUITAR,   {0x00,0x00,0xa4,0x20,0x01,0x03},FIELDS(wm_extdesc_guitar)},
+  {WM_DEVICE_TYPE_DRUMS,    {0x01,0x00,0xa4,0x20,0x01,0x03},FIELDS(wm_extdesc_drums)},
+  {WM_DEVICE_TYPE_TURNTABLE,{0x03,0x00,0xa4,0x20,0x01,0x03},FIELDS(wm_extdesc_turntable)},
+  {WM_DEVICE_TYPE_TABLET,   {0xff,0x00,0xa4,0x20,0x00,0x13},FIELDS(wm_extdesc_tablet)},
+  {WM_DEVICE_TYPE_BALANCE,  {0x00,0x00,0xa4,0x20,0x04,0x02},0,0}, // Decoded in wm_report; it needs calibration.
+};
+
+#undef FIELDS
+
+#define WM_EXTDESC_COUNT (sizeof(wm_extdescv)/sizeof(wm_extdescv[0]))
+
+/* Lookup.
+ */
+
+const struct wm_extdesc *wm_extdesc_for_id(const uint8_t *rawid) {
+  if (!rawid) return 0;
+  const struct wm_extdesc *desc=wm_extdescv;
+  int i=WM_EXTDESC_COUNT; for (;i-->0;desc++) {
+    if (!memcmp(desc->id,rawid,6)) return desc;
+  }
+  return 0;
+}
+
+const struct wm_extdesc *wm_extdesc_for_device_type(int device_type) {
+  const struct wm_extdesc *desc=wm_extdescv;
+  int i=WM_EXTDESC_COUNT; for (;i-->0;desc++) {
+    if (desc->device_type==device_type) return desc;
+  }
+  return 0;
+}
+
+const struct wm_extdesc_field *wm_extdesc_find_field(const struct wm_extdesc *desc,int btnid) {
+  if (!desc) return 0;
+  const struct wm_extdesc_field *field=desc->fieldv;
+  int i=desc->fieldc; for (;i-->0;field++) {
+    if (field->btnid==btnid) return field;
+  }
+  return 0;
+}
+
+/* Range.
+ */
+
+void wm_extdesc_field_range(int *lo,int *hi,const struct wm_extdesc_field *field) {
+  if (!(field->flags&WM_EXTDESC_AXIS)) {
+    *lo=0;
+    *hi=1;
+    return;
+  }
+  int width=0,i;
+  for (i=(field->flags&WM_EXTDESC_GATED)?1:0;i<field->segc;i++) width+=field->segv[i].width;
+  int rlo=0,rhi=(1<<width)-1;
+  if (field->flags&WM_EXTDESC_SIGNED) {
+    rlo=-(1<<(width-1));
+    rhi=(1<<(width-1))-1;
+  }
+  rlo-=field->center;
+  rhi-=field->center;
+  if (field->flags&WM_EXTDESC_INVERT) {
+    *lo=-rhi;
+    *hi=-rlo;
+  } else {
+    *lo=rlo;
+    *hi=rhi;
+  }
+}
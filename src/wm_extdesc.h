@@ -0,0 +1,76 @@
+/* wm_extdesc.h
+ * Extension descriptors: What an extension's ID is, and where each control lives in its 6-byte report.
+ * Extensions without a hand-written decoder in wm_report are decoded generically from these tables,
+ * and wm_delivery takes their uinput codes from here too. So a new peripheral is just a new table.
+ * Nunchuk and Classic are described as well, for identification and to check the generic decoder against.
+ */
+
+#ifndef WM_EXTDESC_H
+#define WM_EXTDESC_H
+
+/* Most fields a descriptor may have. Generic fields usually report as WM_BTNID_EXT_FIELD+index. */
+#define WM_EXTDESC_FIELD_LIMIT 24
+
+/* A run of bits within one byte: ((src[byte]>>shift)&((1<<width)-1)). */
+struct wm_extdesc_segment {
+  uint8_t byte,shift,width;
+};
+
+#define WM_EXTDESC_AXIS    0x01 /* Absolute axis. Otherwise a one-bit button. */
+#define WM_EXTDESC_INVERT  0x02 /* Buttons: Active-low. Axes: Negate after centering. */
+#define WM_EXTDESC_SIGNED  0x04 /* Axes: Raw value is two's complement. */
+#define WM_EXTDESC_GATED   0x08 /* Axes: First segment is a one-bit "no value" flag, not part of the value. Report 0 while it's set. */
+
+/* Value is the segments concatenated, most significant first.
+ * Axes report (raw-center), negated if INVERT. Buttons report 0 or 1.
+ */
+struct wm_extdesc_field {
+  int btnid;
+  uint8_t flags;
+  uint16_t code; // BTN_*, KEY_*, or ABS_*
+  int center;
+  int segc;
+  struct wm_extdesc_segment segv[4];
+};
+
+struct wm_extdesc {
+  int device_type;
+  uint8_t id[6];
+  int fieldc;
+  const struct wm_extdesc_field *fieldv;
+};
+
+/* Find a descriptor by raw extension ID (6 bytes from 0x04a400fa) or by WM_DEVICE_TYPE_*.
+ * Several IDs may share a device type, eg Classic and Classic Pro. By type, you get the first.
+ */
+const struct wm_extdesc *wm_extdesc_for_id(const uint8_t *rawid);
+const struct wm_extdesc *wm_extdesc_for_device_type(int device_type);
+
+const struct wm_extdesc_field *wm_extdesc_find_field(const struct wm_extdesc *desc,int btnid);
+
+/* Range of values a field can report, for uinput.
+ */
+void wm_extdesc_field_range(int *lo,int *hi,const struct wm_extdesc_field *field);
+
+/* Decode one field from a 6-byte extension report.
+ */
+static inline int wm_extdesc_field_decode(const struct wm_extdesc_field *field,const uint8_t *src) {
+  int v=0,width=0;
+  const struct wm_extdesc_segment *seg=field->segv;
+  int i=field->segc;
+  if (field->flags&WM_EXTDESC_GATED) {
+    if ((src[seg->byte]>>seg->shift)&1) return 0;
+    seg++;
+    i--;
+  }
+  for (;i-->0;seg++) {
+    v=(v<<seg->width)|((src[seg->byte]>>seg->shift)&((1<<seg->width)-1));
+    width+=seg->width;
+  }
+  if (!(field->flags&WM_EXTDESC_AXIS)) return (field->flags&WM_EXTDESC_INVERT)?!v:v;
+  if ((field->flags&WM_EXTDESC_SIGNED)&&(v&(1<<(width-1)))) v-=1<<width;
+  v-=field->center;
+  return (field->flags&WM_EXTDESC_INVERT)?-v:v;
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 /* Read entire file.
  */
@@ -44,3 +45,46 @@ int wm_file_read(void *dstpp,const char *path,int require) {
   close(fd);
   return dstc;
 }
+
+/* Write entire file.
+ */
+
+int wm_file_write(const char *path,const void *src,int srcc) {
+  if (!path||(srcc<0)||(srcc&&!src)) return -1;
+
+  char tmppath[1024];
+  int tmppathc=snprintf(tmppath,sizeof(tmppath),"%s.tmp",path);
+  if ((tmppathc<1)||(tmppathc>=sizeof(tmppath))) return -1;
+
+  int fd=open(tmppath,O_WRONLY|O_CREAT|O_TRUNC,0644);
+  if (fd<0) return -1;
+
+  int srcp=0;
+  while (srcp<srcc) {
+    int err=write(fd,(const char*)src+srcp,srcc-srcp);
+    if (err<=0) {
+      close(fd);
+      unlink(tmppath);
+      return -1;
+    }
+    srcp+=err;
+  }
+  close(fd);
+
+  if (rename(tmppath,path)<0) {
+    unlink(tmppath);
+    return -1;
+  }
+  return 0;
+}
+
+/* Create directory.
+ */
+
+int wm_dir_require(const char *path) {
+  if (!path||!path[0]) return -1;
+  if (mkdir(path,0755)<0) {
+    if (errno!=EEXIST) return -1;
+  }
+  return 0;
+}
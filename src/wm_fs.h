@@ -7,4 +7,12 @@
 
 int wm_file_read(void *dstpp,const char *path,int require);
 
+/* Replace file atomically, via a temporary file in the same directory.
+ */
+int wm_file_write(const char *path,const void *src,int srcc);
+
+/* Create a directory if it doesn't exist yet. Parents must exist.
+ */
+int wm_dir_require(const char *path);
+
 #endif
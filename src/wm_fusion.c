@@ -0,0 +1,124 @@
+#include "wiimote.h"
+#include "wm_fusion.h"
+#include "wm_report.h"
+
+/* Gravity correction time constant. Shorter follows the accelerometer more, and its noise too. */
+#define WM_FUSION_TAU_US 500000
+
+/* Skip the correction when the acceleration is far from 1 g; the remote is being swung and gravity is unknowable. */
+#define WM_FUSION_ACCEL_LO ((WM_ACCEL_1G*3)>>2)
+#define WM_FUSION_ACCEL_HI ((WM_ACCEL_1G*5)>>2)
+
+/* WM_GYRO units to millidegrees per second. One slow-mode count is 1/13.768 degree per second. Q8. */
+#define WM_FUSION_GYRO_MUL ((1000*256*1000)/13768)
+
+/* atan(2**-i) in millidegrees, for CORDIC. */
+static const int wm_fusion_atan_table[16]={
+  45000,26565,14036,7125,3576,1790,895,448,224,112,56,28,14,7,3,2,
+};
+
+/* CORDIC gain, 1/1.6468 in Q16. */
+#define WM_FUSION_CORDIC_K 39797
+
+/* Init.
+ */
+
+void wm_fusion_init(struct wm_fusion *fusion) {
+  memset(fusion,0,sizeof(struct wm_fusion));
+  fusion->az=WM_ACCEL_1G;
+  fusion->tau_us=WM_FUSION_TAU_US;
+}
+
+/* Latch inputs.
+ */
+
+void wm_fusion_set_accel(struct wm_fusion *fusion,int x,int y,int z) {
+  fusion->ax=x;
+  fusion->ay=y;
+  fusion->az=z;
+}
+
+void wm_fusion_set_gyro(struct wm_fusion *fusion,int yaw,int roll,int pitch) {
+  fusion->ryaw=(int)(((int64_t)yaw*WM_FUSION_GYRO_MUL)>>8);
+  fusion->rroll=(int)(((int64_t)roll*WM_FUSION_GYRO_MUL)>>8);
+  fusion->rpitch=(int)(((int64_t)pitch*WM_FUSION_GYRO_MUL)>>8);
+  fusion->have_gyro=1;
+}
+
+void wm_fusion_clear_gyro(struct wm_fusion *fusion) {
+  fusion->ryaw=fusion->rroll=fusion->rpitch=0;
+  fusion->have_gyro=0;
+}
+
+/* CORDIC vectoring: Rotate (x,y) onto the X axis and add up the angles.
+ * Optionally also returns the magnitude, since it falls out for free.
+ */
+
+static int wm_fusion_cordic(int *mag,int y,int x) {
+  int z=0;
+  if (x<0) {
+    z=(y>=0)?WM_FUSION_HALF_TURN:-WM_FUSION_HALF_TURN;
+    x=-x;
+    y=-y;
+  }
+  // Inputs are at most a few thousand; scale up for precision, leaving headroom for the CORDIC gain.
+  x<<=12;
+  y<<=12;
+  int i; for (i=0;i<16;i++) {
+    int nx;
+    if (y>0) {
+      nx=x+(y>>i);
+      y-=x>>i;
+      z+=wm_fusion_atan_table[i];
+    } else {
+      nx=x-(y>>i);
+      y+=x>>i;
+      z-=wm_fusion_atan_table[i];
+    }
+    x=nx;
+  }
+  if (mag) *mag=(int)(((int64_t)x*WM_FUSION_CORDIC_K)>>28);
+  if (z>=WM_FUSION_HALF_TURN) z-=WM_FUSION_HALF_TURN*2;
+  return z;
+}
+
+int wm_fusion_atan2(int y,int x) {
+  return wm_fusion_cordic(0,y,x);
+}
+
+/* Wrap an angle into -180..180 degrees. Only ever off by one turn here.
+ */
+
+static inline int wm_fusion_wrap(int a) {
+  if (a>=WM_FUSION_HALF_TURN) return a-WM_FUSION_HALF_TURN*2;
+  if (a<-WM_FUSION_HALF_TURN) return a+WM_FUSION_HALF_TURN*2;
+  return a;
+}
+
+/* Step.
+ */
+
+void wm_fusion_step(struct wm_fusion *fusion,int dt_us) {
+  if (dt_us<=0) return;
+
+  /* Integrate the gyro. */
+  if (fusion->have_gyro) {
+    fusion->roll=wm_fusion_wrap(fusion->roll+(int)(((int64_t)fusion->rroll*dt_us)/1000000));
+    fusion->pitch=wm_fusion_wrap(fusion->pitch+(int)(((int64_t)fusion->rpitch*dt_us)/1000000));
+    fusion->yaw=wm_fusion_wrap(fusion->yaw+(int)(((int64_t)fusion->ryaw*dt_us)/1000000));
+  }
+
+  /* Gravity, if we believe it. */
+  int xz;
+  int roll=wm_fusion_cordic(&xz,fusion->ax,fusion->az);
+  int mag2=xz*xz+fusion->ay*fusion->ay;
+  if ((mag2<WM_FUSION_ACCEL_LO*WM_FUSION_ACCEL_LO)||(mag2>WM_FUSION_ACCEL_HI*WM_FUSION_ACCEL_HI)) return;
+  int pitch=wm_fusion_atan2(fusion->ay,xz);
+
+  /* Pull toward it by dt/(tau+dt). Q16. */
+  int gain=(int)(((int64_t)dt_us<<16)/(fusion->tau_us+dt_us));
+  int droll=wm_fusion_wrap(roll-fusion->roll);
+  int dpitch=wm_fusion_wrap(pitch-fusion->pitch);
+  fusion->roll=wm_fusion_wrap(fusion->roll+(int)(((int64_t)droll*gain)>>16));
+  fusion->pitch=wm_fusion_wrap(fusion->pitch+(int)(((int64_t)dpitch*gain)>>16));
+}
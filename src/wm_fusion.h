@@ -0,0 +1,42 @@
+/* wm_fusion.h
+ * Orientation from accelerometer and gyro, with a fixed-point complementary filter.
+ * Gravity gives us roll and pitch but no yaw, and it's noisy while the remote moves.
+ * The gyro is smooth but drifts. So we integrate the gyro, and pull roll and pitch gently toward gravity.
+ * Without a gyro, roll and pitch are just low-passed gravity, and yaw stays zero.
+ * No allocation, no floating point: Same inputs produce the same outputs on any machine.
+ */
+
+#ifndef WM_FUSION_H
+#define WM_FUSION_H
+
+/* All angles are millidegrees, -180000..179999.
+ * Rates are millidegrees per second.
+ */
+#define WM_FUSION_HALF_TURN 180000
+
+struct wm_fusion {
+  int roll,pitch,yaw;
+  int ax,ay,az; // Latest accelerometer, WM_ACCEL_1G.
+  int rroll,rpitch,ryaw; // Latest gyro rates.
+  int have_gyro;
+  int tau_us; // Time constant for the gravity correction.
+};
+
+void wm_fusion_init(struct wm_fusion *fusion);
+
+/* Latch the newest readings. Nothing is computed until wm_fusion_step().
+ * Accelerometer is calibrated, as from wm_report. Gyro is WM_GYRO units, as from wm_report.
+ */
+void wm_fusion_set_accel(struct wm_fusion *fusion,int x,int y,int z);
+void wm_fusion_set_gyro(struct wm_fusion *fusion,int yaw,int roll,int pitch);
+void wm_fusion_clear_gyro(struct wm_fusion *fusion);
+
+/* Advance by (dt_us) using the latched readings.
+ */
+void wm_fusion_step(struct wm_fusion *fusion,int dt_us);
+
+/* Fixed-point atan2, millidegrees. Exposed for testing.
+ */
+int wm_fusion_atan2(int y,int x);
+
+#endif
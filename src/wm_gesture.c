@@ -0,0 +1,119 @@
+#include "wiimote.h"
+#include "wm_gesture.h"
+#include "wm_report.h"
+
+#define WM_GESTURE_MOTION         WM_ACCEL_1G /* Motion beyond gravity to begin or sustain a stroke. */
+#define WM_GESTURE_QUIET_US       120000 /* Stroke ends after this long under the threshold. */
+#define WM_GESTURE_TAP_US         40000 /* Strokes shorter than this are taps. */
+#define WM_GESTURE_SHAKE_REVERSALS 4
+#define WM_GESTURE_REFRACTORY_US  150000 /* After a stroke, ignore motion this long; the hand is settling. */
+#define WM_GESTURE_TILT_ENTER     (WM_ACCEL_1G/2) /* 30 degrees. */
+#define WM_GESTURE_TILT_EXIT      ((WM_ACCEL_1G*3)/8) /* About 22 degrees. */
+
+/* Init.
+ */
+
+void wm_gesture_init(struct wm_gesture *gesture) {
+  memset(gesture,0,sizeof(struct wm_gesture));
+}
+
+/* Tilt on one axis, with hysteresis.
+ */
+
+static int wm_gesture_tilt(struct wm_gesture_event *dst,int *state,int g,int negative,int positive) {
+  int next=*state;
+  if (g>WM_GESTURE_TILT_ENTER) next=1;
+  else if (g<-WM_GESTURE_TILT_ENTER) next=-1;
+  else if ((g<WM_GESTURE_TILT_EXIT)&&(g>-WM_GESTURE_TILT_EXIT)) next=0;
+  if (next==*state) return 0;
+  int dstc=0;
+  if (*state) dst[dstc++]=(struct wm_gesture_event){(*state>0)?positive:negative,0};
+  if (next) dst[dstc++]=(struct wm_gesture_event){(next>0)?positive:negative,1};
+  *state=next;
+  return dstc;
+}
+
+/* Momentary gesture, press and release together.
+ */
+
+static int wm_gesture_fire(struct wm_gesture_event *dst,int gesture) {
+  dst[0]=(struct wm_gesture_event){gesture,1};
+  dst[1]=(struct wm_gesture_event){gesture,0};
+  return 2;
+}
+
+/* Update.
+ */
+
+int wm_gesture_update(
+  struct wm_gesture_event *dst,
+  struct wm_gesture *gesture,
+  int x,int y,int z,
+  int64_t now_us
+) {
+  int dstc=0;
+
+  /* Track gravity. Seed it from the first sample so we don't start with a phantom stroke. */
+  if (!gesture->primed) {
+    gesture->gx=x<<4;
+    gesture->gy=y<<4;
+    gesture->gz=z<<4;
+    gesture->primed=1;
+  } else if (!gesture->stroke_start) {
+    gesture->gx+=((x<<4)-gesture->gx)>>5;
+    gesture->gy+=((y<<4)-gesture->gy)>>5;
+    gesture->gz+=((z<<4)-gesture->gz)>>5;
+  }
+  int dx=x-(gesture->gx>>4);
+  int dz=z-(gesture->gz>>4);
+
+  /* Strokes. */
+  if (now_us>=gesture->refractory_until) {
+    int adx=(dx<0)?-dx:dx;
+    int adz=(dz<0)?-dz:dz;
+    if ((adx>WM_GESTURE_MOTION)||(adz>WM_GESTURE_MOTION)) {
+      if (!gesture->stroke_start) {
+        gesture->stroke_start=now_us;
+        gesture->axis=(adx>=adz)?0:2;
+        gesture->sign=gesture->first_sign=((gesture->axis?dz:dx)<0)?-1:1;
+        gesture->reversals=0;
+        gesture->shaken=0;
+      } else {
+        int d=gesture->axis?dz:dx;
+        if ((d>WM_GESTURE_MOTION)||(d<-WM_GESTURE_MOTION)) {
+          int sign=(d<0)?-1:1;
+          if (sign!=gesture->sign) {
+            gesture->sign=sign;
+            gesture->reversals++;
+          }
+        }
+      }
+      gesture->stroke_last=now_us;
+      if ((gesture->reversals>=WM_GESTURE_SHAKE_REVERSALS)&&!gesture->shaken) {
+        gesture->shaken=1;
+        dstc+=wm_gesture_fire(dst+dstc,WM_GESTURE_SHAKE);
+      }
+
+    } else if (gesture->stroke_start&&(now_us-gesture->stroke_last>=WM_GESTURE_QUIET_US)) {
+      if (!gesture->shaken) {
+        if (gesture->stroke_last-gesture->stroke_start<WM_GESTURE_TAP_US) {
+          dstc+=wm_gesture_fire(dst+dstc,WM_GESTURE_TAP);
+        } else if (gesture->axis) {
+          dstc+=wm_gesture_fire(dst+dstc,(gesture->first_sign>0)?WM_GESTURE_SWING_UP:WM_GESTURE_SWING_DOWN);
+        } else {
+          dstc+=wm_gesture_fire(dst+dstc,(gesture->first_sign>0)?WM_GESTURE_SWING_RIGHT:WM_GESTURE_SWING_LEFT);
+        }
+      }
+      gesture->stroke_start=0;
+      gesture->refractory_until=now_us+WM_GESTURE_REFRACTORY_US;
+    }
+  }
+
+  /* Tilt, only when gravity is trustworthy. */
+  if (!gesture->stroke_start) {
+    dstc+=wm_gesture_tilt(dst+dstc,&gesture->tiltx,gesture->gx>>4,WM_GESTURE_TILT_LEFT,WM_GESTURE_TILT_RIGHT);
+    dstc+=wm_gesture_tilt(dst+dstc,&gesture->tilty,gesture->gy>>4,WM_GESTURE_TILT_BACK,WM_GESTURE_TILT_FORWARD);
+  }
+
+  return dstc;
+}
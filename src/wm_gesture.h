@@ -0,0 +1,52 @@
+/* wm_gesture.h
+ * Streaming motion gestures from one accelerometer: shake, swing, tilt, tap.
+ * Feed it every accelerometer sample, and it tells you only when something meaningful happens.
+ * Constant time and memory per sample, integer only.
+ *
+ * Gravity is tracked with a slow low-pass, and tilt is read from that.
+ * What's left over is motion. A "stroke" begins when motion exceeds a threshold, and ends after a quiet spell:
+ *   - Very short stroke: TAP.
+ *   - Several reversals of direction: SHAKE, fired as soon as we've seen enough.
+ *   - Otherwise: SWING, in the direction of the first push. (the second half of a swing is the hand stopping)
+ */
+
+#ifndef WM_GESTURE_H
+#define WM_GESTURE_H
+
+#include "wm_enums.h"
+
+struct wm_gesture_event {
+  int gesture; // WM_GESTURE_*
+  int value; // 1=press, 0=release. Momentary gestures produce both at once.
+};
+
+/* Longest possible output of one update: A stroke ending and a tilt changing on both axes. */
+#define WM_GESTURE_EVENT_LIMIT 8
+
+struct wm_gesture {
+  int gx,gy,gz; // Gravity, WM_ACCEL_1G<<4.
+  int primed; // Gravity has been seeded from a real sample.
+  int tiltx,tilty; // -1,0,1
+  int64_t stroke_start; // Zero if no stroke in progress.
+  int64_t stroke_last; // Last time motion exceeded the threshold.
+  int64_t refractory_until;
+  int axis; // 0=X, 2=Z: which axis the stroke's first push was on.
+  int sign; // Sign of the dominant axis at the most recent peak.
+  int first_sign;
+  int reversals;
+  int shaken; // SHAKE already fired for this stroke.
+};
+
+void wm_gesture_init(struct wm_gesture *gesture);
+
+/* Digest one sample (calibrated, WM_ACCEL_1G) taken at (now_us).
+ * Fills (dst) with up to WM_GESTURE_EVENT_LIMIT events and returns the count.
+ */
+int wm_gesture_update(
+  struct wm_gesture_event *dst,
+  struct wm_gesture *gesture,
+  int x,int y,int z,
+  int64_t now_us
+);
+
+#endif
@@ -1,6 +1,9 @@
 #include "wiimote.h"
 #include "wm_config.h"
 #include "wm_coord.h"
+#include "wm_bench.h"
+#include "wm_speaker.h"
+#include "wm_rt.h"
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -10,9 +13,13 @@
  */
 
 static volatile int wm_sigc=0;
+static volatile int wm_sigusr1=0;
+static volatile int wm_sighup=0;
 
 static void wm_rcvsig(int sigid) {
   switch (sigid) {
+    case SIGUSR1: wm_sigusr1=1; break;
+    case SIGHUP: wm_sighup=1; break;
     case SIGINT: case SIGTERM: {
         if (++wm_sigc>=3) {
           wm_log_error("Failed to terminate after 3 signals. Aborting hard.");
@@ -31,14 +38,40 @@ static void wm_print_help(const char *exename) {
   printf("OPTIONS:\n");
   printf("  --help                 Print this message.\n");
   printf("  --version              Print version number.\n");
+  printf("  --benchmark[=NAME]     Run microbenchmarks and exit. (fusion,extdecode,adpcm,speaker,latency,busypoll)\n");
   printf("  --uinput-path=PATH     Set path to uinput (default \"/dev/uinput\").\n");
   printf("  --no-daemonize         Stay in the foreground.\n");
   printf("  --retry-count=INT      Try so many times to connect (default 1).\n");
   printf("  --verbosity=INT        How much logging, 0=silent..5=noisy (default 3).\n");
   printf("  --nunchuk-separate     Create a separate device for the nunchuk extension.\n");
   printf("  --no-classic-separate  Report base and classic extension as one device.\n");
+  printf("  --motionplus           Activate MotionPlus if present.\n");
+  printf("  --legacy-ext-init      Initialize extensions the old, encrypted way.\n");
+  printf("  --accel                Report the raw accelerometer.\n");
+  printf("  --orientation          Report roll, pitch, and yaw on the core device.\n");
+  printf("  --no-rumble            Don't offer force feedback.\n");
+  printf("  --gesture.NAME=KEYCODE Press a key for a motion gesture, eg --gesture.shake=57.\n");
+  printf("  --ir                   Enable the IR camera.\n");
+  printf("  --ir-sensitivity=INT   IR camera sensitivity, 1..5 (default 3).\n");
+  printf("  --ir-full              Report IR dot intensity too, when no extension is connected.\n");
+  printf("  --speaker=PATH         Play 16-bit mono PCM from this file or FIFO.\n");
+  printf("  --speaker-rate=HZ      Speaker sample rate, %d..%d (default 3000).\n",WM_SPEAKER_RATE_MIN,WM_SPEAKER_RATE_MAX);
+  printf("  --speaker-volume=INT   Speaker volume, 0..127 (default 64).\n");
+  printf("  --status-interval=SEC  Poll battery this often, 0 to disable (default 60).\n");
+  printf("  --continuous-idle=SEC  Stream motion until idle this long, 0 to never (default 30).\n");
+  printf("  --idle-disconnect=SEC  Turn the remote off after idle this long, 0 to never (default 0).\n");
+  printf("  --reader-thread        Read from the remote on a separate thread.\n");
+  printf("  --busy-poll=US         Spin this long on the socket before sleeping (default 0).\n");
+  printf("  --sched-policy=NAME    other, fifo, or rr (default other).\n");
+  printf("  --sched-priority=INT   Priority for fifo and rr, 1..99 (default 50).\n");
+  printf("  --cpu-affinity=LIST    Run only on these CPUs, eg \"2\" or \"0,2-3\".\n");
+  printf("  --mlock                Lock all memory, so input never waits for a page fault.\n");
+  printf("  --status-dir=PATH      Battery status files here (default \"/run/wiimote\").\n");
+  printf("  --cache-dir=PATH       Remember device details here (default \"/var/cache/wiimote\").\n");
+  printf("  --player-dir=PATH      Lock files for player slots (default \"/run/wiimote\").\n");
   printf("Options may be stored in a config file '%s'.\n",WM_CONFIG_FILE_PATH);
   printf("In the config file, omit the leading dashes, and a value is required.\n");
+  printf("SIGHUP rereads the config file. accel, ir, ir-sensitivity, ir-full, status-interval, continuous-idle, idle-disconnect, and verbosity apply immediately.\n");
 }
 
 static void wm_print_version() {
@@ -115,7 +148,7 @@ static int wm_set_command_line(struct wm_config *config,int argc,char **argv) {
       }
     }
 
-    // Pick off special options "--help" and "--version".
+    // Pick off special options "--help", "--version", and "--benchmark".
     if ((kc==4)&&!memcmp(k,"help",4)) {
       wm_print_help(argv[0]);
       exit(0);
@@ -124,6 +157,9 @@ static int wm_set_command_line(struct wm_config *config,int argc,char **argv) {
       wm_print_version();
       exit(0);
     }
+    if ((kc==9)&&!memcmp(k,"benchmark",9)) {
+      exit((wm_bench_run(v,vc)<0)?1:0);
+    }
 
     // Any other long option goes directly into the config.
     if (wm_config_set(config,k,kc,v,vc)<0) {
@@ -182,6 +218,25 @@ static int wm_daemonize() {
   return 0;
 }
 
+/* Reread configuration from the same sources as at startup, and apply what can change on the fly.
+ * A bad config file is not fatal here: We log it and carry on as we were.
+ */
+
+static int wm_reload(struct wm_coord *coord,struct wm_config *config,int argc,char **argv) {
+  wm_log_info("Reloading configuration.");
+  struct wm_config *fresh=wm_config_new();
+  if (!fresh) return -1;
+  if ((wm_config_read_file(fresh,WM_CONFIG_FILE_PATH)<0)||(wm_set_command_line(fresh,argc,argv)<0)) {
+    wm_log_error("Failed to reload configuration, keeping the old one.");
+    wm_config_del(fresh);
+    return 0;
+  }
+  int err=wm_coord_reconfigure(coord,fresh);
+  wm_config_del(fresh);
+  if (err<0) return -1;
+  return wm_log_configure(config);
+}
+
 /* Main entry point.
  */
 
@@ -191,6 +246,8 @@ int main(int argc,char **argv) {
 
   signal(SIGINT,wm_rcvsig);
   signal(SIGTERM,wm_rcvsig);
+  signal(SIGUSR1,wm_rcvsig);
+  signal(SIGHUP,wm_rcvsig);
 
   struct wm_config *config=wm_config_new();
   if (!config) return 1;
@@ -212,14 +269,28 @@ int main(int argc,char **argv) {
     }
   }
 
+  if (wm_rt_apply(config)<0) {
+    wm_log_error("Failed to apply real-time settings.");
+    return 1;
+  }
+
   wm_log_trace("Begin main loop.");
   while (!wm_sigc&&wm_coord_is_running(coord)) {
     if (wm_coord_update(coord)<0) {
       return 1;
     }
+    if (wm_sigusr1) {
+      wm_sigusr1=0;
+      wm_coord_log_stats(coord);
+    }
+    if (wm_sighup) {
+      wm_sighup=0;
+      if (wm_reload(coord,config,argc,argv)<0) return 1;
+    }
   }
 
   wm_log_trace("Terminating.");
+  if (wm_log_debug_enabled()) wm_coord_log_stats(coord);
   wm_coord_del(coord);
   wm_config_del(config);
   return 0;
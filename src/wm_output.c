@@ -0,0 +1,471 @@
+#include "wiimote.h"
+#include "wm_output.h"
+#include "wm_transport.h"
+#include "wm_report.h"
+#include "wm_stats.h"
+
+#define WM_OUTPUT_STATE_FIRST 0x10
+#define WM_OUTPUT_STATE_LAST  0x1a
+#define WM_OUTPUT_STATE_COUNT (WM_OUTPUT_STATE_LAST-WM_OUTPUT_STATE_FIRST+1)
+
+#define WM_OUTPUT_OP_LIMIT 16
+
+#define WM_OP_STATE_QUEUED   0
+#define WM_OP_STATE_INFLIGHT 1
+
+/* Object definition.
+ */
+
+struct wm_output_state {
+  uint8_t rpt[23];
+  int rptc; // Zero if not pending.
+};
+
+struct wm_output_op {
+  uint8_t rpt[23];
+  int rptc;
+  int tag;
+  int addr;
+  int retries;
+  int state;
+  int64_t sent_time; // Also refreshed at each chunk of a read.
+  uint8_t *buf; // Reads only. (size) bytes, of which (received) are filled, in any order.
+  uint8_t *have; // Reads only, in the same allocation as (buf). One bit per byte of (buf) filled so far.
+  int size;
+  int received;
+};
+
+struct wm_output {
+  struct wm_transport *transport;
+  struct wm_output_delegate delegate;
+  struct wm_stats *stats;
+  uint8_t rumble;
+  struct wm_output_state statev[WM_OUTPUT_STATE_COUNT];
+  struct wm_output_state stream; // Speaker data, 0x18.
+  struct wm_output_op opv[WM_OUTPUT_OP_LIMIT]; // Circular, in order of submission.
+  int opp,opc;
+  int writes_inflight;
+  int read_inflight;
+  int stale_writes; // ACKs still owed for writes we pulled back to resend after an earlier one failed.
+  int64_t stale_time;
+  int op_turn; // A state report just went out, so a queued operation goes next if it can.
+  int64_t next_time;
+};
+
+/* Object lifecycle.
+ */
+
+struct wm_output *wm_output_new(struct wm_transport *transport,const struct wm_output_delegate *delegate,struct wm_stats *stats) {
+  if (!transport||!delegate) return 0;
+  if (!delegate->cb_write||!delegate->cb_read) return 0;
+  struct wm_output *output=calloc(1,sizeof(struct wm_output));
+  if (!output) return 0;
+
+  output->transport=transport;
+  memcpy(&output->delegate,delegate,sizeof(struct wm_output_delegate));
+  output->stats=stats;
+
+  return output;
+}
+
+static void wm_output_op_cleanup(struct wm_output_op *op) {
+  if (op->buf) free(op->buf);
+  op->buf=0;
+  op->have=0;
+}
+
+void wm_output_del(struct wm_output *output) {
+  if (!output) return;
+  wm_output_reset(output);
+  free(output);
+}
+
+int wm_output_reset(struct wm_output *output) {
+  if (!output) return -1;
+  int i; for (i=0;i<output->opc;i++) {
+    wm_output_op_cleanup(output->opv+(output->opp+i)%WM_OUTPUT_OP_LIMIT);
+  }
+  memset(output->statev,0,sizeof(output->statev));
+  output->stream.rptc=0;
+  output->opp=0;
+  output->opc=0;
+  output->writes_inflight=0;
+  output->read_inflight=0;
+  output->stale_writes=0;
+  output->op_turn=0;
+  return 0;
+}
+
+/* State reports.
+ */
+
+int wm_output_set_state(struct wm_output *output,const void *src,int srcc) {
+  if (!output||!src) return -1;
+  if ((srcc<3)||(srcc>23)) return -1;
+  const uint8_t *SRC=src;
+  if (SRC[0]!=0xa2) return -1;
+  if ((SRC[1]<WM_OUTPUT_STATE_FIRST)||(SRC[1]>WM_OUTPUT_STATE_LAST)) return -1;
+  if ((SRC[1]==0x16)||(SRC[1]==0x17)||(SRC[1]==0x18)) return -1;
+  struct wm_output_state *state=output->statev+SRC[1]-WM_OUTPUT_STATE_FIRST;
+  if (state->rptc&&output->stats) output->stats->output_coalesced++;
+  memcpy(state->rpt,src,srcc);
+  state->rptc=srcc;
+  return 0;
+}
+
+/* Stream reports.
+ */
+
+int wm_output_stream(struct wm_output *output,const void *src,int srcc) {
+  if (!output||!src) return -1;
+  if ((srcc<3)||(srcc>23)) return -1;
+  const uint8_t *SRC=src;
+  if ((SRC[0]!=0xa2)||(SRC[1]!=0x18)) return -1;
+  if (output->stream.rptc&&output->stats) output->stats->speaker_dropped++;
+  memcpy(output->stream.rpt,src,srcc);
+  output->stream.rptc=srcc;
+  return 0;
+}
+
+int wm_output_set_rumble(struct wm_output *output,int rumble) {
+  if (!output) return -1;
+  rumble=rumble?1:0;
+  if (rumble==output->rumble) return 0;
+  output->rumble=rumble;
+
+  /* Anything else pending will carry the new rumble bit, no need for an extra report. */
+  if (output->stream.rptc) return 0;
+  int i; for (i=0;i<WM_OUTPUT_STATE_COUNT;i++) {
+    if (output->statev[i].rptc) return 0;
+  }
+  for (i=0;i<output->opc;i++) {
+    if (output->opv[(output->opp+i)%WM_OUTPUT_OP_LIMIT].state==WM_OP_STATE_QUEUED) return 0;
+  }
+
+  uint8_t rpt[3]={0xa2,0x10,0x00};
+  return wm_output_set_state(output,rpt,sizeof(rpt));
+}
+
+int wm_output_get_rumble(const struct wm_output *output) {
+  if (!output) return 0;
+  return output->rumble;
+}
+
+/* Memory operations.
+ */
+
+static struct wm_output_op *wm_output_op_new(struct wm_output *output) {
+  if (output->opc>=WM_OUTPUT_OP_LIMIT) {
+    wm_log_error("Output queue full, %d operations pending.",output->opc);
+    return 0;
+  }
+  struct wm_output_op *op=output->opv+(output->opp+output->opc)%WM_OUTPUT_OP_LIMIT;
+  memset(op,0,sizeof(struct wm_output_op));
+  output->opc++;
+  return op;
+}
+
+int wm_output_write(struct wm_output *output,int addr,const void *src,int srcc,int tag) {
+  if (!output) return -1;
+  if ((srcc<1)||(srcc>16)||!src) return -1;
+  struct wm_output_op *op=wm_output_op_new(output);
+  if (!op) return -1;
+  if ((op->rptc=wm_report_compose_write(op->rpt,sizeof(op->rpt),0,addr,src,srcc))<0) {
+    output->opc--;
+    return -1;
+  }
+  op->tag=tag;
+  op->addr=addr;
+  return 0;
+}
+
+int wm_output_read(struct wm_output *output,int addr,int size,int tag) {
+  if (!output) return -1;
+  if ((size<1)||(size>0xffff)) return -1;
+  // The reply only carries the low 16 bits of the address, so a read must not wrap around them.
+  if ((addr&0xffff)+size>0x10000) return -1;
+  struct wm_output_op *op=wm_output_op_new(output);
+  if (!op) return -1;
+  if ((op->rptc=wm_report_compose_read(op->rpt,sizeof(op->rpt),0,addr,size))<0) {
+    output->opc--;
+    return -1;
+  }
+  if (!(op->buf=calloc(1,size+((size+7)>>3)))) {
+    output->opc--;
+    return -1;
+  }
+  op->have=op->buf+size;
+  op->tag=tag;
+  op->addr=addr;
+  op->size=size;
+  return 0;
+}
+
+/* Remove an operation from the queue, preserving order of the rest.
+ */
+
+static void wm_output_op_remove(struct wm_output *output,struct wm_output_op *op) {
+  int p=(op-output->opv-output->opp+WM_OUTPUT_OP_LIMIT)%WM_OUTPUT_OP_LIMIT;
+  for (;p<output->opc-1;p++) {
+    output->opv[(output->opp+p)%WM_OUTPUT_OP_LIMIT]=output->opv[(output->opp+p+1)%WM_OUTPUT_OP_LIMIT];
+  }
+  output->opc--;
+}
+
+/* Find the oldest in-flight operation of a given type.
+ */
+
+static struct wm_output_op *wm_output_find_inflight(struct wm_output *output,uint8_t rptid) {
+  int i; for (i=0;i<output->opc;i++) {
+    struct wm_output_op *op=output->opv+(output->opp+i)%WM_OUTPUT_OP_LIMIT;
+    if (op->state!=WM_OP_STATE_INFLIGHT) continue;
+    if (op->rpt[1]!=rptid) continue;
+    return op;
+  }
+  return 0;
+}
+
+/* An in-flight operation failed. Requeue it, or give up and notify the delegate.
+ * Either way it's no longer in flight.
+ * When retrying, everything sent after it goes back in the queue too, so it all reaches the device in order again.
+ * Replies to those abandoned sends are still on the way; we discard that many ACKs before sending anything else.
+ */
+
+static void wm_output_op_requeue(struct wm_output *output,struct wm_output_op *op) {
+  if (op->rpt[1]==0x16) output->writes_inflight--;
+  else output->read_inflight=0;
+  op->received=0;
+  if (op->have) memset(op->have,0,(op->size+7)>>3);
+  op->state=WM_OP_STATE_QUEUED;
+}
+
+static int wm_output_op_fail(struct wm_output *output,struct wm_output_op *op,int err) {
+  if (op->retries<WM_OUTPUT_RETRY_LIMIT) {
+    wm_log_debug("Retrying 0x%02x at 0x%08x after error %d.",op->rpt[1],op->addr,err);
+    op->retries++;
+    wm_output_op_requeue(output,op);
+    int p=(op-output->opv-output->opp+WM_OUTPUT_OP_LIMIT)%WM_OUTPUT_OP_LIMIT;
+    for (p++;p<output->opc;p++) {
+      struct wm_output_op *later=output->opv+(output->opp+p)%WM_OUTPUT_OP_LIMIT;
+      if (later->state!=WM_OP_STATE_INFLIGHT) continue;
+      if (later->rpt[1]==0x16) output->stale_writes++;
+      wm_output_op_requeue(output,later);
+    }
+    if (output->stale_writes) output->stale_time=wm_now_us();
+    if (output->stats) output->stats->output_retries++;
+    return 0;
+  }
+
+  if (op->rpt[1]==0x16) output->writes_inflight--;
+  else output->read_inflight=0;
+
+  wm_log_warning("Giving up on 0x%02x at 0x%08x after error %d.",op->rpt[1],op->addr,err);
+  if (output->stats) output->stats->output_failures++;
+  int rptid=op->rpt[1],tag=op->tag,addr=op->addr;
+  wm_output_op_cleanup(op);
+  wm_output_op_remove(output,op);
+  if (rptid==0x16) return output->delegate.cb_write(output->delegate.userdata,tag,err);
+  return output->delegate.cb_read(output->delegate.userdata,tag,addr,err,0,0);
+}
+
+/* Receive replies.
+ * The device processes writes in order, so each ACK belongs to the oldest write in flight.
+ * We only allow one read in flight, and match it by the low 16 bits of its address.
+ */
+
+int wm_output_receive_ack(struct wm_output *output,uint8_t rptid,uint8_t result) {
+  if (!output) return -1;
+  if (rptid!=0x16) {
+    if (result) wm_log_warning("Device rejected output report 0x%02x, error %d.",rptid,result);
+    return 0;
+  }
+  if (output->stale_writes) {
+    output->stale_writes--;
+    wm_log_debug("Discarding ACK for an abandoned write, error %d.",result);
+    return 0;
+  }
+  struct wm_output_op *op=wm_output_find_inflight(output,0x16);
+  if (!op) {
+    wm_log_debug("Unexpected ACK for 0x16, error %d.",result);
+    return 0;
+  }
+  if (result) return wm_output_op_fail(output,op,result);
+  output->writes_inflight--;
+  int tag=op->tag;
+  wm_output_op_remove(output,op);
+  return output->delegate.cb_write(output->delegate.userdata,tag,0);
+}
+
+int wm_output_receive_read(struct wm_output *output,uint16_t addr,int err,const void *src,int srcc) {
+  if (!output) return -1;
+  struct wm_output_op *op=wm_output_find_inflight(output,0x17);
+  int offset=op?(addr-(op->addr&0xffff)):-1;
+  if ((offset<0)||(offset>=op->size)) {
+    wm_log_debug("Unexpected read reply for 0x%04x.",addr);
+    return 0;
+  }
+  if (err) return wm_output_op_fail(output,op,err);
+
+  /* Chunks normally arrive in order, but we only need them to fit.
+   * A repeated chunk overwrites the same bytes and doesn't count again.
+   */
+  if (srcc>op->size-offset) srcc=op->size-offset;
+  memcpy(op->buf+offset,src,srcc);
+  int i; for (i=offset;i<offset+srcc;i++) {
+    uint8_t bit=1<<(i&7);
+    if (op->have[i>>3]&bit) continue;
+    op->have[i>>3]|=bit;
+    op->received++;
+  }
+  op->sent_time=wm_now_us();
+  if (op->received<op->size) return 0;
+
+  output->read_inflight=0;
+  int tag=op->tag,opaddr=op->addr,size=op->size;
+  uint8_t *buf=op->buf;
+  op->buf=0;
+  op->have=0;
+  wm_output_op_remove(output,op);
+  err=output->delegate.cb_read(output->delegate.userdata,tag,opaddr,0,buf,size);
+  free(buf);
+  return err;
+}
+
+/* Send one report.
+ */
+
+static int wm_output_send(struct wm_output *output,uint8_t *rpt,int rptc) {
+  rpt[2]=(rpt[2]&~0x01)|output->rumble;
+  if (wm_transport_write(output->transport,rpt,rptc)!=rptc) {
+    wm_log_error("Failed to write %d-byte output report 0x%02x.",rptc,rpt[1]);
+    return -1;
+  }
+  if (output->stats) output->stats->output_sent++;
+  output->next_time=wm_now_us()+WM_OUTPUT_INTERVAL_US;
+  return 0;
+}
+
+/* Send the oldest queued operation if it's allowed to go.
+ * Returns 1 if something was sent, 0 if it must wait.
+ */
+
+static int wm_output_send_op(struct wm_output *output) {
+
+  if (output->stale_writes) {
+    if (wm_now_us()-output->stale_time<WM_OUTPUT_TIMEOUT_US) return 0;
+    output->stale_writes=0; // They're not coming.
+  }
+
+  int i; for (i=0;i<output->opc;i++) {
+    struct wm_output_op *op=output->opv+(output->opp+i)%WM_OUTPUT_OP_LIMIT;
+    // A retried op goes alone, so if it fails again nothing behind it has been applied yet.
+    if ((op->state==WM_OP_STATE_INFLIGHT)&&op->retries) return 0;
+    if (op->state!=WM_OP_STATE_QUEUED) continue;
+    // Order matters, so if the oldest queued op can't go yet, nothing behind it can either.
+    if (op->rpt[1]==0x16) {
+      if (output->writes_inflight>=WM_OUTPUT_WRITE_LIMIT) return 0;
+      output->writes_inflight++;
+    } else {
+      if (output->read_inflight) return 0;
+      output->read_inflight=1;
+    }
+    op->state=WM_OP_STATE_INFLIGHT;
+    op->sent_time=wm_now_us();
+    if (wm_output_send(output,op->rpt,op->rptc)<0) return -1;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Choose the next report to send: Speaker data first since it's on a deadline, then state reports,
+ * then the oldest queued operation if allowed.
+ * After each state report, a waiting operation gets the next turn, so steady LED or rumble changes can't starve it.
+ * Returns 1 if something was sent.
+ */
+
+static int wm_output_send_next(struct wm_output *output) {
+  int i,err;
+
+  if (output->stream.rptc) {
+    int rptc=output->stream.rptc;
+    output->stream.rptc=0;
+    if (wm_output_send(output,output->stream.rpt,rptc)<0) return -1;
+    return 1;
+  }
+
+  if (output->op_turn) {
+    output->op_turn=0;
+    if ((err=wm_output_send_op(output))) return err;
+  }
+
+  for (i=0;i<WM_OUTPUT_STATE_COUNT;i++) {
+    struct wm_output_state *state=output->statev+i;
+    if (!state->rptc) continue;
+    int rptc=state->rptc;
+    state->rptc=0;
+    if (wm_output_send(output,state->rpt,rptc)<0) return -1;
+    output->op_turn=1;
+    return 1;
+  }
+
+  return wm_output_send_op(output);
+}
+
+/* Update.
+ */
+
+int wm_output_update(struct wm_output *output) {
+  if (!output) return -1;
+  int64_t now=wm_now_us();
+
+  /* Operations that got no reply at all count as failed. */
+  int i; for (i=0;i<output->opc;i++) {
+    struct wm_output_op *op=output->opv+(output->opp+i)%WM_OUTPUT_OP_LIMIT;
+    if (op->state!=WM_OP_STATE_INFLIGHT) continue;
+    if (now-op->sent_time<WM_OUTPUT_TIMEOUT_US) continue;
+    if (wm_output_op_fail(output,op,-1)<0) return -1;
+    break; // Queue may have changed, check the rest next time.
+  }
+
+  if (now<output->next_time) return 0;
+  if (wm_output_send_next(output)<0) return -1;
+  return 0;
+}
+
+/* Time until next update.
+ */
+
+int wm_output_get_timeout(const struct wm_output *output) {
+  if (!output) return -1;
+  int64_t now=wm_now_us();
+  int64_t next=-1;
+  int i;
+
+  if (output->stream.rptc) next=output->next_time;
+  for (i=0;i<WM_OUTPUT_STATE_COUNT;i++) {
+    if (output->statev[i].rptc) { next=output->next_time; break; }
+  }
+  int queued=0;
+  for (i=0;i<output->opc;i++) {
+    const struct wm_output_op *op=output->opv+(output->opp+i)%WM_OUTPUT_OP_LIMIT;
+    int64_t t;
+    if (op->state==WM_OP_STATE_INFLIGHT) {
+      t=op->sent_time+WM_OUTPUT_TIMEOUT_US;
+      if (op->retries) queued++; // Holds everything behind it.
+    } else if (queued++) {
+      continue;
+    } else if (output->stale_writes) {
+      t=output->stale_time+WM_OUTPUT_TIMEOUT_US;
+    } else if ((op->rpt[1]==0x16)?(output->writes_inflight>=WM_OUTPUT_WRITE_LIMIT):output->read_inflight) {
+      continue; // Blocked until a reply or timeout.
+    } else {
+      t=output->next_time;
+    }
+    if ((next<0)||(t<next)) next=t;
+  }
+
+  if (next<0) return -1;
+  if (next<=now) return 0;
+  return (next-now+999)/1000;
+}
@@ -0,0 +1,80 @@
+/* wm_output.h
+ * Scheduler for output reports. Every report we send to the device goes through here.
+ *
+ * Two kinds of output:
+ *  - State reports (LEDs, report mode, rumble, status request...) are coalesced by report ID.
+ *    If you set the LEDs twice before the first goes out, only the second is sent.
+ *  - Speaker data (0x18) has its own slot, and jumps the queue.
+ *  - Memory operations (0x16 write, 0x17 read) are queued in order, tracked until the device replies,
+ *    and retried if it reports an error or doesn't reply at all.
+ *    A retry also pulls back everything sent after it, and goes out alone, so the device still applies them in order.
+ *    Each one carries a caller-defined tag, and its final outcome is reported once via the delegate.
+ *    Reads may be any size; the device answers in 16-byte chunks, which we reassemble.
+ *    Any number of reads may be queued, but the device only works on one at a time.
+ *
+ * Reports are paced, at most one per WM_OUTPUT_INTERVAL_US, so heavy output can't flood the device.
+ * The rumble bit is carried on every output report, so changing it usually costs nothing extra.
+ */
+
+#ifndef WM_OUTPUT_H
+#define WM_OUTPUT_H
+
+struct wm_output;
+struct wm_transport;
+struct wm_stats;
+
+#define WM_OUTPUT_INTERVAL_US    1000
+#define WM_OUTPUT_TIMEOUT_US   500000
+#define WM_OUTPUT_RETRY_LIMIT       3
+#define WM_OUTPUT_WRITE_LIMIT       4 /* How many unacknowledged writes may be in flight. */
+
+struct wm_output_delegate {
+  int (*cb_write)(void *userdata,int tag,int err);
+  int (*cb_read)(void *userdata,int tag,int addr,int err,const void *src,int srcc);
+  void *userdata;
+};
+
+/* (transport) and (stats) are WEAK, and (stats) is optional.
+ */
+struct wm_output *wm_output_new(struct wm_transport *transport,const struct wm_output_delegate *delegate,struct wm_stats *stats);
+void wm_output_del(struct wm_output *output);
+
+/* Drop everything pending, eg after losing the connection. Delegate is not notified.
+ */
+int wm_output_reset(struct wm_output *output);
+
+/* Queue a state report, replacing any pending report with the same ID.
+ * (src) is a complete report as composed by wm_report, starting with 0xa2.
+ */
+int wm_output_set_state(struct wm_output *output,const void *src,int srcc);
+
+/* Queue speaker data (0x18), which goes out ahead of everything else.
+ * There's one slot: A packet still waiting when the next arrives is replaced, and counted as dropped.
+ * At any sane sample rate that doesn't happen, we send far faster than the speaker consumes.
+ */
+int wm_output_stream(struct wm_output *output,const void *src,int srcc);
+
+int wm_output_set_rumble(struct wm_output *output,int rumble);
+int wm_output_get_rumble(const struct wm_output *output);
+
+/* Queue a tracked memory operation. (addr) is the full 32-bit address, including address space.
+ * Writes are limited to 16 bytes. Reads may be up to 65535 bytes.
+ * A read's callback gets the whole buffer at once, or an error and no data.
+ */
+int wm_output_write(struct wm_output *output,int addr,const void *src,int srcc,int tag);
+int wm_output_read(struct wm_output *output,int addr,int size,int tag);
+
+/* Feed replies from the report layer here.
+ */
+int wm_output_receive_ack(struct wm_output *output,uint8_t rptid,uint8_t result);
+int wm_output_receive_read(struct wm_output *output,uint16_t addr,int err,const void *src,int srcc);
+
+/* Send whatever is due, and check for timeouts.
+ */
+int wm_output_update(struct wm_output *output);
+
+/* Milliseconds until wm_output_update() has something to do, or <0 if idle.
+ */
+int wm_output_get_timeout(const struct wm_output *output);
+
+#endif
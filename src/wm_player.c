@@ -0,0 +1,87 @@
+#include "wiimote.h"
+#include "wm_player.h"
+#include "wm_fs.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+/* Object definition.
+ */
+
+struct wm_player {
+  char *dir;
+  int fd; // Lock file for (slot), or -1.
+  int slot;
+};
+
+/* Object lifecycle.
+ */
+
+struct wm_player *wm_player_new(const char *dir) {
+  struct wm_player *player=calloc(1,sizeof(struct wm_player));
+  if (!player) return 0;
+
+  player->fd=-1;
+
+  if (dir&&dir[0]) {
+    int dirc=0; while (dir[dirc]) dirc++;
+    if (!(player->dir=malloc(dirc+1))) {
+      free(player);
+      return 0;
+    }
+    memcpy(player->dir,dir,dirc+1);
+  }
+
+  return player;
+}
+
+void wm_player_del(struct wm_player *player) {
+  if (!player) return;
+  if (player->fd>=0) close(player->fd);
+  if (player->dir) free(player->dir);
+  free(player);
+}
+
+int wm_player_get(const struct wm_player *player) {
+  if (!player) return 0;
+  return player->slot;
+}
+
+/* Claim.
+ */
+
+int wm_player_claim(struct wm_player *player) {
+  if (!player) return 0;
+  if (player->slot) return player->slot;
+  if (!player->dir) return 0;
+  if (wm_dir_require(player->dir)<0) {
+    wm_log_warning("%s: Failed to create directory: %m",player->dir);
+    return 0;
+  }
+  char path[1024];
+  int slot; for (slot=1;slot<=WM_PLAYER_LIMIT;slot++) {
+    int pathc=snprintf(path,sizeof(path),"%s/player%d",player->dir,slot);
+    if ((pathc<1)||(pathc>=sizeof(path))) return 0;
+    int fd=open(path,O_RDWR|O_CREAT|O_CLOEXEC,0644);
+    if (fd<0) {
+      wm_log_warning("%s: Failed to open: %m",path);
+      return 0;
+    }
+    if (flock(fd,LOCK_EX|LOCK_NB)<0) {
+      close(fd);
+      continue;
+    }
+    player->fd=fd;
+    player->slot=slot;
+    return slot;
+  }
+  return 0;
+}
+
+int wm_player_release(struct wm_player *player) {
+  if (!player) return -1;
+  if (player->fd>=0) close(player->fd);
+  player->fd=-1;
+  player->slot=0;
+  return 0;
+}
@@ -0,0 +1,27 @@
+/* wm_player.h
+ * Player slots, shared among all wiimote processes on this host.
+ * Each slot is a lock file "player1".."player4" in a runtime directory (config "player-dir").
+ * We hold an flock on the one we claim, so a slot frees itself when its process exits, however it exits.
+ */
+
+#ifndef WM_PLAYER_H
+#define WM_PLAYER_H
+
+#define WM_PLAYER_LIMIT 4
+
+struct wm_player;
+
+/* (dir) may be null or empty, in which case we never claim a slot.
+ */
+struct wm_player *wm_player_new(const char *dir);
+void wm_player_del(struct wm_player *player);
+
+/* Take the lowest free slot, or keep the one we have.
+ * Returns 1..WM_PLAYER_LIMIT, or 0 if none is available.
+ */
+int wm_player_claim(struct wm_player *player);
+int wm_player_release(struct wm_player *player);
+
+int wm_player_get(const struct wm_player *player);
+
+#endif
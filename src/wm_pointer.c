@@ -0,0 +1,217 @@
+#include "wiimote.h"
+#include "wm_pointer.h"
+#include "wm_report.h"
+
+/* Dots closer than this horizontally (after roll) can't be the sensor bar. */
+#define WM_POINTER_MIN_SEPARATION 16
+
+/* Fixed-point unit for the roll rotation. */
+#define WM_POINTER_ONE (1<<14)
+
+/* Object definition.
+ * All positions are in the roll-compensated frame, relative to the camera center.
+ */
+
+struct wm_pointer {
+  int cos,sin; // WM_POINTER_ONE, rotation that undoes the remote's roll.
+  int paira,pairb; // Indices of the sensor bar in the last dot set, -1 if unknown.
+  int havepair; // Nonzero if (lx,ly,rx,ry) are meaningful.
+  int lx,ly,rx,ry; // Last known left and right dots of the sensor bar.
+  int valid;
+  int x,y; // Output, 0..WM_POINTER_X_MAX, 0..WM_POINTER_Y_MAX.
+};
+
+/* Object lifecycle.
+ */
+
+struct wm_pointer *wm_pointer_new() {
+  struct wm_pointer *pointer=calloc(1,sizeof(struct wm_pointer));
+  if (!pointer) return 0;
+  wm_pointer_reset(pointer);
+  return pointer;
+}
+
+void wm_pointer_del(struct wm_pointer *pointer) {
+  if (!pointer) return;
+  free(pointer);
+}
+
+int wm_pointer_reset(struct wm_pointer *pointer) {
+  if (!pointer) return -1;
+  pointer->cos=WM_POINTER_ONE;
+  pointer->sin=0;
+  pointer->paira=pointer->pairb=-1;
+  pointer->havepair=0;
+  pointer->valid=0;
+  pointer->x=WM_POINTER_X_MAX>>1;
+  pointer->y=WM_POINTER_Y_MAX>>1;
+  return 0;
+}
+
+/* Integer square root, fixed iteration count.
+ */
+
+static int wm_pointer_isqrt(uint32_t n) {
+  uint32_t root=0,bit=1u<<30;
+  int i; for (i=0;i<16;i++) {
+    if (n>=root+bit) {
+      n-=root+bit;
+      root=(root>>1)+bit;
+    } else {
+      root>>=1;
+    }
+    bit>>=2;
+  }
+  return root;
+}
+
+/* Roll from gravity.
+ * Lying flat, gravity is all on Z. Rolling the remote moves it onto X, and the camera image turns the same amount.
+ * Pointing straight up or down, X and Z carry no roll information, so keep what we had.
+ */
+
+int wm_pointer_set_accel(struct wm_pointer *pointer,int x,int y,int z) {
+  if (!pointer) return -1;
+  int r=wm_pointer_isqrt(x*x+z*z);
+  if (r<(WM_ACCEL_1G>>1)) return 0;
+  pointer->cos=(z*WM_POINTER_ONE)/r;
+  pointer->sin=(x*WM_POINTER_ONE)/r;
+  return 0;
+}
+
+/* Commit a new sensor bar midpoint.
+ * A camera sees the scene mirrored on both axes relative to where it points, so flip both.
+ */
+
+static int wm_pointer_commit(struct wm_pointer *pointer,int midx,int midy) {
+  int x=(WM_POINTER_X_MAX>>1)-midx;
+  int y=(WM_POINTER_Y_MAX>>1)-midy;
+  if (x<0) x=0; else if (x>WM_POINTER_X_MAX) x=WM_POINTER_X_MAX;
+  if (y<0) y=0; else if (y>WM_POINTER_Y_MAX) y=WM_POINTER_Y_MAX;
+  if (pointer->valid&&(x==pointer->x)&&(y==pointer->y)) return 0;
+  pointer->valid=1;
+  pointer->x=x;
+  pointer->y=y;
+  return 1;
+}
+
+/* Record a pair, ordered left to right.
+ */
+
+static void wm_pointer_set_pair(struct wm_pointer *pointer,int a,int b,const int *px,const int *py) {
+  if (px[b]<px[a]) { int tmp=a; a=b; b=tmp; }
+  pointer->paira=a;
+  pointer->pairb=b;
+  pointer->havepair=1;
+  pointer->lx=px[a];
+  pointer->ly=py[a];
+  pointer->rx=px[b];
+  pointer->ry=py[b];
+}
+
+/* Which pair of visible dots looks most like a sensor bar?
+ * Roll-compensated, the bar is horizontal, so we want the flattest pair.
+ * Returns zero if no pair qualifies.
+ */
+
+static int wm_pointer_choose_pair(int *a,int *b,const struct wm_pointer *pointer,const int *px,const int *py,int visible) {
+
+  /* Stick with the last pair while it's still plausible, so a stray reflection can't steal the cursor. */
+  if ((pointer->paira>=0)&&(visible&(1<<pointer->paira))&&(visible&(1<<pointer->pairb))) {
+    int dx=px[pointer->pairb]-px[pointer->paira];
+    int dy=py[pointer->pairb]-py[pointer->paira];
+    if (dx<0) dx=-dx;
+    if (dy<0) dy=-dy;
+    if ((dx>=WM_POINTER_MIN_SEPARATION)&&(dy<dx)) {
+      *a=pointer->paira;
+      *b=pointer->pairb;
+      return 1;
+    }
+  }
+
+  int bestscore=INT_MAX,i,j;
+  for (i=0;i<WM_IR_DOT_COUNT;i++) {
+    if (!(visible&(1<<i))) continue;
+    for (j=i+1;j<WM_IR_DOT_COUNT;j++) {
+      if (!(visible&(1<<j))) continue;
+      int dx=px[j]-px[i];
+      int dy=py[j]-py[i];
+      if (dx<0) dx=-dx;
+      if (dy<0) dy=-dy;
+      if (dx<WM_POINTER_MIN_SEPARATION) continue;
+      int score=(dy<<8)/dx;
+      if (score<bestscore) {
+        bestscore=score;
+        *a=i;
+        *b=j;
+      }
+    }
+  }
+  return (bestscore<INT_MAX)?1:0;
+}
+
+/* Update.
+ */
+
+int wm_pointer_update(struct wm_pointer *pointer,const struct wm_ir_dot *dotv) {
+  if (!pointer||!dotv) return -1;
+
+  /* Roll-compensate every visible dot around the camera center. */
+  int px[WM_IR_DOT_COUNT],py[WM_IR_DOT_COUNT];
+  int visible=0,visiblec=0,last=-1,i;
+  for (i=0;i<WM_IR_DOT_COUNT;i++) {
+    if (dotv[i].x<0) continue;
+    int dx=dotv[i].x-(WM_IR_X_MAX>>1);
+    int dy=dotv[i].y-(WM_IR_Y_MAX>>1);
+    px[i]=(dx*pointer->cos-dy*pointer->sin)>>14;
+    py[i]=(dx*pointer->sin+dy*pointer->cos)>>14;
+    visible|=1<<i;
+    visiblec++;
+    last=i;
+  }
+
+  /* Two or more dots: find the bar and take its midpoint. */
+  if (visiblec>=2) {
+    int a,b;
+    if (wm_pointer_choose_pair(&a,&b,pointer,px,py,visible)) {
+      wm_pointer_set_pair(pointer,a,b,px,py);
+      return wm_pointer_commit(pointer,(pointer->lx+pointer->rx)>>1,(pointer->ly+pointer->ry)>>1);
+    }
+    return 0;
+  }
+
+  /* One dot: if we know the bar's extent, decide which end this is and project the other.
+   * Only with one dot visible, so (last) is it.
+   */
+  if ((visiblec==1)&&pointer->havepair) {
+    int sepx=pointer->rx-pointer->lx;
+    int sepy=pointer->ry-pointer->ly;
+    int dl=abs(px[last]-pointer->lx)+abs(py[last]-pointer->ly);
+    int dr=abs(px[last]-pointer->rx)+abs(py[last]-pointer->ry);
+    if (dl<=dr) {
+      pointer->lx=px[last];
+      pointer->ly=py[last];
+      pointer->rx=px[last]+sepx;
+      pointer->ry=py[last]+sepy;
+    } else {
+      pointer->rx=px[last];
+      pointer->ry=py[last];
+      pointer->lx=px[last]-sepx;
+      pointer->ly=py[last]-sepy;
+    }
+    pointer->paira=pointer->pairb=-1;
+    return wm_pointer_commit(pointer,(pointer->lx+pointer->rx)>>1,(pointer->ly+pointer->ry)>>1);
+  }
+
+  return 0;
+}
+
+/* Trivial accessors.
+ */
+
+int wm_pointer_get(int *x,int *y,const struct wm_pointer *pointer) {
+  if (!pointer) return 0;
+  if (x) *x=pointer->x;
+  if (y) *y=pointer->y;
+  return pointer->valid;
+}
@@ -0,0 +1,41 @@
+/* wm_pointer.h
+ * Turns IR dots and accelerometer into an absolute cursor position.
+ * We identify the two dots of the sensor bar, undo the remote's roll using gravity, and report their midpoint.
+ * Every update is constant time and there is no allocation after wm_pointer_new().
+ */
+
+#ifndef WM_POINTER_H
+#define WM_POINTER_H
+
+struct wm_ir_dot;
+
+/* Output range, same as the camera's.
+ */
+#define WM_POINTER_X_MAX 1023
+#define WM_POINTER_Y_MAX 767
+
+struct wm_pointer;
+
+struct wm_pointer *wm_pointer_new();
+void wm_pointer_del(struct wm_pointer *pointer);
+
+/* Forget everything we've learned about the sensor bar.
+ */
+int wm_pointer_reset(struct wm_pointer *pointer);
+
+/* Calibrated accelerometer, as reported by wm_report (WM_ACCEL_1G).
+ * The remote's roll is taken from X and Z. Nothing happens until the next wm_pointer_update().
+ */
+int wm_pointer_set_accel(struct wm_pointer *pointer,int x,int y,int z);
+
+/* Digest a fresh set of WM_IR_DOT_COUNT dots.
+ * Returns >0 if the cursor moved, 0 if not, or <0 for errors.
+ * If the sensor bar goes out of view, the cursor holds its last position.
+ */
+int wm_pointer_update(struct wm_pointer *pointer,const struct wm_ir_dot *dotv);
+
+/* Returns nonzero if we've ever had a position.
+ */
+int wm_pointer_get(int *x,int *y,const struct wm_pointer *pointer);
+
+#endif
@@ -0,0 +1,141 @@
+#include "wiimote.h"
+#include "wm_reader.h"
+#include "wm_ring.h"
+#include "wm_transport.h"
+#include "wm_stats.h"
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#define WM_READER_STACK_SIZE (128*1024) /* We need very little, and with mlockall every byte of it stays resident. */
+
+/* Object definition.
+ */
+
+struct wm_reader {
+  struct wm_transport *transport; // WEAK
+  struct wm_stats *stats; // WEAK, consumer only.
+  struct wm_ring *ring;
+  int eventfd;
+  pthread_t thread;
+  int running; // Thread was started and not joined yet.
+  int closed; // Set by the thread after its last push.
+};
+
+/* Thread.
+ */
+
+static void wm_reader_wake(struct wm_reader *reader) {
+  uint64_t one=1;
+  write(reader->eventfd,&one,sizeof(one));
+}
+
+static void *wm_reader_main(void *arg) {
+  struct wm_reader *reader=arg;
+  uint8_t buf[WM_RING_PACKET_SIZE];
+  int busy=wm_transport_get_busy_poll(reader->transport);
+  while (1) {
+    if (busy&&(wm_transport_poll(reader->transport,-1)<0)) break;
+    int bufc=wm_transport_read(buf,sizeof(buf),reader->transport);
+    if (bufc<=0) {
+      if ((bufc<0)&&(errno==EINTR)) continue;
+      break;
+    }
+    if (wm_ring_push(reader->ring,buf,bufc,wm_now_us())==2) wm_reader_wake(reader);
+  }
+  __atomic_store_n(&reader->closed,1,__ATOMIC_RELEASE);
+  wm_reader_wake(reader);
+  return 0;
+}
+
+/* Object lifecycle.
+ */
+
+struct wm_reader *wm_reader_new(struct wm_transport *transport,struct wm_stats *stats) {
+  if (!transport) return 0;
+  struct wm_reader *reader=calloc(1,sizeof(struct wm_reader));
+  if (!reader) return 0;
+
+  reader->transport=transport;
+  reader->stats=stats;
+  reader->eventfd=-1;
+
+  if (!(reader->ring=wm_ring_new())) {
+    wm_reader_del(reader);
+    return 0;
+  }
+  if ((reader->eventfd=eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC))<0) {
+    wm_log_error("eventfd: %m");
+    wm_reader_del(reader);
+    return 0;
+  }
+
+  /* Signals belong to the main thread, the reader must never take one. It inherits our mask. */
+  sigset_t all,prev;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK,&all,&prev);
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr,WM_READER_STACK_SIZE);
+  int err=pthread_create(&reader->thread,&attr,wm_reader_main,reader);
+  pthread_attr_destroy(&attr);
+  pthread_sigmask(SIG_SETMASK,&prev,0);
+  if (err) {
+    wm_log_error("pthread_create: %s",strerror(err));
+    wm_reader_del(reader);
+    return 0;
+  }
+  reader->running=1;
+
+  return reader;
+}
+
+void wm_reader_del(struct wm_reader *reader) {
+  if (!reader) return;
+  if (reader->running) {
+    wm_transport_interrupt(reader->transport);
+    pthread_join(reader->thread,0);
+  }
+  if (reader->eventfd>=0) close(reader->eventfd);
+  wm_ring_del(reader->ring);
+  free(reader);
+}
+
+int wm_reader_get_fd(const struct wm_reader *reader) {
+  if (!reader) return -1;
+  return reader->eventfd;
+}
+
+/* Read.
+ */
+
+int wm_reader_read(void *dst,int dsta,int64_t *time,struct wm_reader *reader) {
+  if (!dst||!reader) return -1;
+
+  /* Only when the ring looks empty do we clear the eventfd, then look again in case a push slipped in between.
+   * So a burst costs one read() here, and one write() on the other side.
+   */
+  struct wm_ring_packet packet;
+  int occupancy=wm_ring_count(reader->ring);
+  if (!wm_ring_pop(&packet,reader->ring)) {
+    uint64_t count;
+    read(reader->eventfd,&count,sizeof(count));
+    int closed=__atomic_load_n(&reader->closed,__ATOMIC_ACQUIRE);
+    if (!wm_ring_pop(&packet,reader->ring)) return closed?-1:0;
+  }
+
+  if (reader->stats) {
+    struct wm_stats *stats=reader->stats;
+    if (occupancy>stats->ring_peak) stats->ring_peak=occupancy;
+    stats->ring_overflows=wm_ring_get_overflows(reader->ring);
+    wm_transport_get_busy_poll_stats(&stats->busy_poll_hits,&stats->busy_poll_misses,reader->transport);
+    wm_stats_timer_add(&stats->ring_latency,wm_now_us()-packet.time);
+  }
+
+  if (time) *time=packet.time;
+  if (packet.c>dsta) return -1;
+  memcpy(dst,packet.v,packet.c);
+  return packet.c;
+}
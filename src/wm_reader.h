@@ -0,0 +1,35 @@
+/* wm_reader.h
+ * Reads the transport on its own thread, so slow work downstream (decode, uinput) never delays the next read.
+ * Reports are timestamped as they arrive and passed through a wm_ring to whoever calls wm_reader_read().
+ * If the transport has busy polling on, this thread is where the spinning happens. Pin it to a core of its own.
+ * We only read. Writing to the transport stays on the caller's thread, which is safe: they're separate sockets.
+ */
+
+#ifndef WM_READER_H
+#define WM_READER_H
+
+struct wm_reader;
+struct wm_transport;
+struct wm_stats;
+
+/* Starts the thread immediately. (transport) must be connected.
+ * (transport) and (stats) are WEAK, and (stats) is optional. Stats are only touched from the consuming thread.
+ */
+struct wm_reader *wm_reader_new(struct wm_transport *transport,struct wm_stats *stats);
+
+/* Interrupts the transport to stop the thread, and waits for it.
+ * The transport stays open but unusable, so disconnect it next.
+ */
+void wm_reader_del(struct wm_reader *reader);
+
+/* Polls readable when reports arrive on an empty queue, or the connection is lost.
+ * So after it polls readable, you must wm_reader_read() until there's nothing left, before polling again.
+ */
+int wm_reader_get_fd(const struct wm_reader *reader);
+
+/* Next report, with the time it was read (us, optional).
+ * Returns its length, 0 if there's none waiting, or <0 if the connection is lost and there will be no more.
+ */
+int wm_reader_read(void *dst,int dsta,int64_t *time,struct wm_reader *reader);
+
+#endif
@@ -2,10 +2,22 @@
 #include "wm_report.h"
 #include "wm_text.h"
 #include "wm_enums.h"
+#include "wm_stats.h"
+#include "wm_fusion.h"
+#include "wm_extdesc.h"
+#include "wm_config.h"
 
 /* Object definition.
  */
 
+/* Accelerometer calibration, per axis.
+ * Output is ((raw-zero)*mul)>>16, so (mul) is (WM_ACCEL_1G<<16)/(one_g-zero).
+ */
+struct wm_report_accel_cal {
+  int zero[3];
+  int mul[3];
+};
+
 struct wm_report_nunchuk {
   int sx,sy; // stick
   int ax,ay,az; // accelerometer
@@ -18,6 +30,39 @@ struct wm_report_classic {
   uint16_t buttons;
 };
 
+struct wm_report_balance {
+  int sensor[4]; // TR,BR,TL,BL
+  int total;
+  int copx,copy;
+};
+
+struct wm_report_motionplus {
+  int yaw,roll,pitch; // WM_GYRO_MIN..WM_GYRO_MAX
+  uint8_t extpresent; // Something plugged into the MotionPlus's own port.
+};
+
+/* Extension calibration is applied by table lookup: One entry per possible raw value, already centered, scaled and inverted.
+ * Tables are rebuilt whenever the calibration changes, never on the hot path.
+ */
+struct wm_report_nunchuk_cal {
+  int8_t sx[256],sy[256];
+  struct wm_report_accel_cal accel;
+};
+
+struct wm_report_classic_cal {
+  int8_t lx[64],ly[64],rx[32],ry[32],la[32],ra[32];
+};
+
+/* Balance Board sensors are calibrated at 0, 17, and 34 kg. We interpolate linearly within each half.
+ * Output is (wbase+(((raw-base)*mul)>>16)), with the half picked by comparing against (split).
+ */
+struct wm_report_balance_cal {
+  int valid;
+  int split[4];
+  int base[4][2];
+  int mul[4][2];
+};
+
 struct wm_report {
 
   struct wm_report_delegate delegate;
@@ -26,23 +71,133 @@ struct wm_report {
   uint8_t rptid;
   uint8_t rumble;
   uint8_t continuous;
-  uint8_t rpt3e[23];
   uint8_t pvrpt[23];
+  struct wm_ir_dot ir[WM_IR_DOT_COUNT];
   int pvrptc;
+  struct wm_stats *stats; // WEAK, optional.
+
+  /* First half of a 3e/3f pair. */
+  int have3e;
+  uint8_t accel3e; // X high bits.
+  uint8_t z3e; // Z bits 4..7.
+  struct wm_ir_dot ir_pending[WM_IR_DOT_COUNT];
 
   /* Core features. */
   uint16_t buttons;
   int accelx,accely,accelz;
+  struct wm_report_accel_cal accel_cal;
   uint8_t status;
   uint8_t battery;
 
   /* Extension. */
   int extid;
+  int ext_encrypted; // Initialized the old way; extension bytes need wm_report_decrypt().
   struct wm_report_nunchuk nunchuk;
   struct wm_report_classic classic;
+  struct wm_report_nunchuk_cal nunchuk_cal;
+  struct wm_report_classic_cal classic_cal;
+  struct wm_report_balance balance;
+  struct wm_report_balance_cal balance_cal;
+  const struct wm_extdesc *ext_desc; // Generic decoder, for extensions without a hand-written one.
+  int ext_fieldv[WM_EXTDESC_FIELD_LIMIT]; // Last value of each (ext_desc) field.
+
+  /* MotionPlus, independent of (extid), which is its passthrough extension if any. */
+  int motionplus;
+  struct wm_report_motionplus mp;
+  int mp_zero[3]; // yaw,roll,pitch
+
+  /* Orientation, optional. */
+  int orientation;
+  int fusion_pending; // Fresh accelerometer this report.
+  int64_t fusion_time;
+  struct wm_fusion fusion;
+  int roll,pitch,yaw; // Last emitted, centidegrees.
   
 };
 
+/* Accelerometer calibration.
+ * Until we hear from the device, assume a typical remote: zero at 512 and 1 g = 100 counts.
+ */
+
+static void wm_report_accel_cal_default(struct wm_report_accel_cal *cal) {
+  int i; for (i=0;i<3;i++) {
+    cal->zero[i]=512;
+    cal->mul[i]=(WM_ACCEL_1G<<16)/100;
+  }
+}
+
+static int wm_report_accel_cal_set(struct wm_report_accel_cal *cal,const int *zero,const int *one) {
+  int mul[3],i;
+  for (i=0;i<3;i++) {
+    if (one[i]-zero[i]<16) return -1; // Implausible, don't divide by garbage.
+    mul[i]=(WM_ACCEL_1G<<16)/(one[i]-zero[i]);
+  }
+  memcpy(cal->zero,zero,sizeof(cal->zero));
+  memcpy(cal->mul,mul,sizeof(cal->mul));
+  return 0;
+}
+
+static inline int wm_report_accel_cal_apply(const struct wm_report_accel_cal *cal,int axis,int raw) {
+  int v=((raw-cal->zero[axis])*cal->mul[axis])>>16;
+  if (v<WM_ACCEL_MIN) return WM_ACCEL_MIN;
+  if (v>WM_ACCEL_MAX) return WM_ACCEL_MAX;
+  return v;
+}
+
+/* Build a lookup table for one analogue axis.
+ * Raw values within (deadzone) of (center) read as zero, so an idle stick doesn't generate events.
+ * From there to (lo) and (hi), output ramps linearly out to (-limit) and (limit), and clamps beyond.
+ * (invert) to make up-positive sticks up-negative.
+ */
+
+static void wm_report_build_axis_table(int8_t *dst,int rawc,int lo,int center,int hi,int deadzone,int limit,int invert) {
+  int negrange=center-lo-deadzone; if (negrange<1) negrange=1;
+  int posrange=hi-center-deadzone; if (posrange<1) posrange=1;
+  int raw=0; for (;raw<rawc;raw++) {
+    int d=raw-center,v;
+    if (d<-deadzone) {
+      v=((d+deadzone)*limit)/negrange;
+      if (v<-limit) v=-limit;
+    } else if (d>deadzone) {
+      v=((d-deadzone)*limit)/posrange;
+      if (v>limit) v=limit;
+    } else {
+      v=0;
+    }
+    dst[raw]=invert?-v:v;
+  }
+}
+
+/* Build a lookup table for an analogue trigger: (lo) reads as zero and (hi) as (limit).
+ */
+
+static void wm_report_build_trigger_table(int8_t *dst,int rawc,int lo,int hi,int limit) {
+  int range=hi-lo; if (range<1) range=1;
+  int raw=0; for (;raw<rawc;raw++) {
+    int v=((raw-lo)*limit)/range;
+    if (v<0) v=0; else if (v>limit) v=limit;
+    dst[raw]=v;
+  }
+}
+
+/* Default extension calibration, typical for first-party controllers.
+ */
+
+static void wm_report_nunchuk_cal_default(struct wm_report_nunchuk_cal *cal) {
+  wm_report_build_axis_table(cal->sx,256,32,128,224,2,127,0);
+  wm_report_build_axis_table(cal->sy,256,32,128,224,2,127,1);
+  wm_report_accel_cal_default(&cal->accel);
+}
+
+static void wm_report_classic_cal_default(struct wm_report_classic_cal *cal) {
+  wm_report_build_axis_table(cal->lx,64,4,32,60,1,31,0);
+  wm_report_build_axis_table(cal->ly,64,4,32,60,1,31,1);
+  wm_report_build_axis_table(cal->rx,32,2,16,29,0,15,0);
+  wm_report_build_axis_table(cal->ry,32,2,16,29,0,15,1);
+  wm_report_build_trigger_table(cal->la,32,2,31,31);
+  wm_report_build_trigger_table(cal->ra,32,2,31,31);
+}
+
 /* Object lifecycle.
  */
  
@@ -57,6 +212,12 @@ struct wm_report *wm_report_new(const struct wm_report_delegate *delegate) {
 
   memcpy(&report->delegate,delegate,sizeof(struct wm_report_delegate));
   report->rptid=0x30;
+  wm_report_accel_cal_default(&report->accel_cal);
+  int i; for (i=0;i<WM_IR_DOT_COUNT;i++) report->ir[i].x=report->ir[i].y=-1;
+  wm_report_nunchuk_cal_default(&report->nunchuk_cal);
+  wm_report_classic_cal_default(&report->classic_cal);
+  for (i=0;i<3;i++) report->mp_zero[i]=WM_GYRO_RAW_ZERO;
+  wm_fusion_init(&report->fusion);
 
   return report;
 }
@@ -72,8 +233,8 @@ void wm_report_del(struct wm_report *report) {
  
 int wm_report_configure(struct wm_report *report,const struct wm_config *config) {
   if (!report||!config) return -1;
-  //TODO
   wm_log_trace("%s",__func__);
+  report->orientation=wm_config_get_orientation(config);
   return 0;
 }
 
@@ -122,17 +283,18 @@ static int wm_report_deliver_status(struct wm_report *report,const uint8_t *src)
 
 /* Receive read-memory result.
  *   0000   1 (f0)=(size-1), (0f)=error
- *   0001   2 addr
+ *   0001   2 addr, low 16 bits, big-endian
  *   0003  16 data
+ * Larger reads arrive as a series of these, reassembled by wm_output.
  */
 
 static int wm_report_deliver_rdmem(struct wm_report *report,const uint8_t *src,int srcc) {
   int len=(src[0]>>4)+1;
   int err=(src[0]&0x0f);
-  int addr=(src[1]<<8)|src[2];//TODO byte order?
+  int addr=(src[1]<<8)|src[2];
   if (srcc<3+len) {
     wm_log_error("Read result short %d<%d",srcc,3+len);
-    //return -1;
+    len=srcc-3;
   }
   const uint8_t *payload=src+3;
   if (report->delegate.cb_read(report->delegate.userdata,addr,err,payload,len)<0) return -1;
@@ -181,166 +343,448 @@ static int wm_report_deliver_core_buttons(struct wm_report *report,const uint8_t
  *   0004  Z Z Z Z  Z Z Z Z
  *   0005
  * X is 10 bits; Y and Z are 9.
- * We report all three as 10 bits for consistency, with a range of (-512..511).
+ * We report all three calibrated, see WM_ACCEL_1G.
  */
 
-static int wm_report_deliver_accel(struct wm_report *report,const uint8_t *src) {
-  int x=(src[2]<<2)|((src[0]&0x60)>>5);
-  int y=(src[3]<<2)|((src[1]&0x20)?0x03:0x00);
-  int z=(src[4]<<2)|((src[1]&0x40)?0x03:0x00);
-  x-=512;
-  y-=512;
-  z-=512;
+static int wm_report_emit_accel(struct wm_report *report,int x,int y,int z) {
+  x=wm_report_accel_cal_apply(&report->accel_cal,0,x);
+  y=wm_report_accel_cal_apply(&report->accel_cal,1,y);
+  z=wm_report_accel_cal_apply(&report->accel_cal,2,z);
   if (wm_report_check_int(report,report->accelx,x,WM_BTNID_CORE_ACCELX)<0) return -1;
-  if (wm_report_check_int(report,report->accely,x,WM_BTNID_CORE_ACCELY)<0) return -1;
-  if (wm_report_check_int(report,report->accelz,x,WM_BTNID_CORE_ACCELZ)<0) return -1;
+  if (wm_report_check_int(report,report->accely,y,WM_BTNID_CORE_ACCELY)<0) return -1;
+  if (wm_report_check_int(report,report->accelz,z,WM_BTNID_CORE_ACCELZ)<0) return -1;
   report->accelx=x;
   report->accely=y;
   report->accelz=z;
+  if (report->orientation) {
+    wm_fusion_set_accel(&report->fusion,x,y,z);
+    report->fusion_pending=1;
+  }
   return 0;
 }
 
+static int wm_report_deliver_accel(struct wm_report *report,const uint8_t *src) {
+  int x=(src[2]<<2)|((src[0]&0x60)>>5);
+  int y=(src[3]<<2)|((src[1]&0x20)?0x03:0x00);
+  int z=(src[4]<<2)|((src[1]&0x40)?0x03:0x00);
+  return wm_report_emit_accel(report,x,y,z);
+}
+
 /* Receive infrared.
+ * Three formats, depending on the mode written to camera register 0xb00033:
+ *   Basic (1), 10 bytes: Two pairs of 5 bytes each:
+ *     0000  1 X1 low
+ *     0001  1 Y1 low
+ *     0002  1 (c0)=Y1 high (30)=X1 high (0c)=Y2 high (03)=X2 high
+ *     0003  1 X2 low
+ *     0004  1 Y2 low
+ *   Extended (3), 12 bytes: 3 bytes per dot:
+ *     0000  1 X low
+ *     0001  1 Y low
+ *     0002  1 (c0)=Y high (30)=X high (0f)=size
+ *   Full (5), 36 bytes split across 0x3e and 0x3f: 9 bytes per dot:
+ *     0000  3 same as Extended
+ *     0003  4 bounding box (ignored)
+ *     0007  1 reserved
+ *     0008  1 intensity
+ * Missing dots are all ones: X and Y 1023 (and 0xff for size in extended mode).
+ * Each decoder writes all of its dots unconditionally, no branching on content.
  */
 
+static inline void wm_ir_dot_finish(struct wm_ir_dot *dot,int x,int y,int size,int intensity) {
+  int missing=(y==0x3ff);
+  dot->x=missing?-1:x;
+  dot->y=missing?-1:y;
+  dot->size=missing?0:size;
+  dot->intensity=missing?0:intensity;
+}
+
+static void wm_report_decode_ir_basic(struct wm_ir_dot *dotv,const uint8_t *src) {
+  int i; for (i=0;i<2;i++,src+=5,dotv+=2) {
+    wm_ir_dot_finish(dotv+0,src[0]|((src[2]&0x30)<<4),src[1]|((src[2]&0xc0)<<2),0,0);
+    wm_ir_dot_finish(dotv+1,src[3]|((src[2]&0x03)<<8),src[4]|((src[2]&0x0c)<<6),0,0);
+  }
+}
+
+static void wm_report_decode_ir_extended(struct wm_ir_dot *dotv,const uint8_t *src,int dotc) {
+  int i; for (i=0;i<dotc;i++,src+=3,dotv++) {
+    wm_ir_dot_finish(dotv,src[0]|((src[2]&0x30)<<4),src[1]|((src[2]&0xc0)<<2),src[2]&0x0f,0);
+  }
+}
+
+static void wm_report_decode_ir_full(struct wm_ir_dot *dotv,const uint8_t *src,int dotc) {
+  int i; for (i=0;i<dotc;i++,src+=9,dotv++) {
+    wm_ir_dot_finish(dotv,src[0]|((src[2]&0x30)<<4),src[1]|((src[2]&0xc0)<<2),src[2]&0x0f,src[8]);
+  }
+}
+
+static int wm_report_emit_ir(struct wm_report *report,const struct wm_ir_dot *dotv) {
+  if (!memcmp(dotv,report->ir,sizeof(report->ir))) return 0;
+  memcpy(report->ir,dotv,sizeof(report->ir));
+  if (!report->delegate.cb_ir) return 0;
+  return report->delegate.cb_ir(report->delegate.userdata,report->ir);
+}
+
 static int wm_report_deliver_ir(struct wm_report *report,const uint8_t *src,int srcc) {
-  wm_log_debug("ir (%d)",srcc);//TODO
-  return 0;
+  struct wm_ir_dot dotv[WM_IR_DOT_COUNT];
+  switch (srcc) {
+    case 10: wm_report_decode_ir_basic(dotv,src); break;
+    case 12: wm_report_decode_ir_extended(dotv,src,WM_IR_DOT_COUNT); break;
+    default: return 0;
+  }
+  return wm_report_emit_ir(report,dotv);
 }
 
 /* Receive nunchuk.
  * Stick is up-positive; we invert it per my personal preference (up-negative).
  */
 
-static const uint8_t wm_null_report_nunchuk[6]={
-  0x80,
-  0x80,
-  0x80,
-  0x80,
-  0x80,
-  0x03,
-};
-
-static int wm_report_deliver_nunchuk(struct wm_report *report,const uint8_t *src,int srcc) {
-  if (srcc<6) return 0;
+static int wm_report_emit_nunchuk(struct wm_report *report,const struct wm_report_nunchuk *next) {
   struct wm_report_nunchuk prev=report->nunchuk;
-  
-  report->nunchuk.sx=src[0]-128;
-  report->nunchuk.sy=128-src[1];
-  report->nunchuk.ax=((src[2]<<2)|((src[5]&0x0c)>>2))-512;
-  report->nunchuk.ay=((src[3]<<2)|((src[5]&0x30)>>4))-512;
-  report->nunchuk.az=((src[4]<<2)|((src[5]&0xc0)>>6))-512;
-  report->nunchuk.buttons=((~src[5])&0x03);
+  report->nunchuk=*next;
 
-  if (wm_report_check_int(report,prev.sx,report->nunchuk.sx,WM_BTNID_NUNCHUK_X)<0) return -1;
-  if (wm_report_check_int(report,prev.sy,report->nunchuk.sy,WM_BTNID_NUNCHUK_Y)<0) return -1;
-  if (wm_report_check_int(report,prev.ax,report->nunchuk.ax,WM_BTNID_NUNCHUK_ACCELX)<0) return -1;
-  if (wm_report_check_int(report,prev.ay,report->nunchuk.ay,WM_BTNID_NUNCHUK_ACCELY)<0) return -1;
-  if (wm_report_check_int(report,prev.az,report->nunchuk.az,WM_BTNID_NUNCHUK_ACCELZ)<0) return -1;
-  if (wm_report_check_bit(report,prev.buttons,report->nunchuk.buttons,0x01,WM_BTNID_NUNCHUK_Z)<0) return -1;
-  if (wm_report_check_bit(report,prev.buttons,report->nunchuk.buttons,0x02,WM_BTNID_NUNCHUK_C)<0) return -1;
+  if (wm_report_check_int(report,prev.sx,next->sx,WM_BTNID_NUNCHUK_X)<0) return -1;
+  if (wm_report_check_int(report,prev.sy,next->sy,WM_BTNID_NUNCHUK_Y)<0) return -1;
+  if (wm_report_check_int(report,prev.ax,next->ax,WM_BTNID_NUNCHUK_ACCELX)<0) return -1;
+  if (wm_report_check_int(report,prev.ay,next->ay,WM_BTNID_NUNCHUK_ACCELY)<0) return -1;
+  if (wm_report_check_int(report,prev.az,next->az,WM_BTNID_NUNCHUK_ACCELZ)<0) return -1;
+  if (wm_report_check_bit(report,prev.buttons,next->buttons,0x01,WM_BTNID_NUNCHUK_Z)<0) return -1;
+  if (wm_report_check_bit(report,prev.buttons,next->buttons,0x02,WM_BTNID_NUNCHUK_C)<0) return -1;
 
   return 0;
 }
 
+static int wm_report_deliver_nunchuk(struct wm_report *report,const uint8_t *src,int srcc) {
+  if (srcc<6) return 0;
+  const struct wm_report_nunchuk_cal *cal=&report->nunchuk_cal;
+  struct wm_report_nunchuk next={
+    .sx=cal->sx[src[0]],
+    .sy=cal->sy[src[1]],
+    .ax=wm_report_accel_cal_apply(&cal->accel,0,(src[2]<<2)|((src[5]&0x0c)>>2)),
+    .ay=wm_report_accel_cal_apply(&cal->accel,1,(src[3]<<2)|((src[5]&0x30)>>4)),
+    .az=wm_report_accel_cal_apply(&cal->accel,2,(src[4]<<2)|((src[5]&0xc0)>>6)),
+    .buttons=((~src[5])&0x03),
+  };
+  return wm_report_emit_nunchuk(report,&next);
+}
+
 /* Receive classic controller.
  * Sticks are up-positive; we invert them per my personal preference (up-negative).
  */
 
-static const uint8_t wm_null_report_classic[6]={
-  0xa0,
-  0x40,
-  0x10,
-  0x00,
-  0xff,
-  0xff,
-};
+static int wm_report_emit_classic(struct wm_report *report,const struct wm_report_classic *next) {
+  struct wm_report_classic prev=report->classic;
+  report->classic=*next;
+
+  if (wm_report_check_int(report,prev.lx,next->lx,WM_BTNID_CLASSIC_LX)<0) return -1;
+  if (wm_report_check_int(report,prev.ly,next->ly,WM_BTNID_CLASSIC_LY)<0) return -1;
+  if (wm_report_check_int(report,prev.rx,next->rx,WM_BTNID_CLASSIC_RX)<0) return -1;
+  if (wm_report_check_int(report,prev.ry,next->ry,WM_BTNID_CLASSIC_RY)<0) return -1;
+  if (wm_report_check_int(report,prev.la,next->la,WM_BTNID_CLASSIC_LA)<0) return -1;
+  if (wm_report_check_int(report,prev.ra,next->ra,WM_BTNID_CLASSIC_RA)<0) return -1;
+  if (prev.buttons!=next->buttons) {
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0001,WM_BTNID_CLASSIC_UP)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0002,WM_BTNID_CLASSIC_LEFT)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0004,WM_BTNID_CLASSIC_ZR)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0008,WM_BTNID_CLASSIC_X)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0010,WM_BTNID_CLASSIC_A)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0020,WM_BTNID_CLASSIC_Y)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0040,WM_BTNID_CLASSIC_B)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0080,WM_BTNID_CLASSIC_ZL)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0200,WM_BTNID_CLASSIC_R)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0400,WM_BTNID_CLASSIC_PLUS)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x0800,WM_BTNID_CLASSIC_HOME)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x1000,WM_BTNID_CLASSIC_MINUS)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x2000,WM_BTNID_CLASSIC_L)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x4000,WM_BTNID_CLASSIC_DOWN)<0) return -1;
+    if (wm_report_check_bit(report,prev.buttons,next->buttons,0x8000,WM_BTNID_CLASSIC_RIGHT)<0) return -1;
+  }
+
+  return 0;
+}
 
 static int wm_report_deliver_classic(struct wm_report *report,const uint8_t *src,int srcc) {
   if (srcc<6) return 0;
-  struct wm_report_classic prev=report->classic;
+  const struct wm_report_classic_cal *cal=&report->classic_cal;
+  struct wm_report_classic next={
+    .lx=cal->lx[src[0]&0x3f],
+    .ly=cal->ly[src[1]&0x3f],
+    .rx=cal->rx[((src[0]&0xc0)>>3)|((src[1]&0xc0)>>5)|(src[2]>>7)],
+    .ry=cal->ry[src[2]&0x1f],
+    .la=cal->la[((src[2]&0x60)>>2)|(src[3]>>5)],
+    .ra=cal->ra[src[3]&0x1f],
+    .buttons=~((src[4]<<8)|src[5]),
+  };
+  return wm_report_emit_classic(report,&next);
+}
+
+/* Receive MotionPlus.
+ * 6 bytes, when byte 5 bit 1 is set:
+ *   0000  1 yaw low 8
+ *   0001  1 roll low 8
+ *   0002  1 pitch low 8
+ *   0003  1 (fc)=yaw high 6, (02)=yaw slow, (01)=pitch slow
+ *   0004  1 (fc)=roll high 6, (02)=roll slow, (01)=extension present
+ *   0005  1 (fc)=pitch high 6, (02)=1
+ * Slow mode is the nominal 14-bit scale; fast mode is 2000/440 times coarser, so multiply it up.
+ * In passthrough modes, frames with byte 5 bit 1 clear belong to the extension, with a few bits shuffled
+ * to make room for the MotionPlus flags. We restore the extension's normal layout and decode as usual.
+ */
+
+#define WM_GYRO_FAST_MUL ((2000<<8)/440)
 
-  report->classic.lx=(src[0]&0x3f)-32;
-  report->classic.ly=32-(src[1]&0x3f);
-  report->classic.rx=(((src[0]&0xc0)>>3)|((src[1]&0xc0)>>5)|(src[2]>>7))-16;
-  report->classic.ry=16-(src[2]&0x1f);
-  report->classic.la=((src[2]&0x60)>>2)|(src[3]>>5);
-  report->classic.ra=(src[3]&0x1f);
-  report->classic.buttons=~((src[4]<<8)|src[5]);
-
-  if (wm_report_check_int(report,prev.lx,report->classic.lx,WM_BTNID_CLASSIC_LX)<0) return -1;
-  if (wm_report_check_int(report,prev.ly,report->classic.ly,WM_BTNID_CLASSIC_LY)<0) return -1;
-  if (wm_report_check_int(report,prev.rx,report->classic.rx,WM_BTNID_CLASSIC_RX)<0) return -1;
-  if (wm_report_check_int(report,prev.ry,report->classic.ry,WM_BTNID_CLASSIC_RY)<0) return -1;
-  if (wm_report_check_int(report,prev.la,report->classic.la,WM_BTNID_CLASSIC_LA)<0) return -1;
-  if (wm_report_check_int(report,prev.ra,report->classic.ra,WM_BTNID_CLASSIC_RA)<0) return -1;
-  if (prev.buttons!=report->classic.buttons) {
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0001,WM_BTNID_CLASSIC_UP)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0002,WM_BTNID_CLASSIC_LEFT)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0004,WM_BTNID_CLASSIC_ZR)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0008,WM_BTNID_CLASSIC_X)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0010,WM_BTNID_CLASSIC_A)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0020,WM_BTNID_CLASSIC_Y)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0040,WM_BTNID_CLASSIC_B)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0080,WM_BTNID_CLASSIC_ZL)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0200,WM_BTNID_CLASSIC_R)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0400,WM_BTNID_CLASSIC_PLUS)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x0800,WM_BTNID_CLASSIC_HOME)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x1000,WM_BTNID_CLASSIC_MINUS)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x2000,WM_BTNID_CLASSIC_L)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x4000,WM_BTNID_CLASSIC_DOWN)<0) return -1;
-    if (wm_report_check_bit(report,prev.buttons,report->classic.buttons,0x8000,WM_BTNID_CLASSIC_RIGHT)<0) return -1;
+static inline int wm_report_gyro_apply(int raw,int zero,int slow) {
+  int v=raw-zero;
+  if (!slow) v=(v*WM_GYRO_FAST_MUL)>>8;
+  if (v<WM_GYRO_MIN) return WM_GYRO_MIN;
+  if (v>WM_GYRO_MAX) return WM_GYRO_MAX;
+  return v;
+}
+
+static int wm_report_emit_motionplus(struct wm_report *report,const struct wm_report_motionplus *next) {
+  struct wm_report_motionplus prev=report->mp;
+  report->mp=*next;
+  if (wm_report_check_int(report,prev.yaw,next->yaw,WM_BTNID_MOTIONPLUS_YAW)<0) return -1;
+  if (wm_report_check_int(report,prev.roll,next->roll,WM_BTNID_MOTIONPLUS_ROLL)<0) return -1;
+  if (wm_report_check_int(report,prev.pitch,next->pitch,WM_BTNID_MOTIONPLUS_PITCH)<0) return -1;
+  if (wm_report_check_int(report,prev.extpresent,next->extpresent,WM_BTNID_MOTIONPLUS_EXTPRESENT)<0) return -1;
+  return 0;
+}
+
+static int wm_report_deliver_motionplus(struct wm_report *report,const uint8_t *src,int srcc) {
+  if (srcc<6) return 0;
+
+  if (src[5]&0x02) {
+    struct wm_report_motionplus next={
+      .yaw=wm_report_gyro_apply(src[0]|((src[3]&0xfc)<<6),report->mp_zero[0],src[3]&0x02),
+      .roll=wm_report_gyro_apply(src[1]|((src[4]&0xfc)<<6),report->mp_zero[1],src[4]&0x02),
+      .pitch=wm_report_gyro_apply(src[2]|((src[5]&0xfc)<<6),report->mp_zero[2],src[3]&0x01),
+      .extpresent=src[4]&0x01,
+    };
+    if (report->orientation) wm_fusion_set_gyro(&report->fusion,next.yaw,next.roll,next.pitch);
+    return wm_report_emit_motionplus(report,&next);
   }
 
+  uint8_t ext[6];
+  switch (report->extid) {
+    case WM_DEVICE_TYPE_NUNCHUK: {
+        /* Accelerometer LSBs are lost; AZ<9:3> moves to byte 4 and everything in byte 5 shifts. */
+        ext[0]=src[0];
+        ext[1]=src[1];
+        ext[2]=src[2];
+        ext[3]=src[3];
+        ext[4]=(src[4]&0xfe)|(src[5]>>7);
+        ext[5]=
+          (((src[5]>>6)&1)<<7)|
+          (((src[5]>>5)&1)<<5)|
+          (((src[5]>>4)&1)<<3)|
+          ((src[5]>>2)&0x03);
+        return wm_report_deliver_nunchuk(report,ext,6);
+      }
+    case WM_DEVICE_TYPE_CLASSIC: {
+        /* LX and LY lose bit 0, which carries D-pad up and left instead. */
+        ext[0]=src[0]&0xfe;
+        ext[1]=src[1]&0xfe;
+        ext[2]=src[2];
+        ext[3]=src[3];
+        ext[4]=src[4]|0x01;
+        ext[5]=(src[5]&0xfc)|((src[1]&0x01)<<1)|(src[0]&0x01);
+        return wm_report_deliver_classic(report,ext,6);
+      }
+  }
+  return 0;
+}
+
+/* Receive Balance Board.
+ *   0000  2 top right, big-endian
+ *   0002  2 bottom right
+ *   0004  2 top left
+ *   0006  2 bottom left
+ * "Top" is away from the user, with the power button facing them.
+ * Also temperature and battery in 0x34, which we don't use.
+ */
+
+#define WM_BALANCE_17KG (17000/WM_BALANCE_UNIT_G)
+
+static inline int wm_report_balance_cal_apply(const struct wm_report_balance_cal *cal,int sensor,int raw) {
+  int half=(raw>=cal->split[sensor])?1:0;
+  int v=half*WM_BALANCE_17KG+(int)(((int64_t)(raw-cal->base[sensor][half])*cal->mul[sensor][half])>>16);
+  if (v<0) return 0;
+  if (v>WM_BALANCE_SENSOR_MAX) return WM_BALANCE_SENSOR_MAX;
+  return v;
+}
+
+static int wm_report_emit_balance(struct wm_report *report,const struct wm_report_balance *next) {
+  struct wm_report_balance prev=report->balance;
+  report->balance=*next;
+  if (wm_report_check_int(report,prev.sensor[0],next->sensor[0],WM_BTNID_BALANCE_TR)<0) return -1;
+  if (wm_report_check_int(report,prev.sensor[1],next->sensor[1],WM_BTNID_BALANCE_BR)<0) return -1;
+  if (wm_report_check_int(report,prev.sensor[2],next->sensor[2],WM_BTNID_BALANCE_TL)<0) return -1;
+  if (wm_report_check_int(report,prev.sensor[3],next->sensor[3],WM_BTNID_BALANCE_BL)<0) return -1;
+  if (wm_report_check_int(report,prev.total,next->total,WM_BTNID_BALANCE_TOTAL)<0) return -1;
+  if (wm_report_check_int(report,prev.copx,next->copx,WM_BTNID_BALANCE_COPX)<0) return -1;
+  if (wm_report_check_int(report,prev.copy,next->copy,WM_BTNID_BALANCE_COPY)<0) return -1;
+  return 0;
+}
+
+static int wm_report_deliver_balance(struct wm_report *report,const uint8_t *src,int srcc) {
+  if (srcc<8) return 0;
+  const struct wm_report_balance_cal *cal=&report->balance_cal;
+  if (!cal->valid) return 0;
+  struct wm_report_balance next;
+  next.sensor[0]=wm_report_balance_cal_apply(cal,0,(src[0]<<8)|src[1]);
+  next.sensor[1]=wm_report_balance_cal_apply(cal,1,(src[2]<<8)|src[3]);
+  next.sensor[2]=wm_report_balance_cal_apply(cal,2,(src[4]<<8)|src[5]);
+  next.sensor[3]=wm_report_balance_cal_apply(cal,3,(src[6]<<8)|src[7]);
+  next.total=next.sensor[0]+next.sensor[1]+next.sensor[2]+next.sensor[3];
+  if (next.total>=WM_BALANCE_COP_MIN) {
+    int right=next.sensor[0]+next.sensor[1];
+    int near=next.sensor[1]+next.sensor[3];
+    next.copx=((2*right-next.total)*(WM_BALANCE_WIDTH_MM/2))/next.total;
+    next.copy=((2*near-next.total)*(WM_BALANCE_DEPTH_MM/2))/next.total;
+  } else {
+    next.copx=next.copy=0;
+  }
+  return wm_report_emit_balance(report,&next);
+}
+
+/* Receive any extension that has a descriptor.
+ * No calibration; each field is centered per the descriptor and reported raw.
+ */
+
+static int wm_report_deliver_generic(struct wm_report *report,const uint8_t *src,int srcc) {
+  if (srcc<6) return 0;
+  const struct wm_extdesc_field *field=report->ext_desc->fieldv;
+  int *prev=report->ext_fieldv;
+  int i=report->ext_desc->fieldc; for (;i-->0;field++,prev++) {
+    int v=wm_extdesc_field_decode(field,src);
+    if (v==*prev) continue;
+    *prev=v;
+    if (report->delegate.cb_button(report->delegate.userdata,field->btnid,v)<0) return -1;
+  }
   return 0;
 }
 
+/* Extensions initialized the old way (0x00 to 0x04a40040) encrypt everything they send, with an all-zero key.
+ * For that key it reduces to ((x^0x17)+0x17) for every byte regardless of position.
+ */
+
+static const uint8_t wm_report_decrypt_table[256]={
+  0x2e,0x2d,0x2c,0x2b,0x2a,0x29,0x28,0x27,0x36,0x35,0x34,0x33,0x32,0x31,0x30,0x2f,
+  0x1e,0x1d,0x1c,0x1b,0x1a,0x19,0x18,0x17,0x26,0x25,0x24,0x23,0x22,0x21,0x20,0x1f,
+  0x4e,0x4d,0x4c,0x4b,0x4a,0x49,0x48,0x47,0x56,0x55,0x54,0x53,0x52,0x51,0x50,0x4f,
+  0x3e,0x3d,0x3c,0x3b,0x3a,0x39,0x38,0x37,0x46,0x45,0x44,0x43,0x42,0x41,0x40,0x3f,
+  0x6e,0x6d,0x6c,0x6b,0x6a,0x69,0x68,0x67,0x76,0x75,0x74,0x73,0x72,0x71,0x70,0x6f,
+  0x5e,0x5d,0x5c,0x5b,0x5a,0x59,0x58,0x57,0x66,0x65,0x64,0x63,0x62,0x61,0x60,0x5f,
+  0x8e,0x8d,0x8c,0x8b,0x8a,0x89,0x88,0x87,0x96,0x95,0x94,0x93,0x92,0x91,0x90,0x8f,
+  0x7e,0x7d,0x7c,0x7b,0x7a,0x79,0x78,0x77,0x86,0x85,0x84,0x83,0x82,0x81,0x80,0x7f,
+  0xae,0xad,0xac,0xab,0xaa,0xa9,0xa8,0xa7,0xb6,0xb5,0xb4,0xb3,0xb2,0xb1,0xb0,0xaf,
+  0x9e,0x9d,0x9c,0x9b,0x9a,0x99,0x98,0x97,0xa6,0xa5,0xa4,0xa3,0xa2,0xa1,0xa0,0x9f,
+  0xce,0xcd,0xcc,0xcb,0xca,0xc9,0xc8,0xc7,0xd6,0xd5,0xd4,0xd3,0xd2,0xd1,0xd0,0xcf,
+  0xbe,0xbd,0xbc,0xbb,0xba,0xb9,0xb8,0xb7,0xc6,0xc5,0xc4,0xc3,0xc2,0xc1,0xc0,0xbf,
+  0xee,0xed,0xec,0xeb,0xea,0xe9,0xe8,0xe7,0xf6,0xf5,0xf4,0xf3,0xf2,0xf1,0xf0,0xef,
+  0xde,0xdd,0xdc,0xdb,0xda,0xd9,0xd8,0xd7,0xe6,0xe5,0xe4,0xe3,0xe2,0xe1,0xe0,0xdf,
+  0x0e,0x0d,0x0c,0x0b,0x0a,0x09,0x08,0x07,0x16,0x15,0x14,0x13,0x12,0x11,0x10,0x0f,
+  0xfe,0xfd,0xfc,0xfb,0xfa,0xf9,0xf8,0xf7,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0xff,
+};
+
+void wm_report_decrypt(void *dst,const void *src,int c) {
+  uint8_t *DST=dst;
+  const uint8_t *SRC=src;
+  for (;c-->0;DST++,SRC++) *DST=wm_report_decrypt_table[*SRC];
+}
+
 /* Receive extension report.
  */
 
 static int wm_report_deliver_ext(struct wm_report *report,const uint8_t *src,int srcc) {
+  if (report->motionplus) return wm_report_deliver_motionplus(report,src,srcc);
+  uint8_t plain[21];
+  if (report->ext_encrypted) {
+    if (srcc>sizeof(plain)) srcc=sizeof(plain);
+    wm_report_decrypt(plain,src,srcc);
+    src=plain;
+  }
+  if (report->ext_desc) return wm_report_deliver_generic(report,src,srcc);
   switch (report->extid) {
     case WM_DEVICE_TYPE_NUNCHUK: return wm_report_deliver_nunchuk(report,src,srcc);
     case WM_DEVICE_TYPE_CLASSIC: return wm_report_deliver_classic(report,src,srcc);
-    //TODO other extensions. specs at /Users/andy/doc/wiimote-extension.html. I'll have to fly blind though
+    case WM_DEVICE_TYPE_BALANCE: return wm_report_deliver_balance(report,src,srcc);
   }
   return 0;
 }
 
+/* Advance orientation, once per report that carried the accelerometer.
+ * Time between reports is usually 10 or 5 ms, but clamp it in case we stalled.
+ */
+
+static int wm_report_step_fusion(struct wm_report *report) {
+  report->fusion_pending=0;
+  int64_t now=wm_now_us();
+  int dt=(int)(now-report->fusion_time);
+  if (!report->fusion_time||(dt>50000)) dt=10000;
+  else if (dt<1) dt=1;
+  report->fusion_time=now;
+  wm_fusion_step(&report->fusion,dt);
+  int roll=report->fusion.roll/10;
+  int pitch=report->fusion.pitch/10;
+  int yaw=report->fusion.yaw/10;
+  if (wm_report_check_int(report,report->roll,roll,WM_BTNID_ORIENT_ROLL)<0) return -1;
+  if (wm_report_check_int(report,report->pitch,pitch,WM_BTNID_ORIENT_PITCH)<0) return -1;
+  if (wm_report_check_int(report,report->yaw,yaw,WM_BTNID_ORIENT_YAW)<0) return -1;
+  report->roll=roll;
+  report->pitch=pitch;
+  report->yaw=yaw;
+  return 0;
+}
+
 /* Receive interleaved reports. (3e/3f)
  * These expect the entire report, headers and all.
+ * Both halves carry the core buttons, and the rest is split between them:
+ *   0x3e: Accel X high 8 bits, Z bits 4..7 in the spare button bits, IR dots 0 and 1.
+ *   0x3f: Accel Y high 8 bits, Z bits 0..3 in the spare button bits, IR dots 2 and 3.
+ * There are no extension bytes in this mode; the extension is silent while it's active.
+ * Halves carry no sequence number, so we only pair a 0x3f with the 0x3e immediately before it.
+ * Anything else is a lost or reordered half, and we drop it rather than mix two samples.
+ * Buttons are delivered from every half regardless.
  */
 
 static int wm_report_deliver_3e(struct wm_report *report,const uint8_t *src) {
-  memcpy(report->rpt3e,src,23);
   if (wm_report_deliver_core_buttons(report,src+2)<0) return -1;
+  if (report->have3e) {
+    wm_log_debug("Dropping 0x3e report, its 0x3f was lost or out of order.");
+    if (report->stats) report->stats->interleave_dropped_3e++;
+  }
+  report->have3e=1;
+  report->accel3e=src[4];
+  report->z3e=((src[3]&0x60)<<1)|((src[2]&0x60)>>1);
+  wm_report_decode_ir_full(report->ir_pending,src+5,2);
   return 0;
 }
 
 static int wm_report_deliver_3f(struct wm_report *report,const uint8_t *src) {
   
   if (wm_report_deliver_core_buttons(report,src+2)<0) return -1;
+  if (!report->have3e) {
+    wm_log_debug("Dropping 0x3f report, its 0x3e was lost or out of order.");
+    if (report->stats) report->stats->interleave_dropped_3f++;
+    return 0;
+  }
+  report->have3e=0;
+  if (report->stats) report->stats->interleave_pairs++;
 
-  /* Accelerometers. */
-  int x=report->rpt3e[4];
+  /* Accelerometers, 8 bits each. Replicate the low bit to span the usual 10-bit range. */
+  int x=report->accel3e;
   int y=src[4];
-  int z=
-    ((report->rpt3e[3]&0x60)<<1)|
-    ((report->rpt3e[2]&0x60)>>1)|
-    ((src[3]&0x60)>>3)|
-    ((src[2]&0x60)>>5)
-  ;
-  x=((x<<2)|((x&1)?3:0))-512;
-  y=((y<<2)|((y&1)?3:0))-512;
-  z=((z<<2)|((z&1)?3:0))-512;
-  if (wm_report_check_int(report,report->accelx,x,WM_BTNID_CORE_ACCELX)<0) return -1;
-  if (wm_report_check_int(report,report->accely,x,WM_BTNID_CORE_ACCELY)<0) return -1;
-  if (wm_report_check_int(report,report->accelz,x,WM_BTNID_CORE_ACCELZ)<0) return -1;
-  report->accelx=x;
-  report->accely=y;
-  report->accelz=z;
-
-  //TODO interleaved extension bytes
+  int z=report->z3e|((src[3]&0x60)>>3)|((src[2]&0x60)>>5);
+  x=(x<<2)|((x&1)?3:0);
+  y=(y<<2)|((y&1)?3:0);
+  z=(z<<2)|((z&1)?3:0);
+  if (wm_report_emit_accel(report,x,y,z)<0) return -1;
+
+  /* IR, dots 0 and 1 from 3e, 2 and 3 here. */
+  wm_report_decode_ir_full(report->ir_pending+2,src+5,2);
+  if (wm_report_emit_ir(report,report->ir_pending)<0) return -1;
   
   return 0;
 }
@@ -367,22 +811,27 @@ int wm_report_deliver(struct wm_report *report,const void *src,int srcc) {
     return 0;
   }
 
-  /* Ignore redundant reports.
+  /* Ignore redundant data reports.
    * My Rock Candy remotes send these in mode 0x30 even if we tell it not to.
+   * Status, read, and ACK reports are replies, and two identical replies are still two replies.
    */  
-  if ((srcc==report->pvrptc)&&!memcmp(src,report->pvrpt,srcc)) {
-    return 0;
+  if ((SRC[1]>=0x30)&&(SRC[1]<=0x3f)) {
+    if ((srcc==report->pvrptc)&&!memcmp(src,report->pvrpt,srcc)) {
+      return 0;
+    }
+    memcpy(report->pvrpt,src,srcc);
+    report->pvrptc=srcc;
   }
-  memcpy(report->pvrpt,src,srcc);
-  report->pvrptc=srcc;
 
-  //TODO
-  char buf[256];
-  int bufc=wm_report_repr(buf,sizeof(buf),src,srcc);
-  if ((bufc>0)&&(bufc<=sizeof(buf))) {
-    wm_log_trace("REPORT: %.*s",bufc,buf);
-  } else {
-    wm_log_trace("REPORT %d bytes",srcc);
+  /* Every report comes through here, so only format it if someone will see it. */
+  if (wm_log_trace_enabled()) {
+    char buf[256];
+    int bufc=wm_report_repr(buf,sizeof(buf),src,srcc);
+    if ((bufc>0)&&(bufc<=sizeof(buf))) {
+      wm_log_trace("REPORT: %.*s",bufc,buf);
+    } else {
+      wm_log_trace("REPORT %d bytes",srcc);
+    }
   }
 
   /* Parse report bits based on the report ID. */
@@ -422,6 +871,11 @@ int wm_report_deliver(struct wm_report *report,const void *src,int srcc) {
         wm_log_warning("Ignoring unknown %d-byte report ID 0x%02x",srcc,SRC[1]);
       }
   }
+
+  /* Gyro comes after the accelerometer in the same report, so orientation waits until both are in. */
+  if (report->fusion_pending) {
+    if (wm_report_step_fusion(report)<0) return -1;
+  }
   return 0;
 }
 
@@ -444,6 +898,21 @@ int wm_report_set_button(struct wm_report *report,int btnid,int value) {
   return 0;
 }
 
+/* Reset.
+ */
+
+int wm_report_reset(struct wm_report *report) {
+  if (!report) return -1;
+  uint8_t zero[2]={0};
+  if (wm_report_deliver_core_buttons(report,zero)<0) return -1;
+  if (wm_report_check_bit(report,report->status,0,0x01,WM_BTNID_CORE_BATTLOW)<0) return -1;
+  if (wm_report_check_bit(report,report->status,0,0x02,WM_BTNID_CORE_EXTPRESENT)<0) return -1;
+  report->status=0;
+  report->pvrptc=0;
+  report->have3e=0;
+  return 0;
+}
+
 /* Set properties.
  */
  
@@ -456,9 +925,21 @@ int wm_report_set_rptid(struct wm_report *report,uint8_t rptid) {
     default: return -1;
   }
   report->rptid=rptid;
+  report->have3e=0;
+  return 0;
+}
+
+int wm_report_set_stats(struct wm_report *report,struct wm_stats *stats) {
+  if (!report) return -1;
+  report->stats=stats;
   return 0;
 }
 
+uint8_t wm_report_get_rptid(const struct wm_report *report) {
+  if (!report) return 0;
+  return report->rptid;
+}
+
 int wm_report_set_rumble(struct wm_report *report,int rumble) {
   if (!report) return -1;
   report->rumble=rumble?0x01:0x00;//TODO
@@ -467,37 +948,263 @@ int wm_report_set_rumble(struct wm_report *report,int rumble) {
 
 int wm_report_set_continuous(struct wm_report *report,int continuous) {
   if (!report) return -1;
-  report->continuous=continuous?0x02:0x00;//TODO
+  report->continuous=continuous?0x04:0x00;
+  return 0;
+}
+
+/* Accelerometer calibration, from EEPROM 0x0016.
+ *   0000  3 zero X,Y,Z, bits 9..2
+ *   0003  1 zero low bits: 30=X, 0c=Y, 03=Z
+ *   0004  3 1g X,Y,Z, bits 9..2
+ *   0007  1 1g low bits
+ *   0008  1 (speaker and motor, not ours)
+ *   0009  1 checksum: Sum of the first 9 bytes, plus 0x55
+ */
+
+int wm_report_set_accel_calibration(struct wm_report *report,const void *src,int srcc) {
+  if (!report||!src) return -1;
+  if (srcc<10) return -1;
+  const uint8_t *SRC=src;
+
+  uint8_t checksum=0x55;
+  int i; for (i=0;i<9;i++) checksum+=SRC[i];
+  if (checksum!=SRC[9]) {
+    wm_log_warning("Accelerometer calibration checksum mismatch (0x%02x, expected 0x%02x).",SRC[9],checksum);
+    return -1;
+  }
+
+  int zero[3]={
+    (SRC[0]<<2)|((SRC[3]>>4)&3),
+    (SRC[1]<<2)|((SRC[3]>>2)&3),
+    (SRC[2]<<2)|(SRC[3]&3),
+  };
+  int one[3]={
+    (SRC[4]<<2)|((SRC[7]>>4)&3),
+    (SRC[5]<<2)|((SRC[7]>>2)&3),
+    (SRC[6]<<2)|(SRC[7]&3),
+  };
+  if (wm_report_accel_cal_set(&report->accel_cal,zero,one)<0) {
+    wm_log_warning("Implausible accelerometer calibration, keeping defaults.");
+    return -1;
+  }
+  wm_log_debug(
+    "Accelerometer calibration: zero=%d,%d,%d 1g=%d,%d,%d",
+    zero[0],zero[1],zero[2],one[0],one[1],one[2]
+  );
   return 0;
 }
 
 /* Change extension.
  */
 
+static int wm_report_drop_extension(struct wm_report *report) {
+  if (report->ext_desc) {
+    const struct wm_extdesc_field *field=report->ext_desc->fieldv;
+    int i=0; for (;i<report->ext_desc->fieldc;i++,field++) {
+      if (!report->ext_fieldv[i]) continue;
+      report->ext_fieldv[i]=0;
+      if (report->delegate.cb_button(report->delegate.userdata,field->btnid,0)<0) return -1;
+    }
+    report->ext_desc=0;
+  } else switch (report->extid) {
+    case WM_DEVICE_TYPE_NUNCHUK: {
+        struct wm_report_nunchuk zero={0};
+        if (wm_report_emit_nunchuk(report,&zero)<0) return -1;
+      } break;
+    case WM_DEVICE_TYPE_CLASSIC: {
+        struct wm_report_classic zero={0};
+        if (wm_report_emit_classic(report,&zero)<0) return -1;
+      } break;
+    case WM_DEVICE_TYPE_BALANCE: {
+        struct wm_report_balance zero={0};
+        if (wm_report_emit_balance(report,&zero)<0) return -1;
+      } break;
+  }
+  return 0;
+}
+
 int wm_report_set_extension(struct wm_report *report,int extid) {
   if (!report) return -1;
 
-  /* Ensure it's a known extension and not the one we already have. */
+  /* Ensure it's a known extension and not the one we already have.
+   * Each new extension starts with default calibration.
+   */
   if (extid==report->extid) return 0;
+  const struct wm_extdesc *desc=0;
   switch (extid) {
     case 0:
     case WM_DEVICE_TYPE_NUNCHUK:
     case WM_DEVICE_TYPE_CLASSIC:
+    case WM_DEVICE_TYPE_BALANCE:
       break;
-    default: return -1;
+    default: if (!(desc=wm_extdesc_for_device_type(extid))) return -1;
   }
 
-  /* Drop any state associated with the previous extension. */
+  if (wm_report_drop_extension(report)<0) return -1;
+
+  report->extid=extid;
+  report->ext_desc=desc;
+  wm_report_nunchuk_cal_default(&report->nunchuk_cal);
+  wm_report_classic_cal_default(&report->classic_cal);
+  report->balance_cal.valid=0;
+  return 0;
+}
+
+int wm_report_set_extension_encrypted(struct wm_report *report,int encrypted) {
+  if (!report) return -1;
+  report->ext_encrypted=encrypted?1:0;
+  return 0;
+}
+
+int wm_report_set_extension_generic(struct wm_report *report,int extid) {
+  if (!report) return -1;
+  const struct wm_extdesc *desc=wm_extdesc_for_device_type(extid);
+  if (!desc) return -1;
+  if (wm_report_drop_extension(report)<0) return -1;
+  report->extid=extid;
+  report->ext_desc=desc;
+  return 0;
+}
+
+/* Extension calibration, 16 bytes from 0x04a40020.
+ * Both layouts end with two checksum bytes: Sum of the first 14 plus 0x55, then that plus 0xaa.
+ * Nunchuk:
+ *   0000  4 accelerometer zero, same layout as core
+ *   0004  4 accelerometer 1g
+ *   0008  3 stick X max,min,center
+ *   000b  3 stick Y max,min,center
+ * Classic: Each is max,min,center, all 8-bit though the reports are 6 (left) or 5 (right) bits.
+ *   0000  3 LX
+ *   0003  3 LY
+ *   0006  3 RX
+ *   0009  3 RY
+ *   000c  1 left trigger zero
+ *   000d  1 right trigger zero
+ */
+
+static int wm_report_set_nunchuk_calibration(struct wm_report *report,const uint8_t *src) {
+  struct wm_report_nunchuk_cal *cal=&report->nunchuk_cal;
+  if ((src[9]>=src[10])||(src[10]>=src[8])||(src[12]>=src[13])||(src[13]>=src[11])) return -1;
+  int zero[3]={
+    (src[0]<<2)|((src[3]>>4)&3),
+    (src[1]<<2)|((src[3]>>2)&3),
+    (src[2]<<2)|(src[3]&3),
+  };
+  int one[3]={
+    (src[4]<<2)|((src[7]>>4)&3),
+    (src[5]<<2)|((src[7]>>2)&3),
+    (src[6]<<2)|(src[7]&3),
+  };
+  if (wm_report_accel_cal_set(&cal->accel,zero,one)<0) return -1;
+  wm_report_build_axis_table(cal->sx,256,src[9],src[10],src[8],2,127,0);
+  wm_report_build_axis_table(cal->sy,256,src[12],src[13],src[11],2,127,1);
+  return 0;
+}
+
+static int wm_report_set_classic_calibration(struct wm_report *report,const uint8_t *src) {
+  struct wm_report_classic_cal *cal=&report->classic_cal;
+  int i; for (i=0;i<12;i+=3) {
+    if ((src[i+1]>=src[i+2])||(src[i+2]>=src[i])) return -1;
+  }
+  wm_report_build_axis_table(cal->lx,64,src[1]>>2,src[2]>>2,src[0]>>2,1,31,0);
+  wm_report_build_axis_table(cal->ly,64,src[4]>>2,src[5]>>2,src[3]>>2,1,31,1);
+  wm_report_build_axis_table(cal->rx,32,src[7]>>3,src[8]>>3,src[6]>>3,0,15,0);
+  wm_report_build_axis_table(cal->ry,32,src[10]>>3,src[11]>>3,src[9]>>3,0,15,1);
+  wm_report_build_trigger_table(cal->la,32,src[12]>>3,31,31);
+  wm_report_build_trigger_table(cal->ra,32,src[13]>>3,31,31);
+  return 0;
+}
+
+/* Balance Board calibration, 24 bytes from 0x04a40024.
+ *   0000  8 raw readings at 0 kg: TR,BR,TL,BL, 16 bits each, big-endian
+ *   0008  8 at 17 kg
+ *   0010  8 at 34 kg
+ * A CRC follows at 0x04a4003c, but that's not documented well enough to check.
+ */
+
+static int wm_report_set_balance_calibration(struct wm_report *report,const uint8_t *src,int srcc) {
+  if (srcc<24) return -1;
+  struct wm_report_balance_cal cal={.valid=1};
+  int i; for (i=0;i<4;i++) {
+    int c0=(src[i*2]<<8)|src[i*2+1];
+    int c17=(src[8+i*2]<<8)|src[9+i*2];
+    int c34=(src[16+i*2]<<8)|src[17+i*2];
+    if ((c0>=c17)||(c17>=c34)) {
+      wm_log_warning("Implausible Balance Board calibration, sensor %d: %d,%d,%d",i,c0,c17,c34);
+      return -1;
+    }
+    cal.split[i]=c17;
+    cal.base[i][0]=c0;
+    cal.base[i][1]=c17;
+    cal.mul[i][0]=(WM_BALANCE_17KG<<16)/(c17-c0);
+    cal.mul[i][1]=(WM_BALANCE_17KG<<16)/(c34-c17);
+  }
+  report->balance_cal=cal;
+  wm_log_debug("Applied Balance Board calibration.");
+  return 0;
+}
+
+int wm_report_set_extension_calibration(struct wm_report *report,const void *src,int srcc) {
+  if (!report||!src) return -1;
+  if (report->extid==WM_DEVICE_TYPE_BALANCE) return wm_report_set_balance_calibration(report,src,srcc);
+  if (srcc<16) return -1;
+  const uint8_t *SRC=src;
+
+  uint8_t checksum=0x55;
+  int i; for (i=0;i<14;i++) checksum+=SRC[i];
+  if ((checksum!=SRC[14])||((uint8_t)(checksum+0xaa)!=SRC[15])) {
+    wm_log_warning("Extension calibration checksum mismatch.");
+    return -1;
+  }
+
+  int err=-1;
   switch (report->extid) {
-    case WM_DEVICE_TYPE_NUNCHUK: {
-        if (wm_report_deliver_nunchuk(report,wm_null_report_nunchuk,sizeof(wm_null_report_nunchuk))<0) return -1;
-      } break;
-    case WM_DEVICE_TYPE_CLASSIC: {
-        if (wm_report_deliver_nunchuk(report,wm_null_report_classic,sizeof(wm_null_report_classic))<0) return -1;
-      } break;
+    case WM_DEVICE_TYPE_NUNCHUK: err=wm_report_set_nunchuk_calibration(report,SRC); break;
+    case WM_DEVICE_TYPE_CLASSIC: err=wm_report_set_classic_calibration(report,SRC); break;
   }
+  if (err<0) {
+    wm_log_warning("Implausible extension calibration, keeping defaults.");
+    return -1;
+  }
+  wm_log_debug("Applied calibration for extension '%s'.",wm_device_type_repr(report->extid));
+  return 0;
+}
 
-  report->extid=extid;
+/* MotionPlus.
+ */
+
+int wm_report_set_motionplus(struct wm_report *report,int enable) {
+  if (!report) return -1;
+  enable=enable?1:0;
+  if (enable==report->motionplus) return 0;
+  report->motionplus=enable;
+  wm_fusion_clear_gyro(&report->fusion);
+  struct wm_report_motionplus zero={0};
+  if (wm_report_emit_motionplus(report,&zero)<0) return -1;
+  int i; for (i=0;i<3;i++) report->mp_zero[i]=WM_GYRO_RAW_ZERO;
+  return 0;
+}
+
+/* MotionPlus calibration, 32 bytes from 0x04a40020 once active.
+ * Two 16-byte blocks, fast mode then slow mode, each starting with big-endian 16-bit zeroes for yaw, roll, pitch.
+ * The rest (scales, checksum) is not well documented, so we only take the slow-mode zeroes, and only if plausible.
+ * Reported values are 14 bits, calibration is 16.
+ */
+
+int wm_report_set_motionplus_calibration(struct wm_report *report,const void *src,int srcc) {
+  if (!report||!src) return -1;
+  if (srcc<32) return -1;
+  const uint8_t *SRC=(const uint8_t*)src+16;
+  int zero[3],i;
+  for (i=0;i<3;i++) {
+    zero[i]=((SRC[i*2]<<8)|SRC[i*2+1])>>2;
+    if ((zero[i]<WM_GYRO_RAW_ZERO-2048)||(zero[i]>WM_GYRO_RAW_ZERO+2048)) {
+      wm_log_warning("Implausible MotionPlus calibration, keeping defaults.");
+      return -1;
+    }
+  }
+  memcpy(report->mp_zero,zero,sizeof(zero));
+  wm_log_debug("MotionPlus calibration: zero=%d,%d,%d",zero[0],zero[1],zero[2]);
   return 0;
 }
 
@@ -513,6 +1220,47 @@ int wm_report_compose_led(void *dst,int dsta,struct wm_report *report,int led1,i
   return 3;
 }
 
+int wm_report_compose_ir_enable(void *dst,int dsta,struct wm_report *report,uint8_t rptid,int enable) {
+  if (!dst||(dsta<3)) return -1;
+  if ((rptid!=0x13)&&(rptid!=0x1a)) return -1;
+  uint8_t *DST=dst;
+  DST[0]=0xa2;
+  DST[1]=rptid;
+  DST[2]=enable?0x04:0x00;
+  return 3;
+}
+
+int wm_report_compose_speaker(void *dst,int dsta,struct wm_report *report,uint8_t rptid,int enable) {
+  if (!dst||(dsta<3)) return -1;
+  if ((rptid!=0x14)&&(rptid!=0x19)) return -1;
+  uint8_t *DST=dst;
+  DST[0]=0xa2;
+  DST[1]=rptid;
+  DST[2]=enable?0x04:0x00;
+  return 3;
+}
+
+int wm_report_compose_speaker_data(void *dst,int dsta,struct wm_report *report,const void *src,int srcc) {
+  if (!dst||(dsta<23)) return -1;
+  if ((srcc<0)||(srcc>20)||(srcc&&!src)) return -1;
+  uint8_t *DST=dst;
+  DST[0]=0xa2;
+  DST[1]=0x18;
+  DST[2]=srcc<<3;
+  memcpy(DST+3,src,srcc);
+  memset(DST+3+srcc,0,20-srcc);
+  return 23;
+}
+
+int wm_report_compose_status_request(void *dst,int dsta,struct wm_report *report) {
+  if (!dst||(dsta<3)) return -1;
+  uint8_t *DST=dst;
+  DST[0]=0xa2;
+  DST[1]=0x15;
+  DST[2]=0x00;
+  return 3;
+}
+
 int wm_report_compose_rptid(void *dst,int dsta,struct wm_report *report) {
   if (!dst||(dsta<4)) return -1;
   uint8_t *DST=dst;
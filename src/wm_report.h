@@ -7,11 +7,53 @@
 
 struct wm_report;
 struct wm_config;
+struct wm_stats;
+
+/* Calibrated accelerometer values are zero-centered, with 1 g = WM_ACCEL_1G, clamped to (WM_ACCEL_MIN..WM_ACCEL_MAX).
+ * That's about +-4 g, which covers what the hardware can actually report.
+ */
+#define WM_ACCEL_1G    128
+#define WM_ACCEL_MIN  -512
+#define WM_ACCEL_MAX   511
+
+/* IR camera dots.
+ * The camera tracks up to four points, in a (0..WM_IR_X_MAX,0..WM_IR_Y_MAX) space.
+ * Unused slots have (x<0). The slot a dot lands in is stable while the camera keeps tracking it.
+ * (size) is 0..15, only reported in extended and full modes. (intensity) only in full mode.
+ */
+#define WM_IR_DOT_COUNT    4
+#define WM_IR_X_MAX     1023
+#define WM_IR_Y_MAX      767
+
+/* MotionPlus gyro, in slow-mode counts (about 1/14 degree per second) regardless of the device's current mode.
+ */
+#define WM_GYRO_RAW_ZERO 8192
+#define WM_GYRO_MIN    -32768
+#define WM_GYRO_MAX     32767
+
+/* Balance Board.
+ * Each corner's load in units of WM_BALANCE_UNIT_G grams, so 1700 is 17 kg. Nothing until calibration arrives.
+ * Center of pressure is in millimeters from the middle, right and toward the user positive.
+ * It reads zero when the total load is under WM_BALANCE_COP_MIN.
+ */
+#define WM_BALANCE_UNIT_G       10
+#define WM_BALANCE_SENSOR_MAX 20000
+#define WM_BALANCE_TOTAL_MAX  40000
+#define WM_BALANCE_COP_MIN      300
+#define WM_BALANCE_WIDTH_MM     433 /* Distance between the sensors, left to right. */
+#define WM_BALANCE_DEPTH_MM     238 /* Front to back. */
+
+struct wm_ir_dot {
+  int16_t x,y;
+  uint8_t size;
+  uint8_t intensity;
+};
 
 struct wm_report_delegate {
   int (*cb_button)(void *userdata,int btnid,int value);
   int (*cb_ack)(void *userdata,uint8_t rptid,uint8_t result);
   int (*cb_read)(void *userdata,uint16_t addr,int err,const void *src,int srcc);
+  int (*cb_ir)(void *userdata,const struct wm_ir_dot *dotv); // Optional. WM_IR_DOT_COUNT dots, whenever any changes.
   void *userdata;
 };
 
@@ -43,21 +85,71 @@ int wm_report_get_button(const struct wm_report *report,int btnid);
  */
 int wm_report_set_button(struct wm_report *report,int btnid,int value);
 
+/* Forget what the device last told us, as if it had just connected.
+ * Core buttons are released and the status bits cleared through the callback, so a held extension goes away too.
+ * Calibration, extension, and report mode are untouched.
+ */
+int wm_report_reset(struct wm_report *report);
+
+/* (stats) is WEAK and optional.
+ */
+int wm_report_set_stats(struct wm_report *report,struct wm_stats *stats);
+
 int wm_report_set_rptid(struct wm_report *report,uint8_t rptid);
+uint8_t wm_report_get_rptid(const struct wm_report *report);
 int wm_report_set_rumble(struct wm_report *report,int rumble);
 int wm_report_set_continuous(struct wm_report *report,int continuous);
 
+/* Replace the default accelerometer calibration with the 10-byte block from EEPROM 0x0016.
+ * Fails without changing anything if the checksum or values are bad.
+ */
+int wm_report_set_accel_calibration(struct wm_report *report,const void *src,int srcc);
+
 /* The report object doesn't know what extension is connected to it.
  * TODO Maybe we should adjust the responsibilities of coord and report in this regard.
  * You must tell me how to interpret extension reports.
  */
 int wm_report_set_extension(struct wm_report *report,int extid);
 
+/* Nonzero if the extension was initialized the old way, so its bytes arrive encrypted.
+ * Not reset by wm_report_set_extension(). Doesn't apply to MotionPlus, which is never encrypted.
+ */
+int wm_report_set_extension_encrypted(struct wm_report *report,int encrypted);
+
+/* Undo the old-way extension encryption, for reads as well as reports. (dst) and (src) may be the same.
+ */
+void wm_report_decrypt(void *dst,const void *src,int c);
+
+/* Decode this extension from its wm_extdesc descriptor, even if it has a hand-written decoder.
+ * For benchmarking, and for checking a new descriptor against the known ones. Values are not calibrated.
+ */
+int wm_report_set_extension_generic(struct wm_report *report,int extid);
+
+/* Replace the default extension calibration with the 16-byte block from 0x04a40020.
+ * Balance Board is different: 24 bytes from 0x04a40024, and it has no default.
+ * Interpreted according to the current extension, so call wm_report_set_extension() first.
+ * Fails without changing anything if the checksum or values are bad.
+ */
+int wm_report_set_extension_calibration(struct wm_report *report,const void *src,int srcc);
+
+/* A MotionPlus, when active, takes over the extension bytes.
+ * Its passthrough extension, if any, is still the one you set with wm_report_set_extension().
+ */
+int wm_report_set_motionplus(struct wm_report *report,int enable);
+
+/* Replace the default gyro zeroes with the 32-byte block from 0x04a40020, while the MotionPlus is active.
+ */
+int wm_report_set_motionplus_calibration(struct wm_report *report,const void *src,int srcc);
+
 /* Compose output reports.
  * No output report is longer than 23 bytes. We fail if you provide a short buffer.
  */
 
 int wm_report_compose_led(void *dst,int dsta,struct wm_report *report,int led1,int led2,int led3,int led4);
+int wm_report_compose_ir_enable(void *dst,int dsta,struct wm_report *report,uint8_t rptid,int enable); // 0x13 or 0x1a
+int wm_report_compose_speaker(void *dst,int dsta,struct wm_report *report,uint8_t rptid,int enable); // 0x14 enable or 0x19 mute
+int wm_report_compose_speaker_data(void *dst,int dsta,struct wm_report *report,const void *src,int srcc); // 0x18, up to 20 bytes
+int wm_report_compose_status_request(void *dst,int dsta,struct wm_report *report); // 0x15, answered with 0x20
 int wm_report_compose_rptid(void *dst,int dsta,struct wm_report *report);
 int wm_report_compose_write(void *dst,int dsta,struct wm_report *report,int addr,const void *src,int srcc);
 int wm_report_compose_read(void *dst,int dsta,struct wm_report *report,int addr,int size);
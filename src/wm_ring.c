@@ -0,0 +1,94 @@
+#include "wiimote.h"
+#include "wm_ring.h"
+
+/* Object definition.
+ * (head) and (tail) count forever; index into (packetv) by masking.
+ * Stores to your own index are release, loads of the other's are acquire.
+ * Push and pop also fence between publishing their own index and looking at the other's,
+ * so a producer that sees a non-empty ring is guaranteed the consumer will see its packet before sleeping.
+ */
+
+struct wm_ring {
+  struct {
+    uint32_t head;
+    uint32_t tail; // Last seen.
+    int overflows;
+  } __attribute__((aligned(WM_RING_CACHE_LINE))) producer;
+  struct {
+    uint32_t tail;
+    uint32_t head; // Last seen.
+  } __attribute__((aligned(WM_RING_CACHE_LINE))) consumer;
+  struct wm_ring_packet packetv[WM_RING_SIZE];
+};
+
+/* Object lifecycle.
+ */
+
+struct wm_ring *wm_ring_new() {
+  struct wm_ring *ring=0;
+  if (posix_memalign((void**)&ring,WM_RING_CACHE_LINE,sizeof(struct wm_ring))) return 0;
+  memset(ring,0,sizeof(struct wm_ring));
+  return ring;
+}
+
+void wm_ring_del(struct wm_ring *ring) {
+  if (!ring) return;
+  free(ring);
+}
+
+/* Push.
+ */
+
+int wm_ring_push(struct wm_ring *ring,const void *src,int srcc,int64_t time) {
+  if (!ring||(srcc<0)||(srcc>WM_RING_PACKET_SIZE)) return -1;
+  uint32_t head=ring->producer.head;
+  if (head-ring->producer.tail>=WM_RING_SIZE) {
+    ring->producer.tail=__atomic_load_n(&ring->consumer.tail,__ATOMIC_ACQUIRE);
+    if (head-ring->producer.tail>=WM_RING_SIZE) {
+      __atomic_store_n(&ring->producer.overflows,ring->producer.overflows+1,__ATOMIC_RELAXED);
+      return 0;
+    }
+  }
+  struct wm_ring_packet *packet=ring->packetv+(head&(WM_RING_SIZE-1));
+  packet->time=time;
+  packet->c=srcc;
+  memcpy(packet->v,src,srcc);
+  __atomic_store_n(&ring->producer.head,head+1,__ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  ring->producer.tail=__atomic_load_n(&ring->consumer.tail,__ATOMIC_ACQUIRE);
+  return (ring->producer.tail==head)?2:1;
+}
+
+/* Pop.
+ */
+
+int wm_ring_pop(struct wm_ring_packet *dst,struct wm_ring *ring) {
+  if (!dst||!ring) return -1;
+  uint32_t tail=ring->consumer.tail;
+  if (tail==ring->consumer.head) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    ring->consumer.head=__atomic_load_n(&ring->producer.head,__ATOMIC_ACQUIRE);
+    if (tail==ring->consumer.head) return 0;
+  }
+  const struct wm_ring_packet *packet=ring->packetv+(tail&(WM_RING_SIZE-1));
+  dst->time=packet->time;
+  dst->c=packet->c;
+  memcpy(dst->v,packet->v,packet->c);
+  __atomic_store_n(&ring->consumer.tail,tail+1,__ATOMIC_RELEASE);
+  return 1;
+}
+
+/* Counters.
+ */
+
+int wm_ring_count(const struct wm_ring *ring) {
+  if (!ring) return 0;
+  uint32_t tail=__atomic_load_n(&ring->consumer.tail,__ATOMIC_ACQUIRE);
+  uint32_t head=__atomic_load_n(&ring->producer.head,__ATOMIC_ACQUIRE);
+  return head-tail;
+}
+
+int wm_ring_get_overflows(const struct wm_ring *ring) {
+  if (!ring) return 0;
+  return __atomic_load_n(&ring->producer.overflows,__ATOMIC_RELAXED);
+}
@@ -0,0 +1,42 @@
+/* wm_ring.h
+ * Lock-free ring of fixed-size packets, for exactly one producer thread and one consumer thread.
+ * Neither side ever waits for the other. When the ring is full, push drops the new packet and counts an overflow.
+ * Each side's index lives on its own cache line, with a private copy of the other's, so they rarely share a line.
+ */
+
+#ifndef WM_RING_H
+#define WM_RING_H
+
+#define WM_RING_SIZE        64 /* Packets. Must be a power of two. About 300 ms of reports at the fastest rate. */
+#define WM_RING_PACKET_SIZE 32 /* Bytes, more than any input report. */
+#define WM_RING_CACHE_LINE  64
+
+struct wm_ring;
+
+struct wm_ring_packet {
+  int64_t time; // Producer's timestamp, us.
+  int c;
+  uint8_t v[WM_RING_PACKET_SIZE];
+};
+
+struct wm_ring *wm_ring_new();
+void wm_ring_del(struct wm_ring *ring);
+
+/* Producer only.
+ * Returns 0 if full (packet dropped), 1 if added, or 2 if added to an empty ring.
+ * In the last case, the consumer might be asleep and you should wake it.
+ * Consumers that pop until empty before sleeping will never miss a packet this way.
+ */
+int wm_ring_push(struct wm_ring *ring,const void *src,int srcc,int64_t time);
+
+/* Consumer only.
+ * Returns 1 and fills (dst), or 0 if empty.
+ */
+int wm_ring_pop(struct wm_ring_packet *dst,struct wm_ring *ring);
+
+/* Either side, approximate.
+ */
+int wm_ring_count(const struct wm_ring *ring);
+int wm_ring_get_overflows(const struct wm_ring *ring);
+
+#endif
@@ -0,0 +1,97 @@
+#define _GNU_SOURCE /* CPU_SET, sched_setaffinity */
+#include "wiimote.h"
+#include "wm_rt.h"
+#include "wm_config.h"
+#include <errno.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+/* Scheduler.
+ */
+
+int wm_rt_set_scheduler(int policy,int priority) {
+  struct sched_param param={0};
+  if ((policy==SCHED_FIFO)||(policy==SCHED_RR)) param.sched_priority=priority;
+  if (sched_setscheduler(0,policy,&param)<0) {
+    wm_log_error("sched_setscheduler(%d,%d): %m",policy,param.sched_priority);
+    return -1;
+  }
+  return 0;
+}
+
+/* Affinity.
+ */
+
+int wm_rt_set_affinity(const char *cpus) {
+  if (!cpus||!cpus[0]) return 0;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  const char *src=cpus;
+  while (*src) {
+    int lo=0,hi,digitc=0;
+    while ((*src>='0')&&(*src<='9')) { lo=lo*10+(*src++)-'0'; digitc++; }
+    hi=lo;
+    if (*src=='-') {
+      src++;
+      hi=0;
+      while ((*src>='0')&&(*src<='9')) { hi=hi*10+(*src++)-'0'; digitc++; }
+    }
+    if (!digitc||(hi<lo)||(hi>=CPU_SETSIZE)||(*src&&(*src++!=','))) {
+      wm_log_error("Invalid CPU list '%s'.",cpus);
+      return -1;
+    }
+    for (;lo<=hi;lo++) CPU_SET(lo,&set);
+  }
+  if (sched_setaffinity(0,sizeof(set),&set)<0) {
+    wm_log_error("sched_setaffinity(%s): %m",cpus);
+    return -1;
+  }
+  return 0;
+}
+
+/* Memory.
+ * Once locked, a page stays resident, but it still has to be faulted in once.
+ * So we touch a generous stack and heap now, and keep malloc from ever handing heap back to the kernel.
+ * The hot path itself allocates nothing, this is for the occasional handshake buffer.
+ */
+
+static int __attribute__((noinline)) wm_rt_prefault_stack() {
+  volatile uint8_t stack[WM_RT_STACK_PREFAULT];
+  int i; for (i=0;i<WM_RT_STACK_PREFAULT;i+=4096) stack[i]=0;
+  return stack[0];
+}
+
+int wm_rt_lock_memory() {
+  if (!mallopt(M_TRIM_THRESHOLD,-1)||!mallopt(M_MMAP_MAX,0)) {
+    wm_log_error("mallopt failed");
+    return -1;
+  }
+  if (mlockall(MCL_CURRENT|MCL_FUTURE)<0) {
+    wm_log_error("mlockall: %m");
+    return -1;
+  }
+  wm_rt_prefault_stack();
+  uint8_t *heap=malloc(WM_RT_HEAP_PREFAULT);
+  if (!heap) return -1;
+  memset(heap,0,WM_RT_HEAP_PREFAULT);
+  free(heap);
+  return 0;
+}
+
+/* Apply config.
+ */
+
+int wm_rt_apply(const struct wm_config *config) {
+  if (!config) return -1;
+  if (wm_rt_set_affinity(wm_config_get_cpu_affinity(config))<0) return -1;
+  if (wm_config_get_mlock(config)) {
+    if (wm_rt_lock_memory()<0) return -1;
+  }
+  int policy=wm_config_get_sched_policy(config);
+  if (policy!=SCHED_OTHER) {
+    if (wm_rt_set_scheduler(policy,wm_config_get_sched_priority(config))<0) return -1;
+    wm_log_debug("Scheduling policy %d, priority %d.",policy,wm_config_get_sched_priority(config));
+  }
+  return 0;
+}
@@ -0,0 +1,27 @@
+/* wm_rt.h
+ * Real-time tuning for the input path: Scheduling policy, CPU affinity, and locked, prefaulted memory.
+ * Everything here applies to the calling thread and any threads it creates later, so apply before starting any.
+ * That means after wm_daemonize() too: Memory locks don't survive fork.
+ */
+
+#ifndef WM_RT_H
+#define WM_RT_H
+
+struct wm_config;
+
+#define WM_RT_STACK_PREFAULT (256*1024) /* Bytes of the main thread's stack to touch. */
+#define WM_RT_HEAP_PREFAULT (1024*1024) /* Bytes of heap to touch and keep, for allocations after startup. */
+
+/* Everything from config: "sched-policy", "sched-priority", "cpu-affinity", "mlock".
+ * Fails if anything asked for can't be had, eg SCHED_FIFO without CAP_SYS_NICE.
+ */
+int wm_rt_apply(const struct wm_config *config);
+
+/* The pieces, individually. (policy) is SCHED_*.
+ * (cpus) is a list like "0,2-3", and empty or null does nothing.
+ */
+int wm_rt_set_scheduler(int policy,int priority);
+int wm_rt_set_affinity(const char *cpus);
+int wm_rt_lock_memory();
+
+#endif
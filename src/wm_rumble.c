@@ -0,0 +1,161 @@
+#include "wiimote.h"
+#include "wm_rumble.h"
+#include "wm_stats.h"
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+/* Object definition.
+ */
+
+struct wm_rumble_effect {
+  int in_use;
+  int magnitude; // Stronger of the two motors, 0..0xffff.
+  int64_t delay,length; // us. Zero length plays until stopped.
+  int remaining; // Plays left, including the current one. Zero if stopped.
+  int64_t start,stop; // Current play window. (stop) is INT64_MAX if unbounded.
+};
+
+struct wm_rumble {
+  int fd;
+  int gain;
+  struct wm_rumble_effect effectv[WM_RUMBLE_EFFECT_LIMIT];
+};
+
+/* Object lifecycle.
+ */
+
+struct wm_rumble *wm_rumble_new() {
+  struct wm_rumble *rumble=calloc(1,sizeof(struct wm_rumble));
+  if (!rumble) return 0;
+
+  rumble->gain=0xffff;
+
+  if ((rumble->fd=timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC))<0) {
+    wm_log_error("timerfd_create: %m");
+    free(rumble);
+    return 0;
+  }
+
+  return rumble;
+}
+
+void wm_rumble_del(struct wm_rumble *rumble) {
+  if (!rumble) return;
+  if (rumble->fd>=0) close(rumble->fd);
+  free(rumble);
+}
+
+int wm_rumble_get_fd(const struct wm_rumble *rumble) {
+  if (!rumble) return -1;
+  return rumble->fd;
+}
+
+/* Effects.
+ */
+
+static struct wm_rumble_effect *wm_rumble_get_effect(struct wm_rumble *rumble,int id) {
+  if (!rumble) return 0;
+  if ((id<0)||(id>=WM_RUMBLE_EFFECT_LIMIT)) return 0;
+  return rumble->effectv+id;
+}
+
+int wm_rumble_upload(struct wm_rumble *rumble,int id,int strong,int weak,int delay_ms,int length_ms) {
+  struct wm_rumble_effect *effect=wm_rumble_get_effect(rumble,id);
+  if (!effect) return -1;
+  if ((delay_ms<0)||(length_ms<0)) return -1;
+  effect->in_use=1;
+  effect->magnitude=(strong>weak)?strong:weak;
+  effect->delay=(int64_t)delay_ms*1000;
+  effect->length=(int64_t)length_ms*1000;
+  return 0;
+}
+
+int wm_rumble_erase(struct wm_rumble *rumble,int id) {
+  struct wm_rumble_effect *effect=wm_rumble_get_effect(rumble,id);
+  if (!effect) return -1;
+  memset(effect,0,sizeof(struct wm_rumble_effect));
+  return 0;
+}
+
+int wm_rumble_play(struct wm_rumble *rumble,int id,int count) {
+  struct wm_rumble_effect *effect=wm_rumble_get_effect(rumble,id);
+  if (!effect||!effect->in_use) return -1;
+  if (count<=0) {
+    effect->remaining=0;
+    return 0;
+  }
+  effect->remaining=count;
+  effect->start=wm_now_us()+effect->delay;
+  effect->stop=effect->length?(effect->start+effect->length):INT64_MAX;
+  return 0;
+}
+
+int wm_rumble_set_gain(struct wm_rumble *rumble,int gain) {
+  if (!rumble) return -1;
+  if (gain<0) gain=0; else if (gain>0xffff) gain=0xffff;
+  rumble->gain=gain;
+  return 0;
+}
+
+int wm_rumble_reset(struct wm_rumble *rumble) {
+  if (!rumble) return -1;
+  memset(rumble->effectv,0,sizeof(rumble->effectv));
+  rumble->gain=0xffff;
+  return 0;
+}
+
+/* Arm the timer for an absolute time, or disarm if INT64_MAX.
+ */
+
+static int wm_rumble_arm(struct wm_rumble *rumble,int64_t when) {
+  struct itimerspec its={0};
+  if (when<INT64_MAX) {
+    if (when<1) when=1; // Zero would disarm.
+    its.it_value.tv_sec=when/1000000;
+    its.it_value.tv_nsec=(when%1000000)*1000;
+  }
+  if (timerfd_settime(rumble->fd,TFD_TIMER_ABSTIME,&its,0)<0) return -1;
+  return 0;
+}
+
+/* Update.
+ */
+
+int wm_rumble_update(struct wm_rumble *rumble) {
+  if (!rumble) return -1;
+
+  /* Clear the timer's readiness. We recompute everything regardless of how many expirations. */
+  uint64_t expirations;
+  read(rumble->fd,&expirations,sizeof(expirations));
+
+  int64_t now=wm_now_us();
+  int64_t next=INT64_MAX;
+  int on=0;
+  struct wm_rumble_effect *effect=rumble->effectv;
+  int i=WM_RUMBLE_EFFECT_LIMIT; for (;i-->0;effect++) {
+    if (!effect->in_use||!effect->remaining) continue;
+
+    /* Past the window? Skip ahead by whole periods, however long we've been away. */
+    if (now>=effect->stop) {
+      int64_t period=effect->delay+effect->length;
+      int64_t n=(now-effect->stop)/period+1;
+      if (n>=effect->remaining) {
+        effect->remaining=0;
+        continue;
+      }
+      effect->remaining-=n;
+      effect->start=effect->stop+(n-1)*period+effect->delay;
+      effect->stop=effect->start+effect->length;
+    }
+
+    if (now<effect->start) {
+      if (effect->start<next) next=effect->start;
+    } else {
+      if ((((int64_t)effect->magnitude*rumble->gain)>>16)>=WM_RUMBLE_THRESHOLD) on=1;
+      if (effect->stop<next) next=effect->stop;
+    }
+  }
+
+  if (wm_rumble_arm(rumble,next)<0) return -1;
+  return on;
+}
@@ -0,0 +1,48 @@
+/* wm_rumble.h
+ * Force-feedback effect scheduler, for uinput's FF_RUMBLE.
+ * Clients upload effects and play them by ID, the way evdev describes them.
+ * We work out when the motor should be on, and arm a timerfd for the next time that changes.
+ *
+ * The Wii Remote's motor is either on or off, so effects are reduced to one bit:
+ * On if any effect is inside its play window with a magnitude (after gain) of at least WM_RUMBLE_THRESHOLD.
+ */
+
+#ifndef WM_RUMBLE_H
+#define WM_RUMBLE_H
+
+#define WM_RUMBLE_EFFECT_LIMIT 16 /* Also ff_effects_max for uinput. */
+#define WM_RUMBLE_THRESHOLD 0x2000 /* Of 0xffff. Weaker effects aren't worth shaking the remote for. */
+
+struct wm_rumble;
+
+struct wm_rumble *wm_rumble_new();
+void wm_rumble_del(struct wm_rumble *rumble);
+
+/* The timerfd. Poll it for reading, and call wm_rumble_update() when it fires.
+ */
+int wm_rumble_get_fd(const struct wm_rumble *rumble);
+
+/* Effects, as in <linux/input.h>. Magnitudes are 0..0xffff, times in milliseconds.
+ * (length_ms) zero means play until stopped.
+ * Uploading over a playing effect changes it without restarting.
+ */
+int wm_rumble_upload(struct wm_rumble *rumble,int id,int strong,int weak,int delay_ms,int length_ms);
+int wm_rumble_erase(struct wm_rumble *rumble,int id);
+
+/* Play (count) times, or stop if zero.
+ */
+int wm_rumble_play(struct wm_rumble *rumble,int id,int count);
+
+int wm_rumble_set_gain(struct wm_rumble *rumble,int gain);
+
+/* Stop everything and forget all effects, eg when the uinput device goes away.
+ */
+int wm_rumble_reset(struct wm_rumble *rumble);
+
+/* Advance to the present and rearm the timer.
+ * Call after the timer fires, and after any of the changes above.
+ * Returns the motor state, 0 or 1.
+ */
+int wm_rumble_update(struct wm_rumble *rumble);
+
+#endif
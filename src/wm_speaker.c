@@ -0,0 +1,217 @@
+#include "wiimote.h"
+#include "wm_speaker.h"
+#include "wm_adpcm.h"
+#include "wm_stats.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+#define WM_SPEAKER_PACKET_PCM (WM_SPEAKER_PACKET_SAMPLES*2) /* Input bytes per packet. */
+#define WM_SPEAKER_REBASE_SECONDS 40 /* Packet clock rebases after this long; any rate divides it evenly. */
+
+/* Object definition.
+ */
+
+struct wm_speaker {
+  char *path;
+  int srcfd; // -1 after EOF of a regular file.
+  int fifo;
+  int timerfd;
+  int rate;
+  struct wm_stats *stats;
+  struct wm_adpcm adpcm;
+  int streaming;
+  int64_t start; // ns, when packet zero was due.
+  int64_t packetid; // Next packet to send, counting from (start).
+  uint8_t buf[4096]; // PCM read ahead from the source.
+  int bufc;
+};
+
+static int64_t wm_speaker_now_ns() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (int64_t)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+
+/* Open source.
+ */
+
+static int wm_speaker_open_source(struct wm_speaker *speaker) {
+  if ((speaker->srcfd=open(speaker->path,O_RDONLY|O_NONBLOCK|O_CLOEXEC))<0) {
+    wm_log_error("%s: Failed to open: %m",speaker->path);
+    return -1;
+  }
+  struct stat st={0};
+  if (fstat(speaker->srcfd,&st)<0) return -1;
+  speaker->fifo=S_ISFIFO(st.st_mode)?1:0;
+  return 0;
+}
+
+/* Object lifecycle.
+ */
+
+struct wm_speaker *wm_speaker_new(const char *path,int rate,struct wm_stats *stats) {
+  if (!path||!path[0]) return 0;
+  if ((rate<WM_SPEAKER_RATE_MIN)||(rate>WM_SPEAKER_RATE_MAX)) return 0;
+  struct wm_speaker *speaker=calloc(1,sizeof(struct wm_speaker));
+  if (!speaker) return 0;
+
+  speaker->srcfd=-1;
+  speaker->timerfd=-1;
+  speaker->rate=rate;
+  speaker->stats=stats;
+  wm_adpcm_init(&speaker->adpcm);
+
+  int pathc=0; while (path[pathc]) pathc++;
+  if (!(speaker->path=malloc(pathc+1))) {
+    wm_speaker_del(speaker);
+    return 0;
+  }
+  memcpy(speaker->path,path,pathc+1);
+
+  if ((speaker->timerfd=timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC))<0) {
+    wm_log_error("timerfd_create: %m");
+    wm_speaker_del(speaker);
+    return 0;
+  }
+
+  if (wm_speaker_open_source(speaker)<0) {
+    wm_speaker_del(speaker);
+    return 0;
+  }
+
+  return speaker;
+}
+
+void wm_speaker_del(struct wm_speaker *speaker) {
+  if (!speaker) return;
+  if (speaker->srcfd>=0) close(speaker->srcfd);
+  if (speaker->timerfd>=0) close(speaker->timerfd);
+  if (speaker->path) free(speaker->path);
+  free(speaker);
+}
+
+/* Accessors.
+ */
+
+int wm_speaker_compose_config(uint8_t *dst,int dsta,const struct wm_speaker *speaker,int volume) {
+  if (!dst||(dsta<7)||!speaker) return -1;
+  if (volume<0) volume=0; else if (volume>0x7f) volume=0x7f;
+  int divisor=6000000/speaker->rate;
+  dst[0]=0x00;
+  dst[1]=0x00; // 4-bit ADPCM
+  dst[2]=divisor;
+  dst[3]=divisor>>8;
+  dst[4]=volume;
+  dst[5]=0x00;
+  dst[6]=0x00;
+  return 7;
+}
+
+int wm_speaker_get_fd(const struct wm_speaker *speaker) {
+  if (!speaker) return -1;
+  if (speaker->streaming) return speaker->timerfd;
+  return speaker->srcfd;
+}
+
+/* Read whatever the source has, without blocking.
+ */
+
+static int wm_speaker_read_source(struct wm_speaker *speaker) {
+  while ((speaker->srcfd>=0)&&(speaker->bufc<sizeof(speaker->buf))) {
+    int err=read(speaker->srcfd,speaker->buf+speaker->bufc,sizeof(speaker->buf)-speaker->bufc);
+    if (err>0) {
+      speaker->bufc+=err;
+      continue;
+    }
+    if (err<0) {
+      if ((errno==EAGAIN)||(errno==EINTR)) return 0;
+      wm_log_error("%s: read: %m",speaker->path);
+      return -1;
+    }
+    /* EOF. Wait for the FIFO's next writer, or we're done with a regular file. */
+    close(speaker->srcfd);
+    speaker->srcfd=-1;
+    if (speaker->fifo) return wm_speaker_open_source(speaker);
+    wm_log_debug("%s: End of file.",speaker->path);
+    return 0;
+  }
+  return 0;
+}
+
+/* Deadline for (packetid), absolute ns.
+ */
+
+static int64_t wm_speaker_deadline(const struct wm_speaker *speaker) {
+  return speaker->start+(speaker->packetid*WM_SPEAKER_PACKET_SAMPLES*1000000000ll)/speaker->rate;
+}
+
+static int wm_speaker_arm(struct wm_speaker *speaker,int64_t when) {
+  struct itimerspec its={0};
+  if (when>0) {
+    its.it_value.tv_sec=when/1000000000;
+    its.it_value.tv_nsec=when%1000000000;
+  }
+  if (timerfd_settime(speaker->timerfd,TFD_TIMER_ABSTIME,&its,0)<0) return -1;
+  return 0;
+}
+
+/* Update.
+ */
+
+int wm_speaker_update(uint8_t *dst,struct wm_speaker *speaker) {
+  if (!dst||!speaker) return -1;
+
+  if (!speaker->streaming) {
+    if (wm_speaker_read_source(speaker)<0) return -1;
+    if (speaker->bufc<WM_SPEAKER_PACKET_PCM) return 0;
+    speaker->streaming=1;
+    speaker->start=wm_speaker_now_ns();
+    speaker->packetid=0;
+
+  } else {
+    uint64_t expirations;
+    read(speaker->timerfd,&expirations,sizeof(expirations));
+    int64_t now=wm_speaker_now_ns();
+    int64_t deadline=wm_speaker_deadline(speaker);
+    if (now<deadline) return 0;
+    if (speaker->stats) wm_stats_timer_add(&speaker->stats->speaker_lateness,(now-deadline)/1000);
+    if (wm_speaker_read_source(speaker)<0) return -1;
+    if (speaker->bufc<WM_SPEAKER_PACKET_PCM) {
+      wm_log_debug("%s: Underrun, stopping.",speaker->path);
+      if (speaker->stats) speaker->stats->speaker_underruns++;
+      speaker->streaming=0;
+      if (wm_speaker_arm(speaker,0)<0) return -1;
+      return 0;
+    }
+  }
+
+  int16_t pcm[WM_SPEAKER_PACKET_SAMPLES];
+  const uint8_t *src=speaker->buf;
+  int i; for (i=0;i<WM_SPEAKER_PACKET_SAMPLES;i++,src+=2) pcm[i]=src[0]|(src[1]<<8);
+  wm_adpcm_encode(dst,&speaker->adpcm,pcm,WM_SPEAKER_PACKET_SAMPLES);
+  speaker->bufc-=WM_SPEAKER_PACKET_PCM;
+  memmove(speaker->buf,speaker->buf+WM_SPEAKER_PACKET_PCM,speaker->bufc);
+  if (speaker->stats) speaker->stats->speaker_packets++;
+
+  /* Keep the packet count small. Every rate fits a whole number of packets in WM_SPEAKER_REBASE_SECONDS. */
+  if (++(speaker->packetid)>=speaker->rate*WM_SPEAKER_REBASE_SECONDS/WM_SPEAKER_PACKET_SAMPLES) {
+    speaker->start+=WM_SPEAKER_REBASE_SECONDS*1000000000ll;
+    speaker->packetid=0;
+  }
+  if (wm_speaker_arm(speaker,wm_speaker_deadline(speaker))<0) return -1;
+  return WM_SPEAKER_PACKET_BYTES;
+}
+
+/* Stop.
+ */
+
+int wm_speaker_stop(struct wm_speaker *speaker) {
+  if (!speaker) return -1;
+  if (!speaker->streaming) return 0;
+  speaker->streaming=0;
+  wm_adpcm_init(&speaker->adpcm); // The device's decoder starts over too.
+  return wm_speaker_arm(speaker,0);
+}
@@ -0,0 +1,47 @@
+/* wm_speaker.h
+ * Streams PCM from a file or FIFO to the speaker, as ADPCM, at the exact sample rate.
+ * Input is signed 16-bit little-endian mono, at the rate we're configured for.
+ *
+ * Each packet is WM_SPEAKER_PACKET_SAMPLES samples, and packet N is due at (start+N*packet_duration).
+ * Deadlines are absolute, on a timerfd, so there's no drift however late any one wakeup is.
+ * When the source runs dry we stop the timer and wait on the source instead, so an idle speaker costs nothing.
+ * A FIFO is reopened when its writer goes away, so any number of clients can take turns.
+ */
+
+#ifndef WM_SPEAKER_H
+#define WM_SPEAKER_H
+
+struct wm_stats;
+
+#define WM_SPEAKER_PACKET_BYTES   20 /* ADPCM payload of one 0x18 report. */
+#define WM_SPEAKER_PACKET_SAMPLES (WM_SPEAKER_PACKET_BYTES*2)
+#define WM_SPEAKER_RATE_MIN     1000
+#define WM_SPEAKER_RATE_MAX     6000
+
+struct wm_speaker;
+
+/* (stats) is WEAK and optional.
+ */
+struct wm_speaker *wm_speaker_new(const char *path,int rate,struct wm_stats *stats);
+void wm_speaker_del(struct wm_speaker *speaker);
+
+/* Speaker configuration, 7 bytes for register 0x04a20001: Format, rate, and volume (0..127).
+ */
+int wm_speaker_compose_config(uint8_t *dst,int dsta,const struct wm_speaker *speaker,int volume);
+
+/* The one fd to poll for reading: The timer while streaming, or the source while idle.
+ * It changes, so ask again each time. <0 if there's nothing left to wait for.
+ */
+int wm_speaker_get_fd(const struct wm_speaker *speaker);
+
+/* Call when the fd polls readable.
+ * If a packet is due, writes WM_SPEAKER_PACKET_BYTES of ADPCM to (dst) and returns that length.
+ * Zero if nothing is due, <0 for real errors.
+ */
+int wm_speaker_update(uint8_t *dst,struct wm_speaker *speaker);
+
+/* Stop streaming, eg when the device goes away. Buffered audio is kept, and plays when the next stream starts.
+ */
+int wm_speaker_stop(struct wm_speaker *speaker);
+
+#endif
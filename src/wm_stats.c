@@ -0,0 +1,94 @@
+#include "wiimote.h"
+#include "wm_stats.h"
+#include <sys/resource.h>
+
+/* Add to timer.
+ */
+
+void wm_stats_timer_add(struct wm_stats_timer *timer,int64_t us) {
+  if (!timer) return;
+  if (us<0) us=0;
+  if (!timer->count||(us<timer->min)) timer->min=us;
+  if (!timer->count||(us>timer->max)) timer->max=us;
+  timer->last=us;
+  timer->total+=us;
+  timer->count++;
+}
+
+/* Log one timer.
+ */
+
+static void wm_stats_timer_log(const char *name,const struct wm_stats_timer *timer) {
+  if (!timer->count) {
+    wm_log_info("%s: no samples",name);
+    return;
+  }
+  wm_log_info(
+    "%s: n=%d last=%lldus min=%lldus avg=%lldus max=%lldus",
+    name,timer->count,
+    (long long)timer->last,(long long)timer->min,
+    (long long)(timer->total/timer->count),(long long)timer->max
+  );
+}
+
+/* Log everything.
+ */
+
+void wm_stats_log(const struct wm_stats *stats) {
+  if (!stats) return;
+  wm_stats_timer_log("ext_handshake",&stats->ext_handshake);
+  wm_log_info("ext_handshake_failures: %d",stats->ext_handshake_failures);
+  if (stats->ext_init_fallbacks||stats->ext_encrypted) {
+    wm_log_info("ext_init: fallbacks=%d encrypted=%d",stats->ext_init_fallbacks,stats->ext_encrypted);
+  }
+  wm_log_info(
+    "output: sent=%d coalesced=%d retries=%d failures=%d",
+    stats->output_sent,stats->output_coalesced,stats->output_retries,stats->output_failures
+  );
+  if (stats->interleave_pairs||stats->interleave_dropped_3e||stats->interleave_dropped_3f) {
+    wm_log_info(
+      "interleave: pairs=%d dropped_3e=%d dropped_3f=%d",
+      stats->interleave_pairs,stats->interleave_dropped_3e,stats->interleave_dropped_3f
+    );
+  }
+  if (stats->battery>=0) {
+    wm_log_info(
+      "battery: level=%d polls=%d low_events=%d",
+      stats->battery,stats->status_polls,stats->battery_low_events
+    );
+  }
+  if (stats->continuous_on||stats->continuous_off) {
+    wm_log_info("continuous: on=%d off=%d",stats->continuous_on,stats->continuous_off);
+  }
+  if (stats->idle_disconnects) {
+    wm_log_info("idle: disconnects=%d reconnects=%d",stats->idle_disconnects,stats->idle_reconnects);
+    wm_stats_timer_log("time_to_idle",&stats->time_to_idle);
+  }
+  if (stats->ring_latency.count) {
+    wm_log_info("ring: overflows=%d peak=%d",stats->ring_overflows,stats->ring_peak);
+    wm_stats_timer_log("ring_latency",&stats->ring_latency);
+  }
+  if (stats->busy_poll_hits||stats->busy_poll_misses) {
+    wm_log_info("busy_poll: hits=%d misses=%d",stats->busy_poll_hits,stats->busy_poll_misses);
+  }
+  if (stats->speaker_packets) {
+    wm_log_info(
+      "speaker: packets=%d underruns=%d dropped=%d",
+      stats->speaker_packets,stats->speaker_underruns,stats->speaker_dropped
+    );
+    wm_stats_timer_log("speaker_lateness",&stats->speaker_lateness);
+  }
+
+  /* CPU time for the whole process, and as a share of one core since we started. */
+  struct rusage ru={0};
+  int64_t elapsed=wm_now_us()-stats->start_time;
+  if (stats->start_time&&(elapsed>0)&&(getrusage(RUSAGE_SELF,&ru)>=0)) {
+    int64_t user=(int64_t)ru.ru_utime.tv_sec*1000000+ru.ru_utime.tv_usec;
+    int64_t sys=(int64_t)ru.ru_stime.tv_sec*1000000+ru.ru_stime.tv_usec;
+    int permille=((user+sys)*1000)/elapsed;
+    wm_log_info(
+      "cpu: user=%lldms sys=%lldms, %d.%d%% of one core",
+      (long long)(user/1000),(long long)(sys/1000),permille/10,permille%10
+    );
+  }
+}
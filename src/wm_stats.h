@@ -0,0 +1,62 @@
+/* wm_stats.h
+ * Counters and timings for performance tuning.
+ * The coordinator owns one of these, and logs it on SIGUSR1 and at exit.
+ */
+
+#ifndef WM_STATS_H
+#define WM_STATS_H
+
+#include <time.h>
+
+/* Accumulates a series of durations in microseconds.
+ */
+struct wm_stats_timer {
+  int count;
+  int64_t last,min,max,total;
+};
+
+struct wm_stats {
+  struct wm_stats_timer ext_handshake; // EXTPRESENT to first report carrying extension bytes.
+  int ext_handshake_failures;
+  int ext_init_fallbacks; // Handshakes retried with the other init method.
+  int ext_encrypted; // Handshakes that succeeded the old, encrypted way.
+  int output_sent;
+  int output_coalesced; // State reports replaced before they went out.
+  int output_retries;
+  int output_failures; // Memory operations abandoned after retries.
+  int interleave_pairs; // Complete 0x3e/0x3f samples.
+  int interleave_dropped_3e; // 0x3e whose 0x3f never came.
+  int interleave_dropped_3f; // 0x3f without a 0x3e before it.
+  int speaker_packets;
+  int speaker_underruns; // Source ran dry mid-stream.
+  int speaker_dropped; // Packets replaced in wm_output before they could go out.
+  struct wm_stats_timer speaker_lateness; // Packet timer wakeup, after its deadline.
+  int status_polls; // 0x15 requests sent.
+  int battery; // Most recent level, 0..255 (about 0xc8 is full), or -1 if unknown.
+  int battery_low_events;
+  int continuous_on; // Switches to continuous reporting.
+  int continuous_off; // Switches to change-only reporting, mostly from going idle.
+  int idle_disconnects;
+  int idle_reconnects;
+  struct wm_stats_timer time_to_idle; // Handshake to idle disconnect.
+  int ring_overflows; // Reports the reader thread dropped because the queue was full.
+  int ring_peak; // Most reports ever waiting in the queue.
+  struct wm_stats_timer ring_latency; // Reader thread's read() to wm_report_deliver().
+  int busy_poll_hits; // Reports caught while spinning.
+  int busy_poll_misses; // Spins that gave up and slept.
+  int64_t start_time; // wm_now_us() when we started, for CPU usage.
+};
+
+static inline int64_t wm_now_us() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+void wm_stats_timer_add(struct wm_stats_timer *timer,int64_t us);
+
+/* Log everything at INFO level.
+ */
+void wm_stats_log(const struct wm_stats *stats);
+
+#endif
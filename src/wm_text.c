@@ -2,6 +2,7 @@
 
 /* Represent bdaddr.
  * A canonically-represented bdaddr has a fixed length, 17 bytes.
+ * Raw bdaddr is little-endian, so the presentation order is reversed (same as wm_bdaddr_eval).
  */
 
 static inline void wm_hexbyte_repr(char *dst,uint8_t src) {
@@ -14,12 +15,12 @@ int wm_bdaddr_repr(char *dst,int dsta,const void *src) {
   if (!src) return -1;
   if (dsta<17) return 17;
   const uint8_t *SRC=src;
-  wm_hexbyte_repr(dst+ 0,SRC[0]);
-  wm_hexbyte_repr(dst+ 3,SRC[1]);
-  wm_hexbyte_repr(dst+ 6,SRC[2]);
-  wm_hexbyte_repr(dst+ 9,SRC[3]);
-  wm_hexbyte_repr(dst+12,SRC[4]);
-  wm_hexbyte_repr(dst+15,SRC[5]);
+  wm_hexbyte_repr(dst+ 0,SRC[5]);
+  wm_hexbyte_repr(dst+ 3,SRC[4]);
+  wm_hexbyte_repr(dst+ 6,SRC[3]);
+  wm_hexbyte_repr(dst+ 9,SRC[2]);
+  wm_hexbyte_repr(dst+12,SRC[1]);
+  wm_hexbyte_repr(dst+15,SRC[0]);
   dst[2]=dst[5]=dst[8]=dst[11]=dst[14]=':';
   if (dsta>17) dst[17]=0;
   return 17;
@@ -148,3 +149,27 @@ int wm_report_repr(char *dst,int dsta,const void *src,int srcc) {
   if (dstc<dsta) dst[dstc]=0;
   return dstc;
 }
+
+/* Evaluate hex dump.
+ */
+
+int wm_hex_eval(void *dst,int dsta,const char *src,int srcc) {
+  if (!dst||(dsta<0)) dsta=0;
+  if (!src) srcc=0; else if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  uint8_t *DST=dst;
+  int dstc=0,srcp=0,hi=-1;
+  for (;srcp<srcc;srcp++) {
+    if ((unsigned char)src[srcp]<=0x20) continue;
+    int digit=wm_hexdigit_eval(src[srcp]);
+    if (digit<0) return -1;
+    if (hi<0) {
+      hi=digit;
+    } else {
+      if (dstc<dsta) DST[dstc]=(hi<<4)|digit;
+      dstc++;
+      hi=-1;
+    }
+  }
+  if (hi>=0) return -1;
+  return dstc;
+}
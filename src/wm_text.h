@@ -16,4 +16,9 @@ int wm_int_eval(int *dst,const char *src,int srcc);
  */
 int wm_report_repr(char *dst,int dsta,const void *src,int srcc);
 
+/* Inverse of wm_report_repr(): pairs of hex digits, whitespace ignored.
+ * Returns the decoded length, which may exceed (dsta).
+ */
+int wm_hex_eval(void *dst,int dsta,const char *src,int srcc);
+
 #endif
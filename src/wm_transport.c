@@ -2,8 +2,10 @@
 #include "wm_transport.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/l2cap.h>
 
@@ -14,8 +16,15 @@ struct wm_transport {
   int fdr,fdw;
   struct sockaddr_l2 saddr;
   int retry_count;
+  int connecting; // (fdr) is a nonblocking connect in progress, and (fdw) not open yet.
+  int busy_poll; // us
+  int busy_poll_hits,busy_poll_misses;
 };
 
+#ifndef SO_BUSY_POLL
+  #define SO_BUSY_POLL 46
+#endif
+
 /* Object lifecycle.
  */
  
@@ -46,7 +55,12 @@ void wm_transport_del(struct wm_transport *transport) {
 
 int wm_transport_is_connected(const struct wm_transport *transport) {
   if (!transport) return 0;
-  return (transport->fdr>=0)?1:0;
+  return ((transport->fdr>=0)&&!transport->connecting)?1:0;
+}
+
+int wm_transport_is_connecting(const struct wm_transport *transport) {
+  if (!transport) return 0;
+  return transport->connecting;
 }
 
 /* Connect.
@@ -85,9 +99,73 @@ int wm_transport_connect(struct wm_transport *transport) {
   }
 
   wm_log_info("Connected");
+  wm_transport_set_busy_poll(transport,transport->busy_poll);
   return 0;
 }
 
+/* Connect asynchronously.
+ */
+
+int wm_transport_connect_begin(struct wm_transport *transport) {
+  if (!transport) return -1;
+  if (transport->fdr>=0) return -1;
+  wm_log_trace("%s",__func__);
+
+  if ((transport->fdr=socket(PF_BLUETOOTH,SOCK_SEQPACKET|SOCK_NONBLOCK,BTPROTO_L2CAP))<0) {
+    wm_log_error("socket() failed: %m");
+    return -1;
+  }
+  transport->connecting=1;
+
+  wm_log_debug("Paging device (PSM 0x13)...");
+  transport->saddr.l2_psm=0x13;
+  if (connect(transport->fdr,(struct sockaddr*)&transport->saddr,sizeof(transport->saddr))<0) {
+    if (errno!=EINPROGRESS) {
+      wm_log_error("connect() failed: %m");
+      wm_transport_disconnect(transport);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int wm_transport_connect_finish(struct wm_transport *transport) {
+  if (!transport||!transport->connecting) return -1;
+  wm_log_trace("%s",__func__);
+
+  int err=0;
+  socklen_t errlen=sizeof(err);
+  if (getsockopt(transport->fdr,SOL_SOCKET,SO_ERROR,&err,&errlen)<0) err=errno;
+  if (err) {
+    wm_log_debug("connect(): %s",strerror(err));
+    wm_transport_disconnect(transport);
+    return 0;
+  }
+  int flags=fcntl(transport->fdr,F_GETFL);
+  if ((flags<0)||(fcntl(transport->fdr,F_SETFL,flags&~O_NONBLOCK)<0)) {
+    wm_transport_disconnect(transport);
+    return -1;
+  }
+
+  if ((transport->fdw=socket(PF_BLUETOOTH,SOCK_SEQPACKET,BTPROTO_L2CAP))<0) {
+    wm_log_error("socket() failed: %m");
+    wm_transport_disconnect(transport);
+    return -1;
+  }
+  wm_log_info("Connecting to device (PSM 0x11)...");
+  transport->saddr.l2_psm=0x11;
+  if (connect(transport->fdw,(struct sockaddr*)&transport->saddr,sizeof(transport->saddr))<0) {
+    wm_log_error("connect() failed: %m");
+    wm_transport_disconnect(transport);
+    return 0;
+  }
+
+  transport->connecting=0;
+  wm_log_info("Connected");
+  wm_transport_set_busy_poll(transport,transport->busy_poll);
+  return 1;
+}
+
 /* Disconnect.
  */
  
@@ -102,6 +180,17 @@ int wm_transport_disconnect(struct wm_transport *transport) {
     close(transport->fdw);
     transport->fdw=-1;
   }
+  transport->connecting=0;
+  return 0;
+}
+
+/* Interrupt.
+ */
+
+int wm_transport_interrupt(struct wm_transport *transport) {
+  if (!transport) return -1;
+  if (transport->fdr<0) return 0;
+  if (shutdown(transport->fdr,SHUT_RDWR)<0) return -1;
   return 0;
 }
 
@@ -110,7 +199,7 @@ int wm_transport_disconnect(struct wm_transport *transport) {
  
 int wm_transport_read(void *dst,int dsta,struct wm_transport *transport) {
   if (!dst||(dsta<1)||!transport) return -1;
-  if (transport->fdr<0) return -1;
+  if ((transport->fdr<0)||transport->connecting) return -1;
   return read(transport->fdr,dst,dsta);
 }
 
@@ -125,10 +214,68 @@ int wm_transport_write(struct wm_transport *transport,const void *src,int srcc)
  
 int wm_transport_poll(struct wm_transport *transport,int to_ms) {
   if (!transport) return -1;
-  if (transport->fdr<0) return -1;
+  if ((transport->fdr<0)||transport->connecting) return -1;
+  int err=wm_transport_spin_poll(transport->fdr,transport->busy_poll,to_ms);
+  if ((err<0)&&(errno==EINTR)) return 0; // Signals are handled by the main loop.
+  if (transport->busy_poll) {
+    if (err==2) __atomic_store_n(&transport->busy_poll_hits,transport->busy_poll_hits+1,__ATOMIC_RELAXED);
+    else __atomic_store_n(&transport->busy_poll_misses,transport->busy_poll_misses+1,__ATOMIC_RELAXED);
+  }
+  return err;
+}
+
+/* Spin, then poll.
+ * A one-byte MSG_PEEK is the cheapest readiness check there is, and consumes nothing.
+ * End-of-file and errors count as readable, so the read that follows can report them.
+ */
+
+int wm_transport_spin_poll(int fd,int spin_us,int to_ms) {
+  if (spin_us>0) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    int64_t stop=(int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000+spin_us;
+    while (1) {
+      uint8_t dummy;
+      if (recv(fd,&dummy,1,MSG_PEEK|MSG_DONTWAIT)>=0) return 2;
+      if ((errno!=EAGAIN)&&(errno!=EWOULDBLOCK)&&(errno!=EINTR)) return 2;
+      clock_gettime(CLOCK_MONOTONIC,&ts);
+      if ((int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000>=stop) break;
+    }
+    if (!to_ms) return 0;
+  }
   struct pollfd pollfd={0};
-  pollfd.fd=transport->fdr;
+  pollfd.fd=fd;
   pollfd.events=POLLIN|POLLHUP|POLLERR;
   int err=poll(&pollfd,1,to_ms);
+  if (err>0) return 1;
   return err;
 }
+
+/* Busy poll settings.
+ */
+
+int wm_transport_set_busy_poll(struct wm_transport *transport,int spin_us) {
+  if (!transport||(spin_us<0)) return -1;
+  transport->busy_poll=spin_us;
+  if (spin_us&&(transport->fdr>=0)) {
+    if (setsockopt(transport->fdr,SOL_SOCKET,SO_BUSY_POLL,&spin_us,sizeof(spin_us))<0) {
+      wm_log_debug("SO_BUSY_POLL: %m. Spinning in userspace only.");
+    }
+  }
+  return 0;
+}
+
+int wm_transport_get_busy_poll(const struct wm_transport *transport) {
+  if (!transport) return 0;
+  return transport->busy_poll;
+}
+
+void wm_transport_get_busy_poll_stats(int *hits,int *misses,const struct wm_transport *transport) {
+  if (hits) *hits=transport?__atomic_load_n(&transport->busy_poll_hits,__ATOMIC_RELAXED):0;
+  if (misses) *misses=transport?__atomic_load_n(&transport->busy_poll_misses,__ATOMIC_RELAXED):0;
+}
+
+int wm_transport_get_fd(const struct wm_transport *transport) {
+  if (!transport) return -1;
+  return transport->fdr;
+}
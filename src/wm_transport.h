@@ -18,6 +18,20 @@ int wm_transport_connect(struct wm_transport *transport);
 int wm_transport_disconnect(struct wm_transport *transport);
 int wm_transport_is_connected(const struct wm_transport *transport);
 
+/* Connect without blocking, for reconnecting while other things are going on.
+ * Begin the attempt, then poll the fd (wm_transport_get_fd) for writing, and call finish when it's ready.
+ * Finish returns >0 if connected, 0 if the device didn't answer (we're disconnected again), or <0 for real errors.
+ * Only the first channel is asynchronous. Once the device answers, the second is quick.
+ */
+int wm_transport_connect_begin(struct wm_transport *transport);
+int wm_transport_connect_finish(struct wm_transport *transport);
+int wm_transport_is_connecting(const struct wm_transport *transport);
+
+/* Make a read blocked on another thread return 0, and any later read too.
+ * Writes may still work. Disconnect after.
+ */
+int wm_transport_interrupt(struct wm_transport *transport);
+
 /* Transfer data.
  * L2CAP is packet-oriented, so these should be discrete packets, not really a loose stream.
  * Both functions return the length transferred.
@@ -36,7 +50,27 @@ int wm_transport_write(struct wm_transport *transport,const void *src,int srcc);
  *   >0: Read will not block
  *    0: Read will block
  *   <0: Error (eg not connected)
+ * With busy polling on, we spin on the socket for a while first, and only then sleep in poll().
  */
 int wm_transport_poll(struct wm_transport *transport,int to_ms);
 
+/* Busy polling, for when you'd rather burn a core than wait for the scheduler to wake you.
+ * (spin_us) is how long wm_transport_poll() spins before sleeping, zero to not spin at all.
+ * We also ask the kernel for SO_BUSY_POLL on the socket. That's a hint, and not every kernel or protocol honors it.
+ * Hits are polls that found data while spinning, misses are polls that had to sleep.
+ * Counters may be read from another thread than the one polling.
+ */
+int wm_transport_set_busy_poll(struct wm_transport *transport,int spin_us);
+int wm_transport_get_busy_poll(const struct wm_transport *transport);
+void wm_transport_get_busy_poll_stats(int *hits,int *misses,const struct wm_transport *transport);
+
+/* The spin-then-sleep wait on any fd, exposed for the benchmark.
+ * Returns 2 if readable while spinning, 1 if readable after sleeping, 0 on timeout, <0 on error.
+ */
+int wm_transport_spin_poll(int fd,int spin_us,int to_ms);
+
+/* The socket we read from, if you'd rather poll it alongside other things.
+ */
+int wm_transport_get_fd(const struct wm_transport *transport);
+
 #endif